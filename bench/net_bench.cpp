@@ -0,0 +1,569 @@
+// End-to-end load generator for http::server in the spirit of wrk/wrk2.
+//
+//   net_bench [scenario|all] [key=value ...]
+//
+//   scenarios    hello, large_body, many_routes, idle_connections
+//   threads=2    client threads, each running its own event loop
+//   connections=32 duration=5 warmup=1 (seconds)
+//   rate=0       0 runs closed-loop: every connection sends again as soon as it has its answer.
+//                N runs open-loop at N requests/s in total; latency is taken from the time a
+//                request was due rather than sent, so a stalled server cannot hide its backlog
+//                (coordinated omission).
+//   pipeline=1   requests in flight per connection; only meaningful with target= pointing at a
+//                server that keeps connections alive
+//   body=1048576 large_body response size
+//   routes=1000  many_routes route count
+//   idle=200     idle_connections: sockets opened and left silent during the run, so the accept
+//                loop carries them in its select set while the load is served
+//   profile=default  socket options of the in-process server: default, latency or throughput
+//   target=host:port  load an already running server instead of an in-process one
+//   json=net_bench.json  where the results go; "-" for stdout
+//
+// http::server answers every request with Connection: close, so against the in-process server
+// each request pays for a connect and an accept: rps is connection-per-request throughput, and
+// "connects" in the results equals the request count. There is no pipelining or keep-alive
+// scenario until the server reuses connections.
+//
+// Client and server share the machine (and, by default, the process), so numbers are for
+// comparing commits on one machine, not for absolute capacity.
+
+// std
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// lib
+#include <net/event_loop.h>
+#include <net/histogram.h>
+#include <net/http/client/response_parser.h>
+#include <net/http/server.h>
+
+using namespace net::http;
+using clock_type = std::chrono::steady_clock;
+
+namespace {
+
+struct config {
+    string scenario   = "all";
+    int threads       = 2;
+    int connections   = 32;
+    double duration   = 5;
+    double warmup     = 1;
+    double rate       = 0;
+    int pipeline      = 0; // 0: scenario default
+    size_t body       = 1024 * 1024;
+    int routes        = 1000;
+    int idle          = 200;
+    string profile    = "default";
+    string target;
+    string json_path  = "net_bench.json";
+    int port          = 18090;
+};
+
+struct scenario {
+    string name;
+    std::function<void(server&, const config&)> setup;
+    // request text for the n-th request a connection sends
+    std::function<string(uint64_t n, const config&)> request;
+    int pipeline = 1;
+    bool idle    = false;
+};
+
+string get(const string& path) { return "GET " + path + " HTTP/1.1\r\nHost: bench\r\n\r\n"; }
+
+list<scenario> scenarios() {
+    list<scenario> all;
+
+    auto hello = [](server& s, const config&) {
+        s.get("/hello", [](const request&) {
+            response res;
+            res.set_status_code(200);
+            res.set_text("Hello, World!");
+            return res;
+        });
+    };
+
+    all.push_back({"hello", hello, [](uint64_t, const config&) { return get("/hello"); }});
+
+    all.push_back({"large_body",
+                   [](server& s, const config& cfg) {
+                       auto body = std::make_shared<string>(cfg.body, 'x');
+                       s.get("/large", [body](const request&) {
+                           response res;
+                           res.set_status_code(200);
+                           res.set_text(*body);
+                           return res;
+                       });
+                   },
+                   [](uint64_t, const config&) { return get("/large"); }});
+
+    all.push_back({"many_routes",
+                   [](server& s, const config& cfg) {
+                       for (int i = 0; i < cfg.routes; ++i) {
+                           s.get("/api/v1/resource" + std::to_string(i) + "/:id", [](const request& req) {
+                               response res;
+                               res.set_status_code(200);
+                               res.set_text(req.params.at("id"));
+                               return res;
+                           });
+                       }
+                   },
+                   [](uint64_t n, const config& cfg) {
+                       // spread over the table so lookups do not all hit the first routes
+                       uint64_t route = (n * 7919) % static_cast<uint64_t>(cfg.routes);
+                       return get("/api/v1/resource" + std::to_string(route) + "/" + std::to_string(n));
+                   }});
+
+    all.push_back({"idle_connections", hello, [](uint64_t, const config&) { return get("/hello"); }, 1, true});
+
+    return all;
+}
+
+struct stats {
+    net::histogram latency_ns;
+    uint64_t requests      = 0;
+    uint64_t bytes         = 0;
+    uint64_t connects      = 0;
+    uint64_t connect_errors = 0;
+    uint64_t read_errors   = 0;
+    uint64_t status_errors = 0;
+    // pipelined requests still outstanding when the server closed the connection
+    uint64_t unanswered    = 0;
+
+    void merge(const stats& o) {
+        latency_ns.merge(o.latency_ns);
+        requests += o.requests;
+        bytes += o.bytes;
+        connects += o.connects;
+        connect_errors += o.connect_errors;
+        read_errors += o.read_errors;
+        status_errors += o.status_errors;
+        unanswered += o.unanswered;
+    }
+};
+
+// One client thread: a set of non-blocking connections driven by an event loop.
+class worker {
+  public:
+    worker(const scenario& sc, const config& cfg, const net::ip_endpoint& ep, int connections,
+           clock_type::time_point measure_from, clock_type::time_point stop_at)
+        : sc_(sc), cfg_(cfg), ep_(ep), measure_from_(measure_from), stop_at_(stop_at),
+          pipeline_(cfg.pipeline > 0 ? cfg.pipeline : sc.pipeline) {
+        if (cfg.rate > 0)
+            interval_ = std::chrono::duration_cast<clock_type::duration>(
+                std::chrono::duration<double>(cfg.threads * connections / cfg.rate));
+        conns_.resize(connections);
+    }
+
+    void run() {
+        auto now = clock_type::now();
+        for (size_t i = 0; i < conns_.size(); ++i) {
+            // stagger open-loop schedules so connections do not fire in lockstep
+            conns_[i].next_due = now + interval_ * i / std::max<size_t>(conns_.size(), 1);
+            open(conns_[i]);
+        }
+
+        loop_.schedule(stop_at_ - now, [this] { loop_.stop(); });
+        loop_.run();
+
+        for (connection& c : conns_)
+            close(c);
+    }
+
+    const stats& result() const { return stats_; }
+
+  private:
+    struct connection {
+        net::socket sock{INVALID_SOCKET};
+        bool connected = false;
+        response_parser parser;
+        string in;
+        string out;
+        size_t out_offset = 0;
+        // due (open loop) or send (closed loop) time of each request in flight
+        std::deque<clock_type::time_point> inflight;
+        clock_type::time_point next_due;
+        uint64_t sent                      = 0;
+        net::event_loop::timer_id timer    = 0;
+    };
+
+    const scenario& sc_;
+    const config& cfg_;
+    net::ip_endpoint ep_;
+    clock_type::time_point measure_from_;
+    clock_type::time_point stop_at_;
+    int pipeline_;
+    clock_type::duration interval_{0};
+    net::event_loop loop_;
+    list<connection> conns_;
+    stats stats_;
+
+    bool open_loop() const { return interval_.count() > 0; }
+
+    void open(connection& c) {
+        c.sock         = net::socket(ep_);
+        c.connected    = false;
+        c.in.clear();
+        c.out.clear();
+        c.out_offset   = 0;
+        c.parser.reset();
+
+        u_long mode         = 1;
+        c.sock.non_blocking = true;
+        ioctlsocket(c.sock, FIONBIO, &mode);
+
+        if (!c.sock.connect(ep_)) {
+            ++stats_.connect_errors;
+            c.sock.close();
+            retry_later(c);
+            return;
+        }
+
+        ++stats_.connects;
+        loop_.watch(c.sock, net::io_write, [this, &c](int events) { on_io(c, events); });
+    }
+
+    void close(connection& c) {
+        loop_.cancel(c.timer);
+        c.timer = 0;
+        if (c.sock.is_valid()) {
+            loop_.unwatch(c.sock);
+            c.sock.close();
+        }
+    }
+
+    void retry_later(connection& c) {
+        c.timer = loop_.schedule(std::chrono::milliseconds(10), [this, &c] {
+            c.timer = 0;
+            open(c);
+        });
+    }
+
+    void on_io(connection& c, int events) {
+        if (!c.connected) {
+            int err           = 0;
+            socklen_t err_len = sizeof(err);
+            getsockopt(c.sock, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&err), &err_len);
+            if (err != 0 || (events & net::io_error)) {
+                ++stats_.connect_errors;
+                close(c);
+                retry_later(c);
+                return;
+            }
+            c.connected = true;
+            fill(c);
+        }
+
+        if (events & net::io_write)
+            flush(c);
+        if (c.sock.is_valid() && (events & (net::io_read | net::io_error)))
+            receive(c);
+    }
+
+    // queues as many requests as the pipeline depth and, open loop, the schedule allow
+    void fill(connection& c) {
+        auto now = clock_type::now();
+        while (c.inflight.size() < static_cast<size_t>(pipeline_)) {
+            if (open_loop()) {
+                if (c.next_due > now) {
+                    if (c.timer == 0)
+                        c.timer = loop_.schedule(c.next_due - now, [this, &c] {
+                            c.timer = 0;
+                            if (c.connected)
+                                fill(c);
+                        });
+                    break;
+                }
+                c.inflight.push_back(c.next_due);
+                c.next_due += interval_;
+            } else {
+                c.inflight.push_back(now);
+            }
+            c.out.append(sc_.request(c.sent++, cfg_));
+        }
+        flush(c);
+    }
+
+    void flush(connection& c) {
+        while (c.out_offset < c.out.size()) {
+            int n = ::send(c.sock, c.out.data() + c.out_offset, static_cast<int>(c.out.size() - c.out_offset),
+                           net::send_flags);
+            if (n > 0) {
+                c.out_offset += n;
+                continue;
+            }
+            if (n < 0 && WSAGetLastError() == WSAEWOULDBLOCK)
+                break;
+            ++stats_.read_errors;
+            reconnect(c);
+            return;
+        }
+
+        if (c.out_offset == c.out.size()) {
+            c.out.clear();
+            c.out_offset = 0;
+        }
+        loop_.update(c.sock, c.out.empty() ? net::io_read : net::io_read | net::io_write);
+    }
+
+    void receive(connection& c) {
+        char buffer[65536];
+        bool closed = false;
+        while (true) {
+            int n = ::recv(c.sock, buffer, sizeof(buffer), 0);
+            if (n > 0) {
+                c.in.append(buffer, n);
+                stats_.bytes += n;
+                if (!parse(c))
+                    return;
+                continue;
+            }
+            if (n < 0 && WSAGetLastError() == WSAEWOULDBLOCK)
+                break;
+            closed = true;
+            break;
+        }
+
+        if (!closed)
+            return;
+
+        if (c.parser.in_progress()) {
+            c.parser.finish();
+            if (c.parser.done())
+                complete(c);
+        }
+        reconnect(c);
+    }
+
+    // false when the connection was replaced
+    bool parse(connection& c) {
+        while (!c.in.empty()) {
+            size_t used = c.parser.feed(c.in.data(), c.in.size());
+            c.in.erase(0, used);
+
+            if (c.parser.headers_complete() && !c.parser.done() && !c.parser.failed())
+                c.parser.stream_body([](const char*, size_t) { return true; });
+
+            if (c.parser.failed()) {
+                ++stats_.read_errors;
+                reconnect(c);
+                return false;
+            }
+
+            if (!c.parser.done())
+                break;
+
+            bool keep_alive = c.parser.keep_alive();
+            complete(c);
+            if (!keep_alive) {
+                reconnect(c);
+                return false;
+            }
+        }
+
+        fill(c);
+        return true;
+    }
+
+    void complete(connection& c) {
+        if (c.parser.peek().get_status_code() >= 400)
+            ++stats_.status_errors;
+
+        auto now = clock_type::now();
+        if (!c.inflight.empty()) {
+            clock_type::time_point started = c.inflight.front();
+            c.inflight.pop_front();
+            if (started >= measure_from_ && now < stop_at_) {
+                ++stats_.requests;
+                stats_.latency_ns.record(static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(now - started).count()));
+            }
+        }
+        c.parser.reset();
+    }
+
+    // the server closed the connection (no keep-alive) or it failed; requests still in flight
+    // are lost, and open loop keeps their due times so the delay shows in the next latencies
+    void reconnect(connection& c) {
+        stats_.unanswered += c.inflight.size();
+        if (open_loop() && !c.inflight.empty())
+            c.next_due = std::min(c.next_due, c.inflight.front());
+        c.inflight.clear();
+        close(c);
+        if (clock_type::now() < stop_at_)
+            open(c);
+    }
+};
+
+stats run_scenario(const scenario& sc, const config& cfg, const net::ip_endpoint& ep) {
+    list<net::socket> idle;
+    if (sc.idle) {
+        for (int i = 0; i < cfg.idle; ++i) {
+            net::socket s(ep);
+            if (s.connect(ep))
+                idle.push_back(s);
+        }
+    }
+
+    auto start        = clock_type::now();
+    auto measure_from = start + std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(cfg.warmup));
+    auto stop_at      = measure_from + std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(cfg.duration));
+
+    list<std::unique_ptr<worker>> workers;
+    for (int t = 0; t < cfg.threads; ++t) {
+        int share = cfg.connections / cfg.threads + (t < cfg.connections % cfg.threads ? 1 : 0);
+        workers.push_back(std::make_unique<worker>(sc, cfg, ep, std::max(share, 1), measure_from, stop_at));
+    }
+
+    list<std::thread> threads;
+    for (auto& w : workers)
+        threads.emplace_back([&w] { w->run(); });
+    for (auto& t : threads)
+        t.join();
+
+    for (net::socket& s : idle)
+        s.close();
+
+    stats total;
+    for (auto& w : workers)
+        total.merge(w->result());
+    return total;
+}
+
+json to_json(const scenario& sc, const config& cfg, const stats& st) {
+    auto us = [&](double p) { return st.latency_ns.percentile(p) / 1000.0; };
+    json latency = {{"min", st.latency_ns.min() / 1000.0}, {"mean", st.latency_ns.mean() / 1000.0},
+                    {"p50", us(50)},  {"p90", us(90)},  {"p99", us(99)},
+                    {"p99_9", us(99.9)}, {"max", st.latency_ns.max() / 1000.0}};
+
+    return {{"name", sc.name},
+            {"mode", cfg.rate > 0 ? "open" : "closed"},
+            {"profile", cfg.profile},
+            {"threads", cfg.threads},
+            {"connections", cfg.connections},
+            {"pipeline", cfg.pipeline > 0 ? cfg.pipeline : sc.pipeline},
+            {"target_rate", cfg.rate},
+            {"duration_s", cfg.duration},
+            {"requests", st.requests},
+            {"rps", st.requests / cfg.duration},
+            {"bytes", st.bytes},
+            {"mib_per_s", st.bytes / cfg.duration / (1024.0 * 1024.0)},
+            {"connects", st.connects},
+            {"errors",
+             {{"connect", st.connect_errors},
+              {"read", st.read_errors},
+              {"status", st.status_errors},
+              {"unanswered", st.unanswered}}},
+            {"latency_us", latency}};
+}
+
+void summary(const scenario& sc, const stats& st, const config& cfg) {
+    std::cerr << std::left << std::setw(18) << sc.name << std::fixed << std::setprecision(1)
+              << " rps=" << st.requests / cfg.duration
+              << " p50=" << st.latency_ns.percentile(50) / 1000.0 << "us"
+              << " p99=" << st.latency_ns.percentile(99) / 1000.0 << "us"
+              << " p99.9=" << st.latency_ns.percentile(99.9) / 1000.0 << "us"
+              << " connects=" << st.connects
+              << " errors=" << st.connect_errors + st.read_errors + st.status_errors
+              << " unanswered=" << st.unanswered << std::endl;
+}
+
+config parse_args(int argc, char** argv) {
+    config cfg;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        size_t eq  = arg.find('=');
+        if (eq == string::npos) {
+            cfg.scenario = arg;
+            continue;
+        }
+
+        string key = arg.substr(0, eq), value = arg.substr(eq + 1);
+        if (key == "threads")
+            cfg.threads = std::max(1, std::atoi(value.c_str()));
+        else if (key == "connections")
+            cfg.connections = std::max(1, std::atoi(value.c_str()));
+        else if (key == "duration")
+            cfg.duration = std::atof(value.c_str());
+        else if (key == "warmup")
+            cfg.warmup = std::atof(value.c_str());
+        else if (key == "rate")
+            cfg.rate = std::atof(value.c_str());
+        else if (key == "pipeline")
+            cfg.pipeline = std::atoi(value.c_str());
+        else if (key == "body")
+            cfg.body = static_cast<size_t>(std::atoll(value.c_str()));
+        else if (key == "routes")
+            cfg.routes = std::max(1, std::atoi(value.c_str()));
+        else if (key == "idle")
+            cfg.idle = std::atoi(value.c_str());
+        else if (key == "profile")
+            cfg.profile = value;
+        else if (key == "target")
+            cfg.target = value;
+        else if (key == "json")
+            cfg.json_path = value;
+        else if (key == "port")
+            cfg.port = std::atoi(value.c_str());
+        else
+            std::cerr << "unknown option " << key << std::endl;
+    }
+    return cfg;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    config cfg = parse_args(argc, argv);
+
+    json results = json::array();
+    int port     = cfg.port;
+    for (const scenario& sc : scenarios()) {
+        if (cfg.scenario != "all" && cfg.scenario != sc.name)
+            continue;
+
+        std::unique_ptr<server> srv;
+        net::ip_endpoint ep;
+        if (cfg.target.empty()) {
+            // a fresh server per scenario, so routes and idle connections do not carry over
+            srv = std::make_unique<server>("127.0.0.1", port);
+            srv->non_blocking() = true;
+            if (cfg.profile == "latency")
+                srv->socket_profile(net::socket_options::latency());
+            else if (cfg.profile == "throughput")
+                srv->socket_profile(net::socket_options::throughput());
+            sc.setup(*srv, cfg);
+            srv->start();
+            ep = net::ip_endpoint("127.0.0.1", port++);
+        } else {
+            size_t colon = cfg.target.rfind(':');
+            ep = net::ip_endpoint(cfg.target.substr(0, colon), std::atoi(cfg.target.c_str() + colon + 1));
+        }
+
+        stats st = run_scenario(sc, cfg, ep);
+        summary(sc, st, cfg);
+        results.push_back(to_json(sc, cfg, st));
+
+        if (srv)
+            srv->stop();
+    }
+
+    json doc = {{"benchmark", "net_bench"},
+                {"timestamp", static_cast<int64_t>(std::time(nullptr))},
+                {"hardware_concurrency", std::thread::hardware_concurrency()},
+                {"scenarios", results}};
+
+    if (cfg.json_path == "-")
+        std::cout << doc.dump(2) << std::endl;
+    else
+        std::ofstream(cfg.json_path) << doc.dump(2) << std::endl;
+    return 0;
+}
@@ -0,0 +1,374 @@
+// Microbenchmarks for the per-request hot paths: parsing, routing, serialization and the
+// socket registry, and the whole server pipeline over in-memory connections (sim/simulation.h).
+// Each case runs for at least min_time, is repeated and reports the median.
+//
+//   net_microbench [filter] [min_time=0.2] [repetitions=5] [json=path]
+//
+// allocs/op counts calls to the global operator new made by one operation; cycles come from
+// the time stamp counter where the CPU has one (x86), so they are reference cycles, not core
+// cycles under turbo. cycles/B divides by the input (parse) or output (serialize) size.
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// lib
+#include <net/socket_registry.h>
+#include <net/http/request.h>
+#include <net/http/response.h>
+#include <net/http/routing/router.h>
+#include <net/http/sim/simulation.h>
+
+namespace {
+
+std::atomic<uint64_t> allocations{0};
+std::atomic<uint64_t> allocated_bytes{0};
+
+} // namespace
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) { return ::operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+using namespace net::http;
+using clock_type = std::chrono::steady_clock;
+
+namespace {
+
+template <typename T>
+inline void do_not_optimize(const T& value) {
+#if defined(_MSC_VER)
+    const volatile void* sink = &value;
+    (void)sink;
+    _ReadWriteBarrier();
+#else
+    asm volatile("" : : "r"(&value) : "memory");
+#endif
+}
+
+inline uint64_t cycles() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+struct benchmark {
+    string name;
+    // bytes processed per operation, 0 when the notion does not apply
+    size_t bytes;
+    std::function<void(uint64_t iterations)> run;
+};
+
+struct measurement {
+    uint64_t iterations;
+    double ns;
+    double cycles;
+    double allocs;
+    double alloc_bytes;
+};
+
+list<benchmark>& registry() {
+    static list<benchmark> all;
+    return all;
+}
+
+void add(string name, size_t bytes, std::function<void(uint64_t)> run) {
+    registry().push_back({std::move(name), bytes, std::move(run)});
+}
+
+measurement measure(const benchmark& b, uint64_t iterations) {
+    uint64_t a0 = allocations.load(), b0 = allocated_bytes.load();
+    auto t0     = clock_type::now();
+    uint64_t c0 = cycles();
+    b.run(iterations);
+    uint64_t c1 = cycles();
+    auto t1     = clock_type::now();
+    uint64_t a1 = allocations.load(), b1 = allocated_bytes.load();
+
+    double n = static_cast<double>(iterations);
+    return {iterations, std::chrono::duration<double, std::nano>(t1 - t0).count() / n, (c1 - c0) / n,
+            (a1 - a0) / n, (b1 - b0) / n};
+}
+
+measurement run(const benchmark& b, double min_time, int repetitions) {
+    // grow the iteration count until one run takes a tenth of min_time, then size it to min_time
+    uint64_t iterations = 1;
+    while (true) {
+        measurement m = measure(b, iterations);
+        double total  = m.ns * iterations;
+        if (total >= min_time * 1e8 || iterations >= (uint64_t(1) << 40)) {
+            iterations = std::max<uint64_t>(1, static_cast<uint64_t>(iterations * (min_time * 1e9 / std::max(total, 1.0))));
+            break;
+        }
+        iterations *= 10;
+    }
+
+    list<measurement> runs;
+    for (int i = 0; i < repetitions; ++i)
+        runs.push_back(measure(b, iterations));
+
+    std::sort(runs.begin(), runs.end(), [](const measurement& x, const measurement& y) { return x.ns < y.ns; });
+    return runs[runs.size() / 2];
+}
+
+// ---------------------------------------------------------------------------------------------
+
+const string get_request = "GET /api/v1/users/42/posts?limit=20&offset=40 HTTP/1.1\r\n"
+                           "Host: api.example.com\r\n"
+                           "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36\r\n"
+                           "Accept: application/json, text/plain, */*\r\n"
+                           "Accept-Encoding: gzip, deflate, br\r\n"
+                           "Accept-Language: en-US,en;q=0.9\r\n"
+                           "Cookie: session=0123456789abcdef0123456789abcdef\r\n"
+                           "Connection: keep-alive\r\n\r\n";
+
+string post_request(size_t body) {
+    return "POST /api/v1/upload HTTP/1.1\r\nHost: api.example.com\r\nContent-Type: application/json\r\n"
+           "Content-Length: " + std::to_string(body) + "\r\n\r\n" + string(body, 'x');
+}
+
+void register_parse() {
+    auto get = std::make_shared<const string>(get_request);
+    add("request::parse/get", get->size(), [get](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            request req = request::parse(get);
+            do_not_optimize(req);
+        }
+    });
+
+    auto post = std::make_shared<const string>(post_request(4096));
+    add("request::parse/post_4k", post->size(), [post](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            request req = request::parse(post);
+            do_not_optimize(req);
+        }
+    });
+}
+
+void register_router() {
+    for (int count : {10, 100, 1000, 10000}) {
+        auto r = std::make_shared<router>();
+        for (int i = 0; i < count; ++i) {
+            r->register_route(method::Get, "/api/v1/resource" + std::to_string(i) + "/:id", [](const request&) {
+                response res;
+                res.set_status_code(200);
+                return res;
+            });
+        }
+
+        // a route from the middle of the table: the typical cost of a linear scan
+        auto req  = std::make_shared<request>(method::Get);
+        req->path = "/api/v1/resource" + std::to_string(count / 2) + "/42";
+        add("router::route_request/" + std::to_string(count), 0, [r, req](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                response res;
+                bool found = r->route_request(*req, res);
+                do_not_optimize(found);
+                do_not_optimize(res);
+            }
+        });
+    }
+}
+
+void register_serialize() {
+    for (size_t size : {size_t(13), size_t(64 * 1024)}) {
+        auto res = std::make_shared<response>(response::html(string(size, 'x')));
+        res->set_header("Cache-Control", "no-cache");
+        res->set_header("X-Request-Id", "f3a1c2d4e5");
+        size_t bytes = res->to_string().size();
+        add("response::to_string/" + std::to_string(size), bytes, [res](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                string wire = res->to_string();
+                do_not_optimize(wire);
+            }
+        });
+    }
+}
+
+void register_method() {
+    for (const char* m : {"GET", " delete "}) {
+        string text = m;
+        add(string("method::parse/") + m, text.size(), [text](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                method parsed = method::parse(text);
+                do_not_optimize(parsed);
+            }
+        });
+    }
+}
+
+void register_pattern() {
+    auto pattern = std::make_shared<route_pattern>(route_pattern::from_string("/api/v1/users/:id/posts/:post"));
+    add("route_pattern::match/hit", 0, [pattern](uint64_t n) {
+        const string path = "/api/v1/users/42/posts/7";
+        for (uint64_t i = 0; i < n; ++i) {
+            string_map params;
+            bool matched = pattern->match(path, params);
+            do_not_optimize(matched);
+            do_not_optimize(params);
+        }
+    });
+
+    add("route_pattern::match/miss", 0, [pattern](uint64_t n) {
+        const string path = "/api/v1/groups/42";
+        for (uint64_t i = 0; i < n; ++i) {
+            string_map params;
+            bool matched = pattern->match(path, params);
+            do_not_optimize(matched);
+        }
+    });
+}
+
+void register_registry() {
+    // handles are never real sockets here; nothing is opened or closed. The population stays
+    // below FD_SETSIZE so the set keeps every entry on Windows as well.
+    constexpr SOCKET base = 100000;
+    constexpr int population = 48;
+
+    auto reg = std::make_shared<net::socket_registry>();
+    for (int i = 0; i < population; ++i)
+        reg->add(std::make_shared<net::socket>(static_cast<SOCKET>(base + i)));
+
+    auto extra = std::make_shared<net::socket>(static_cast<SOCKET>(base + population));
+    add("socket_registry::add_take", 0, [reg, extra](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            reg->add(extra);
+            net::sock_ptr taken = reg->take(base + population);
+            do_not_optimize(taken);
+        }
+    });
+
+    add("socket_registry::snapshot/" + std::to_string(population), 0, [reg](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            net::socket_set snapshot = reg->snapshot();
+            do_not_optimize(snapshot);
+        }
+    });
+}
+
+void register_pipeline() {
+    // the whole server path from request bytes to response bytes, over in-memory connections
+    auto srv = std::make_shared<server>("127.0.0.1", 0);
+    srv->get("/hello", [](const request&) {
+        response res;
+        res.set_status_code(200);
+        res.set_text("Hello, World!");
+        return res;
+    });
+    for (int i = 0; i < 1000; ++i)
+        srv->get("/api/v1/resource" + std::to_string(i) + "/:id", [](const request& req) {
+            response res;
+            res.set_status_code(200);
+            res.set_text(req.params.at("id"));
+            return res;
+        });
+
+    auto sim = std::make_shared<simulation>(*srv);
+    auto serve = [srv, sim](const string& req, uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            size_t id = sim->connect();
+            sim->send(id, req);
+            sim->step();
+            string out = sim->receive(id);
+            sim->close(id);
+            do_not_optimize(out);
+        }
+    };
+
+    const string hello = "GET /hello HTTP/1.1\r\nHost: bench\r\nUser-Agent: net_microbench\r\n\r\n";
+    add("server_pipeline/hello", hello.size(), [serve, hello](uint64_t n) { serve(hello, n); });
+
+    const string routed = "GET /api/v1/resource917/42 HTTP/1.1\r\nHost: bench\r\n\r\n";
+    add("server_pipeline/route_1000", routed.size(), [serve, routed](uint64_t n) { serve(routed, n); });
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    string filter;
+    double min_time  = 0.2;
+    int repetitions  = 5;
+    string json_path;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        size_t eq  = arg.find('=');
+        if (eq == string::npos)
+            filter = arg;
+        else if (arg.compare(0, eq, "min_time") == 0)
+            min_time = std::atof(arg.c_str() + eq + 1);
+        else if (arg.compare(0, eq, "repetitions") == 0)
+            repetitions = std::max(1, std::atoi(arg.c_str() + eq + 1));
+        else if (arg.compare(0, eq, "json") == 0)
+            json_path = arg.substr(eq + 1);
+    }
+
+    register_parse();
+    register_router();
+    register_serialize();
+    register_method();
+    register_pattern();
+    register_registry();
+    register_pipeline();
+
+    json results = json::array();
+    std::cout << std::left << std::setw(36) << "benchmark" << std::right << std::setw(12) << "iterations"
+              << std::setw(12) << "ns/op" << std::setw(12) << "cycles/op" << std::setw(10) << "cycles/B"
+              << std::setw(10) << "MB/s" << std::setw(11) << "allocs/op" << std::setw(12) << "B alloc/op"
+              << std::endl;
+
+    for (const benchmark& b : registry()) {
+        if (!filter.empty() && b.name.find(filter) == string::npos)
+            continue;
+
+        measurement m = run(b, min_time, repetitions);
+        double per_byte = b.bytes ? m.cycles / b.bytes : 0;
+        double mbps     = b.bytes ? b.bytes / m.ns * 1e9 / 1e6 : 0;
+
+        std::cout << std::left << std::setw(36) << b.name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(12) << m.iterations << std::setw(12) << m.ns << std::setw(12) << m.cycles
+                  << std::setw(10) << std::setprecision(2) << per_byte << std::setw(10)
+                  << std::setprecision(0) << mbps << std::setw(11) << std::setprecision(1) << m.allocs
+                  << std::setw(12) << std::setprecision(0) << m.alloc_bytes << std::endl;
+
+        results.push_back({{"name", b.name},
+                           {"iterations", m.iterations},
+                           {"ns_per_op", m.ns},
+                           {"cycles_per_op", m.cycles},
+                           {"cycles_per_byte", per_byte},
+                           {"bytes_per_op", b.bytes},
+                           {"allocs_per_op", m.allocs},
+                           {"alloc_bytes_per_op", m.alloc_bytes}});
+    }
+
+    if (!json_path.empty())
+        std::ofstream(json_path) << json{{"benchmark", "net_microbench"}, {"results", results}}.dump(2) << std::endl;
+    return 0;
+}
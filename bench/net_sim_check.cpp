@@ -0,0 +1,92 @@
+// Scripted clients against the server over simulated connections (sim/simulation.h): a reader
+// that drains a large response a little at a time, and one that stops reading until the write
+// timeout passes on the simulation's clock. Runs in well under a second and exits non-zero on
+// the first check that fails.
+//
+//   net_sim_check
+
+// std
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+// lib
+#include <net/http/sim/simulation.h>
+
+using namespace net::http;
+using namespace std::chrono_literals;
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char* what) {
+    std::cerr << (ok ? "ok   " : "FAIL ") << what << std::endl;
+    if (!ok)
+        ++failures;
+}
+
+const string get_big = "GET /big HTTP/1.1\r\nHost: sim\r\n\r\n";
+constexpr size_t body_size = 100000;
+constexpr size_t capacity  = 4096;
+
+// the client reads 1000 bytes per step; the response must arrive whole
+void slow_reader(server& srv) {
+    simulation sim(srv, capacity);
+    size_t id = sim.connect();
+    sim.send(id, get_big);
+
+    sim.step();
+    check(sim.blocked(id), "slow_reader: a full pipe blocks the response");
+
+    string received;
+    for (int i = 0; i < 1000 && !sim.closed(id); ++i) {
+        received += sim.receive(id, 1000);
+        sim.step();
+    }
+    received += sim.receive(id);
+
+    check(sim.closed(id), "slow_reader: the response completes");
+    check(received.size() > body_size && received.compare(received.size() - 5, 5, "zzzzz") == 0,
+          "slow_reader: the whole body arrives");
+    check(sim.now() == 0ms, "slow_reader: no simulated time passes");
+}
+
+// the client never reads; the server gives up once write_timeout_ms passed on the sim clock
+void stalled_reader(server& srv) {
+    simulation sim(srv, capacity);
+    size_t id = sim.connect();
+    sim.send(id, get_big);
+    sim.step();
+
+    sim.advance(29s);
+    sim.step();
+    check(sim.blocked(id), "stalled_reader: still waiting before the write timeout");
+
+    sim.advance(2s);
+    sim.step();
+    check(sim.closed(id), "stalled_reader: closed after the write timeout");
+    check(srv.stats().value(metrics::counter::timeouts) == 1, "stalled_reader: counted as a timeout");
+
+    string received = sim.receive(id);
+    check(received.size() <= capacity, "stalled_reader: only what fit the pipe went out");
+}
+
+} // namespace
+
+int main() {
+    server srv("127.0.0.1", 0);
+    srv.get("/big", [](const request&) {
+        response res;
+        res.set_status_code(200);
+        res.set_text(string(body_size, 'z'));
+        return res;
+    });
+
+    slow_reader(srv);
+    stalled_reader(srv);
+
+    std::cerr << (failures ? "failed" : "passed") << std::endl;
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+// Round-trip latency of the full http::server pipeline over loopback TCP vs a unix socket.
+//
+//   net_uds_bench [requests=20000] [payload_bytes=64]
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// lib
+#include <net/http/server.h>
+
+using namespace net::http;
+using clock_type = std::chrono::steady_clock;
+
+namespace {
+
+string payload;
+
+response echo_payload(const request&) {
+    response res;
+    res.set_status_code(200);
+    res.set_text(payload);
+    return res;
+}
+
+struct result {
+    string name;
+    std::vector<double> samples_us;
+
+    double percentile(double p) const {
+        if (samples_us.empty())
+            return 0;
+        size_t idx = static_cast<size_t>(p * (samples_us.size() - 1));
+        return samples_us[idx];
+    }
+};
+
+result run(const string& name, const net::ip_endpoint& ep, int requests) {
+    const string req = "GET /bench HTTP/1.1\r\nHost: bench\r\n\r\n";
+
+    result r{name, {}};
+    r.samples_us.reserve(requests);
+
+    string sink;
+    for (int i = 0; i < requests; ++i) {
+        auto begin = clock_type::now();
+
+        net::socket client(ep);
+        if (!client.connect(ep)) {
+            std::cerr << name << ": connect failed " << net::get_socket_error() << std::endl;
+            break;
+        }
+
+        client.write(req);
+        sink.clear();
+        while (client.read(sink) > 0) {
+        }
+        client.close();
+
+        auto elapsed = std::chrono::duration<double, std::micro>(clock_type::now() - begin);
+        r.samples_us.push_back(elapsed.count());
+    }
+
+    std::sort(r.samples_us.begin(), r.samples_us.end());
+    return r;
+}
+
+void report(const result& r) {
+    double total = 0;
+    for (double s : r.samples_us)
+        total += s;
+
+    std::cout << std::left << std::setw(8) << r.name << std::fixed << std::setprecision(1)
+              << " n=" << r.samples_us.size()
+              << " mean=" << (r.samples_us.empty() ? 0 : total / r.samples_us.size()) << "us"
+              << " p50=" << r.percentile(0.50) << "us"
+              << " p99=" << r.percentile(0.99) << "us"
+              << " rps=" << (total > 0 ? r.samples_us.size() * 1e6 / total : 0) << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int requests  = argc > 1 ? std::atoi(argv[1]) : 20000;
+    int body_size = argc > 2 ? std::atoi(argv[2]) : 64;
+    payload.assign(body_size, 'x');
+
+    const int tcp_port = 18080;
+    net::ip_endpoint tcp_ep("127.0.0.1", tcp_port);
+#ifdef __linux__
+    net::ip_endpoint uds_ep = net::ip_endpoint::abstract_unix("net_uds_bench");
+#else
+    net::ip_endpoint uds_ep = net::ip_endpoint::unix_path("net_uds_bench.sock");
+#endif
+
+    server tcp_server("127.0.0.1", tcp_port);
+    server uds_server(uds_ep);
+    tcp_server.get("/bench", echo_payload);
+    uds_server.get("/bench", echo_payload);
+    tcp_server.start();
+    uds_server.start();
+
+    // warm both paths before measuring
+    run("warmup", tcp_ep, 200);
+    run("warmup", uds_ep, 200);
+
+    report(run("tcp", tcp_ep, requests));
+    report(run("uds", uds_ep, requests));
+
+    tcp_server.stop();
+    uds_server.stop();
+    return 0;
+}
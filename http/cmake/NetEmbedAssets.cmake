@@ -0,0 +1,42 @@
+# net_embed_assets(<target> NAME <identifier> DIRECTORY <dir> [CACHE_CONTROL <value>])
+#
+# Compiles every file under <dir> into <target> as constexpr byte arrays, with ETag, MIME type,
+# a gzip variant where it is smaller and the complete response heads generated at build time.
+# The target can then #include <net_assets/<identifier>.h> and serve them with
+# server::assets(<identifier>::assets). Files are re-embedded when they change; new files are
+# picked up on the next configure.
+
+set(NET_EMBED_ASSETS_GENERATOR ${CMAKE_CURRENT_LIST_DIR}/NetEmbedAssetsGenerate.cmake CACHE INTERNAL "")
+
+function(net_embed_assets target)
+	cmake_parse_arguments(ARG "" "NAME;DIRECTORY;CACHE_CONTROL" "" ${ARGN})
+	if(NOT ARG_NAME OR NOT ARG_DIRECTORY)
+		message(FATAL_ERROR "net_embed_assets: NAME and DIRECTORY are required")
+	endif()
+	if(NOT ARG_CACHE_CONTROL)
+		set(ARG_CACHE_CONTROL "no-cache")
+	endif()
+
+	get_filename_component(dir ${ARG_DIRECTORY} ABSOLUTE)
+	file(GLOB_RECURSE files CONFIGURE_DEPENDS ${dir}/*)
+
+	set(out_dir ${CMAKE_CURRENT_BINARY_DIR}/net_assets_${ARG_NAME})
+	set(header ${out_dir}/net_assets/${ARG_NAME}.h)
+
+	add_custom_command(
+		OUTPUT ${header}
+		COMMAND ${CMAKE_COMMAND}
+			-DNAME=${ARG_NAME}
+			-DDIRECTORY=${dir}
+			-DOUTPUT=${header}
+			-DCACHE_CONTROL=${ARG_CACHE_CONTROL}
+			-P ${NET_EMBED_ASSETS_GENERATOR}
+		DEPENDS ${files} ${NET_EMBED_ASSETS_GENERATOR}
+		COMMENT "Embedding assets ${ARG_NAME} from ${dir}"
+		VERBATIM
+	)
+
+	add_custom_target(${target}_${ARG_NAME}_assets DEPENDS ${header})
+	add_dependencies(${target} ${target}_${ARG_NAME}_assets)
+	target_include_directories(${target} PRIVATE ${out_dir})
+endfunction()
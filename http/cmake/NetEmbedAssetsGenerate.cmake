@@ -0,0 +1,179 @@
+# Run by net_embed_assets in script mode:
+#   cmake -DNAME=<identifier> -DDIRECTORY=<dir> -DOUTPUT=<header> -DCACHE_CONTROL=<value> -P NetEmbedAssetsGenerate.cmake
+
+cmake_minimum_required(VERSION 3.23)
+
+function(mime_type file out)
+	get_filename_component(ext ${file} LAST_EXT)
+	string(TOLOWER "${ext}" ext)
+	set(type "application/octet-stream")
+	if(ext STREQUAL ".html" OR ext STREQUAL ".htm")
+		set(type "text/html; charset=utf-8")
+	elseif(ext STREQUAL ".css")
+		set(type "text/css; charset=utf-8")
+	elseif(ext STREQUAL ".js" OR ext STREQUAL ".mjs")
+		set(type "text/javascript; charset=utf-8")
+	elseif(ext STREQUAL ".json" OR ext STREQUAL ".map")
+		set(type "application/json")
+	elseif(ext STREQUAL ".txt")
+		set(type "text/plain; charset=utf-8")
+	elseif(ext STREQUAL ".svg")
+		set(type "image/svg+xml")
+	elseif(ext STREQUAL ".png")
+		set(type "image/png")
+	elseif(ext STREQUAL ".jpg" OR ext STREQUAL ".jpeg")
+		set(type "image/jpeg")
+	elseif(ext STREQUAL ".gif")
+		set(type "image/gif")
+	elseif(ext STREQUAL ".webp")
+		set(type "image/webp")
+	elseif(ext STREQUAL ".ico")
+		set(type "image/x-icon")
+	elseif(ext STREQUAL ".woff2")
+		set(type "font/woff2")
+	elseif(ext STREQUAL ".woff")
+		set(type "font/woff")
+	elseif(ext STREQUAL ".wasm")
+		set(type "application/wasm")
+	endif()
+	set(${out} "${type}" PARENT_SCOPE)
+endfunction()
+
+# already compressed formats are not worth a gzip variant
+function(compressible type out)
+	if(type MATCHES "^text/|javascript|json|xml|wasm|x-icon")
+		set(${out} TRUE PARENT_SCOPE)
+	else()
+		set(${out} FALSE PARENT_SCOPE)
+	endif()
+endfunction()
+
+# '\x3c','\x21',... from a file's bytes
+function(char_array file out)
+	file(READ ${file} hex HEX)
+	string(REGEX REPLACE "([0-9a-f][0-9a-f])" "'\\\\x\\1'," chars "${hex}")
+	set(${out} "${chars}" PARENT_SCOPE)
+endfunction()
+
+# the bytes of a gzip member with its MTIME field (bytes 4-7) zeroed, so builds are reproducible
+function(gzip_char_array file out)
+	file(READ ${file} hex HEX)
+	string(SUBSTRING "${hex}" 0 8 magic)
+	string(SUBSTRING "${hex}" 16 -1 rest)
+	string(REGEX REPLACE "([0-9a-f][0-9a-f])" "'\\\\x\\1'," chars "${magic}00000000${rest}")
+	set(${out} "${chars}" PARENT_SCOPE)
+endfunction()
+
+# `value` with backslashes, quotes and line breaks escaped for a C++ string literal
+function(escape_literal value out)
+	string(REPLACE "\\" "\\\\" value "${value}")
+	string(REPLACE "\"" "\\\"" value "${value}")
+	string(REPLACE "\n" "\\n" value "${value}")
+	string(REPLACE "\r" "\\r" value "${value}")
+	set(${out} "${value}" PARENT_SCOPE)
+endfunction()
+
+# "HTTP/1.1 ..." as a C++ string literal
+function(response_head out status type length etag encoding vary)
+	set(head "HTTP/1.1 ${status}\\r\\n")
+	if(NOT status MATCHES "^304")
+		string(APPEND head "Content-Type: ${type}\\r\\nContent-Length: ${length}\\r\\n")
+	endif()
+	if(encoding)
+		string(APPEND head "Content-Encoding: ${encoding}\\r\\n")
+	endif()
+	string(APPEND head "ETag: \\\"${etag}\\\"\\r\\nCache-Control: ${CACHE_CONTROL}\\r\\n")
+	if(vary)
+		string(APPEND head "Vary: Accept-Encoding\\r\\n")
+	endif()
+	string(APPEND head "Connection: close\\r\\n\\r\\n")
+	set(${out} "\"${head}\"" PARENT_SCOPE)
+endfunction()
+
+file(GLOB_RECURSE files RELATIVE ${DIRECTORY} ${DIRECTORY}/*)
+list(SORT files)
+
+get_filename_component(work_dir ${OUTPUT} DIRECTORY)
+file(MAKE_DIRECTORY ${work_dir})
+
+set(arrays "")
+set(entries "")
+set(index 0)
+foreach(rel ${files})
+	set(path ${DIRECTORY}/${rel})
+	file(SIZE ${path} size)
+	file(SHA1 ${path} sha)
+	string(SUBSTRING ${sha} 0 16 etag)
+	mime_type(${rel} type)
+
+	char_array(${path} body)
+	if(size EQUAL 0)
+		set(body "'\\0'")
+	endif()
+	string(APPEND arrays "inline constexpr char body_${index}[] = {${body}};\n")
+
+	# gzip -9, kept when it saves at least a tenth
+	set(gzip_size 0)
+	compressible("${type}" worth)
+	if(worth AND size GREATER 0)
+		set(gz ${work_dir}/asset_${index}.gz)
+		file(ARCHIVE_CREATE OUTPUT ${gz} PATHS ${path} FORMAT raw COMPRESSION GZip COMPRESSION_LEVEL 9)
+		file(SIZE ${gz} gzip_size)
+		math(EXPR limit "${size} * 9 / 10")
+		if(gzip_size LESS limit)
+			gzip_char_array(${gz} gzip)
+			string(APPEND arrays "inline constexpr char gzip_${index}[] = {${gzip}};\n")
+		else()
+			set(gzip_size 0)
+		endif()
+		file(REMOVE ${gz})
+	endif()
+
+	set(vary FALSE)
+	if(gzip_size GREATER 0)
+		set(vary TRUE)
+	endif()
+
+	response_head(head "200 OK" "${type}" ${size} ${etag} "" ${vary})
+	response_head(not_modified "304 Not Modified" "${type}" 0 ${etag} "" ${vary})
+	if(gzip_size GREATER 0)
+		# a different representation, so a different validator
+		set(gzip_etag "${etag}-gz")
+		response_head(gzip_head "200 OK" "${type}" ${gzip_size} ${gzip_etag} "gzip" TRUE)
+		response_head(gzip_not_modified "304 Not Modified" "${type}" 0 ${gzip_etag} "" TRUE)
+		set(gzip_fields "\"\\\"${gzip_etag}\\\"\",\n     ${gzip_head},\n     {gzip_${index}, ${gzip_size}},\n     ${gzip_not_modified}")
+	else()
+		set(gzip_fields "{}, {}, {}, {}")
+	endif()
+
+	escape_literal("/${rel}" literal_path)
+	string(APPEND entries "    {\"${literal_path}\", \"${type}\", \"\\\"${etag}\\\"\",\n     ${head},\n     {body_${index}, ${size}},\n     ${not_modified},\n     ${gzip_fields}},\n")
+	math(EXPR index "${index} + 1")
+endforeach()
+
+set(content "// Generated by net_embed_assets from ${DIRECTORY}; do not edit.
+#pragma once
+#include <net/http/assets/embedded_asset.h>
+
+namespace ${NAME} {
+
+namespace detail {
+${arrays}} // namespace detail
+
+inline constexpr net::http::embedded_asset assets[] = {
+")
+string(REPLACE "{body_" "{detail::body_" entries "${entries}")
+string(REPLACE "{gzip_" "{detail::gzip_" entries "${entries}")
+string(APPEND content "${entries}};
+
+} // namespace ${NAME}
+")
+
+# leave the header untouched when nothing changed, so dependents are not rebuilt
+if(EXISTS ${OUTPUT})
+	file(READ ${OUTPUT} previous)
+	if(previous STREQUAL content)
+		return()
+	endif()
+endif()
+file(WRITE ${OUTPUT} "${content}")
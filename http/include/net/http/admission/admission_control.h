@@ -0,0 +1,190 @@
+#pragma once
+// std
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string_view>
+
+// lib
+#include <types.h>
+#include "../response.h"
+#include "../routing/route_options.h"
+
+namespace net::http {
+
+struct admission_options {
+    // open connections before the listening socket is left out of select; 0 for no limit
+    size_t max_connections = 0;
+    // requests waiting for a pool thread before new ones are turned away; 0 for no limit
+    size_t max_queue = 1024;
+    // CoDel: shedding starts once the queueing delay stayed above `target` for `interval`
+    std::chrono::milliseconds target{5};
+    std::chrono::milliseconds interval{100};
+    // sent with every 503
+    std::chrono::seconds retry_after{1};
+};
+
+// CoDel (RFC 8289) applied to the request queue: a standing queue, one whose minimum delay
+// stays above target for a whole interval, puts it in the dropping state, where it drops at
+// interval / sqrt(count) spacing until the delay comes back under target. Not thread-safe.
+class codel {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    codel(std::chrono::nanoseconds target, std::chrono::nanoseconds interval)
+        : target_(target), interval_(interval) {}
+
+    bool should_drop(std::chrono::nanoseconds sojourn, clock::time_point now) {
+        if (sojourn < target_) {
+            first_above_ = {};
+            dropping_    = false;
+            return false;
+        }
+
+        if (first_above_ == clock::time_point{}) {
+            first_above_ = now + interval_;
+            return false;
+        }
+
+        if (!dropping_) {
+            if (now < first_above_)
+                return false;
+
+            // re-entering soon after leaving keeps the previous drop rate
+            dropping_  = true;
+            count_     = now - drop_next_ < interval_ * 16 && count_ > 2 ? count_ - 2 : 1;
+            drop_next_ = next(now);
+            return true;
+        }
+
+        if (now < drop_next_)
+            return false;
+
+        ++count_;
+        drop_next_ = next(drop_next_);
+        return true;
+    }
+
+    bool dropping() const { return dropping_; }
+
+  private:
+    std::chrono::nanoseconds target_;
+    std::chrono::nanoseconds interval_;
+
+    clock::time_point first_above_;
+    clock::time_point drop_next_;
+    uint32_t count_ = 0;
+    bool dropping_  = false;
+
+    clock::time_point next(clock::time_point from) const {
+        auto spacing = std::chrono::duration_cast<clock::duration>(interval_ / std::sqrt(static_cast<double>(count_)));
+        return from + spacing;
+    }
+};
+
+// Sits between the accept loop and the thread pool. Requests wait in one queue per priority
+// class; each pool task takes the most urgent one, so health checks and critical routes
+// overtake a backlog of ordinary requests. Requests are rejected when the queue is full
+// (critical ones excepted) and shed when CoDel sees a standing queue; low-priority requests
+// are shed for as long as it stays in the dropping state.
+class admission_control {
+  public:
+    using clock = codel::clock;
+
+    explicit admission_control(admission_options opts = {})
+        : opts_(opts), codel_(opts.target, opts.interval) {}
+
+    const admission_options& options() const { return opts_; }
+
+    // false when the request is turned away; `reject` has then not been called
+    bool push(priority_class priority, std::function<void()> run, std::function<void()> reject) {
+        std::lock_guard lock(mutex_);
+        if (opts_.max_queue && size_ >= opts_.max_queue && priority != priority_class::critical)
+            return false;
+
+        queues_[index(priority)].push_back({clock::now(), std::move(run), std::move(reject)});
+        ++size_;
+        return true;
+    }
+
+    // runs or sheds the most urgent waiting request; one call per successful push
+    void run_next() {
+        entry next;
+        bool shed;
+        {
+            std::lock_guard lock(mutex_);
+            auto* queue = front();
+            if (!queue)
+                return;
+
+            next = std::move(queue->front());
+            queue->pop_front();
+            --size_;
+
+            auto now         = clock::now();
+            bool drop        = codel_.should_drop(now - next.enqueued, now);
+            priority_class p = static_cast<priority_class>(queue - queues_);
+            shed = p != priority_class::critical && (drop || (p == priority_class::low && codel_.dropping()));
+        }
+
+        if (shed)
+            next.reject();
+        else
+            next.run();
+    }
+
+    size_t size() const {
+        std::lock_guard lock(mutex_);
+        return size_;
+    }
+
+    // 503 telling the client when to retry
+    response overloaded() const {
+        response res;
+        res.set_status(503, "Service Unavailable");
+        res.set_header("Retry-After", std::to_string(opts_.retry_after.count()));
+        return res;
+    }
+
+    // method and path (without the query) from the request line of raw request bytes
+    static bool request_line(std::string_view data, string& method, string& path) {
+        size_t sp = data.find(' ');
+        if (sp == std::string_view::npos)
+            return false;
+        size_t end = data.find_first_of(" ?\r\n", sp + 1);
+        if (end == std::string_view::npos)
+            return false;
+
+        method.assign(data.substr(0, sp));
+        path.assign(data.substr(sp + 1, end - sp - 1));
+        return true;
+    }
+
+  private:
+    static constexpr size_t class_count = static_cast<size_t>(priority_class::low) + 1;
+
+    struct entry {
+        clock::time_point enqueued;
+        std::function<void()> run;
+        std::function<void()> reject;
+    };
+
+    admission_options opts_;
+    mutable std::mutex mutex_;
+    std::deque<entry> queues_[class_count];
+    size_t size_ = 0;
+    codel codel_;
+
+    static size_t index(priority_class p) { return static_cast<size_t>(p); }
+
+    std::deque<entry>* front() {
+        for (auto& queue : queues_)
+            if (!queue.empty())
+                return &queue;
+        return nullptr;
+    }
+};
+
+} // namespace net::http
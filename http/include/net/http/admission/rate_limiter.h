@@ -0,0 +1,154 @@
+#pragma once
+// std
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string_view>
+
+// lib
+#include <net/endpoint.h>
+#include <types.h>
+#include "../detail/ascii.h"
+
+namespace net::http {
+
+struct rate_limit_options {
+    // sustained requests per second allowed to one client
+    double rate = 100;
+    // requests a client may make at once after being idle
+    double burst = 50;
+    // clients tracked at the same time; the table is allocated once at this size
+    size_t capacity = 64 * 1024;
+    size_t shards   = 16;
+    // when set, requests carrying this header (an API key) are limited per value instead of
+    // per peer address
+    string key_header;
+};
+
+// GCRA (the generic cell rate algorithm, a token bucket that stores one timestamp per client)
+// over a fixed-size table. Clients hash to a set of `ways` slots within their shard; when
+// the set is full, the slot whose theoretical arrival time lies furthest in the past, i.e.
+// the least recently active client, is reused. Lookups and updates are compare-and-swap on
+// the slot, so the accept loop never blocks on the table and never allocates.
+class rate_limiter {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    explicit rate_limiter(rate_limit_options opts = {})
+        : opts_(std::move(opts)), epoch_(clock::now()) {
+        interval_  = static_cast<int64_t>(1e9 / std::max(opts_.rate, 1e-9));
+        tolerance_ = static_cast<int64_t>(interval_ * (std::max(opts_.burst, 1.0) - 1));
+
+        shards_     = std::max<size_t>(opts_.shards, 1);
+        shard_sets_ = std::max<size_t>(opts_.capacity / (shards_ * ways), 1);
+        slots_      = std::make_unique<slot[]>(shards_ * shard_sets_ * ways);
+    }
+
+    // zero when the request may proceed, otherwise how long the client should wait
+    std::chrono::nanoseconds acquire(uint64_t key, clock::time_point at = clock::now()) {
+        int64_t now = (at - epoch_).count() + interval_ + tolerance_;
+        slot& s     = find(key, now);
+
+        int64_t tat = s.tat.load(std::memory_order_relaxed);
+        while (true) {
+            int64_t base = std::max(tat, now);
+            if (base - now > tolerance_)
+                return std::chrono::nanoseconds(base - now - tolerance_);
+            if (s.tat.compare_exchange_weak(tat, base + interval_, std::memory_order_relaxed))
+                return std::chrono::nanoseconds(0);
+        }
+    }
+
+    // the client a request head belongs to: its API key header when configured and present,
+    // otherwise the peer address
+    uint64_t key(const ip_endpoint& peer, std::string_view head) const {
+        if (!opts_.key_header.empty()) {
+            std::string_view api_key = detail::header_value(head, opts_.key_header);
+            if (!api_key.empty())
+                return hash(api_key, key_seed);
+        }
+
+        const sockaddr_storage& addr = peer.native();
+        if (addr.ss_family == AF_INET) {
+            const auto& in = reinterpret_cast<const sockaddr_in&>(addr).sin_addr;
+            return hash({reinterpret_cast<const char*>(&in), sizeof in}, address_seed);
+        }
+        if (addr.ss_family == AF_INET6) {
+            const auto& in6 = reinterpret_cast<const sockaddr_in6&>(addr).sin6_addr;
+            return hash({reinterpret_cast<const char*>(&in6), sizeof in6}, address_seed);
+        }
+        // unix-domain peers share one bucket
+        return hash({}, address_seed);
+    }
+
+    const rate_limit_options& options() const { return opts_; }
+
+  private:
+    static constexpr size_t ways           = 8;
+    static constexpr uint64_t key_seed     = 0xcbf29ce484222325ull;
+    static constexpr uint64_t address_seed = 0x84222325cbf29ce4ull;
+
+    struct slot {
+        std::atomic<uint64_t> key{0};
+        // theoretical arrival time, in nanoseconds since epoch_ shifted so 0 is long past
+        std::atomic<int64_t> tat{0};
+    };
+
+    rate_limit_options opts_;
+    clock::time_point epoch_;
+    int64_t interval_;
+    int64_t tolerance_;
+
+    size_t shards_;
+    size_t shard_sets_;
+    std::unique_ptr<slot[]> slots_;
+
+    // FNV-1a; 0 marks an empty slot and is never returned
+    static uint64_t hash(std::string_view bytes, uint64_t seed) {
+        uint64_t h = seed;
+        for (unsigned char c : bytes) {
+            h ^= c;
+            h *= 0x100000001b3ull;
+        }
+        return h ? h : 1;
+    }
+
+    slot& find(uint64_t key, int64_t now) {
+        size_t shard = static_cast<size_t>(key % shards_);
+        size_t set   = static_cast<size_t>((key / shards_) % shard_sets_);
+        slot* first  = &slots_[(shard * shard_sets_ + set) * ways];
+
+        slot* victim   = first;
+        int64_t oldest = INT64_MAX;
+        for (size_t i = 0; i < ways; ++i) {
+            slot& s    = first[i];
+            uint64_t k = s.key.load(std::memory_order_acquire);
+            if (k == key)
+                return s;
+
+            if (k == 0) {
+                if (s.key.compare_exchange_strong(k, key, std::memory_order_acq_rel))
+                    return s;
+                if (k == key)
+                    return s;
+            }
+
+            int64_t tat = s.tat.load(std::memory_order_relaxed);
+            if (tat < oldest) {
+                oldest = tat;
+                victim = &s;
+            }
+        }
+
+        // A client whose time has passed carries no state worth keeping. Two clients racing
+        // for the same victim may briefly share it, which only makes the limit stricter.
+        uint64_t k = victim->key.load(std::memory_order_relaxed);
+        if (victim->key.compare_exchange_strong(k, key, std::memory_order_acq_rel))
+            victim->tat.store(std::min(oldest, now), std::memory_order_relaxed);
+        return *victim;
+    }
+};
+
+} // namespace net::http
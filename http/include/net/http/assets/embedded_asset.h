@@ -0,0 +1,64 @@
+#pragma once
+// std
+#include <string_view>
+
+// lib
+#include <types.h>
+#include "../compression/encoding.h"
+#include "../detail/ascii.h"
+#include "../request.h"
+#include "../response.h"
+
+namespace net::http {
+
+// A file compiled into the binary by the net_embed_assets CMake helper (http/cmake). Everything
+// a response needs is generated at build time, heads included, so serving one formats nothing
+// and touches no file: the head and body go out of static memory in a single gathered write.
+struct embedded_asset {
+    std::string_view path;
+    std::string_view content_type;
+    // quoted, as sent
+    std::string_view etag;
+
+    std::string_view head;
+    std::string_view body;
+    std::string_view not_modified_head;
+
+    // empty when gzip did not make the file smaller; the variant has an ETag of its own, since
+    // its bytes differ from the identity body's
+    std::string_view gzip_etag;
+    std::string_view gzip_head;
+    std::string_view gzip_body;
+    std::string_view gzip_not_modified_head;
+
+    response serve(const request& req) const {
+        bool gzip = !gzip_body.empty() &&
+                    compression::quality(req.get_header("Accept-Encoding"), compression::encoding::gzip) > 0;
+        std::string_view tag = gzip ? gzip_etag : etag;
+
+        response res;
+        // for HTTP/2, which frames the headers itself
+        res.set_header("Content-Type", string(content_type));
+        res.set_header("ETag", string(tag));
+        if (!gzip_body.empty())
+            res.set_header("Vary", "Accept-Encoding");
+
+        string if_none_match = req.get_header("If-None-Match");
+        if (!if_none_match.empty() && (if_none_match == "*" || detail::has_token(if_none_match, tag))) {
+            res.set_status_code(304);
+            res.set_static(gzip ? gzip_not_modified_head : not_modified_head, {});
+            return res;
+        }
+
+        res.set_status_code(200);
+        if (gzip) {
+            res.set_header("Content-Encoding", "gzip");
+            res.set_static(gzip_head, gzip_body);
+        } else {
+            res.set_static(head, body);
+        }
+        return res;
+    }
+};
+
+} // namespace net::http
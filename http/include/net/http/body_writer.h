@@ -0,0 +1,124 @@
+#pragma once
+// std
+#include <cstdio>
+#include <string_view>
+
+// lib
+#include <net/socket.h>
+#include "http_types.h"
+
+namespace net::http {
+
+// Destination for a streamed response body. Writers can be stacked (a compressor in front of
+// the socket writer); finish() flushes and terminates the body and must be called exactly once.
+class body_writer {
+  public:
+    virtual ~body_writer() = default;
+
+    virtual bool write(const char* data, size_t len) = 0;
+    virtual bool flush()                             = 0;
+    virtual bool finish()                            = 0;
+
+    bool write(std::string_view data) { return write(data.data(), data.size()); }
+};
+
+// Buffers up to `capacity` bytes and sends them to the socket, framed as HTTP/1.1 chunks
+// when the response length was not known up front.
+class socket_body_writer : public body_writer {
+  public:
+    socket_body_writer(net::socket& socket, bool chunked, size_t capacity = 16 * 1024)
+        : socket_(socket), chunked_(chunked), capacity_(capacity) {
+        buffer_.reserve(capacity_ + chunk_overhead_);
+    }
+
+    bool write(const char* data, size_t len) override {
+        if (failed_)
+            return false;
+
+        if (buffer_.size() + len > capacity_ && !flush())
+            return false;
+
+        if (len >= capacity_) {
+            // large writes go straight out instead of through the buffer
+            return send_chunk(data, len);
+        }
+
+        buffer_.append(data, len);
+        return true;
+    }
+
+    bool flush() override {
+        if (failed_)
+            return false;
+        if (buffer_.empty())
+            return true;
+
+        bool ok = send_chunk(buffer_.data(), buffer_.size());
+        buffer_.clear();
+        return ok;
+    }
+
+    bool finish() override {
+        if (!flush())
+            return false;
+
+        if (chunked_ && !socket_.write_all("0\r\n\r\n", 5))
+            fail();
+
+        return !failed_;
+    }
+
+    size_t bytes_written() const { return bytes_written_; }
+
+    // the client stopped reading for the socket's write timeout
+    bool timed_out() const { return timed_out_; }
+
+    using body_writer::write;
+
+  private:
+    static constexpr size_t chunk_overhead_ = 16;
+
+    net::socket& socket_;
+    bool chunked_;
+    size_t capacity_;
+    string buffer_;
+    string frame_;
+    size_t bytes_written_ = 0;
+    bool failed_          = false;
+    bool timed_out_       = false;
+
+    bool send_chunk(const char* data, size_t len) {
+        bool ok = true;
+        if (!chunked_) {
+            ok = socket_.write_all(data, len);
+        } else {
+            char header[chunk_overhead_];
+            int n = std::snprintf(header, sizeof(header), "%zx\r\n", len);
+
+            if (len < capacity_) {
+                // one send per chunk: header, payload and trailing CRLF together
+                frame_.assign(header, n).append(data, len).append("\r\n", 2);
+                ok = socket_.write_all(frame_);
+            } else {
+                ok = socket_.write_all(header, n) && socket_.write_all(data, len) &&
+                     socket_.write_all("\r\n", 2);
+            }
+        }
+
+        if (!ok) {
+            fail();
+            return false;
+        }
+
+        bytes_written_ += len;
+        return true;
+    }
+
+    // right after the failed write, before anything else touches the socket error
+    void fail() {
+        failed_    = true;
+        timed_out_ = WSAGetLastError() == WSAETIMEDOUT;
+    }
+};
+
+} // namespace net::http
@@ -0,0 +1,313 @@
+#pragma once
+// std
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// lib
+#include <types.h>
+#include "../detail/ascii.h"
+#include "../request.h"
+#include "../response.h"
+
+namespace net::http {
+
+enum class eviction { lru, tiny_lfu };
+
+struct cache_options {
+    std::chrono::milliseconds ttl{60000};
+    size_t max_bytes = 64 * 1024 * 1024;
+    size_t shards    = 16;
+    eviction policy  = eviction::tiny_lfu;
+    // request headers that select a variant, e.g. "Accept-Encoding" when compression is on
+    list<string> vary = {"Accept-Encoding"};
+    bool include_query = true;
+};
+
+namespace detail {
+
+// Count-min sketch with 4-bit saturating counters that are halved every `sample` increments,
+// so frequencies describe recent traffic (TinyLFU).
+class frequency_sketch {
+  public:
+    explicit frequency_sketch(size_t width = 4096) : width_(width), rows_(4, list<uint8_t>(width)) {}
+
+    void increment(size_t hash) {
+        for (size_t i = 0; i < rows_.size(); ++i) {
+            uint8_t& c = rows_[i][index(hash, i)];
+            if (c < 15)
+                ++c;
+        }
+
+        if (++additions_ >= width_ * 10) {
+            for (auto& row : rows_)
+                for (uint8_t& c : row)
+                    c >>= 1;
+            additions_ /= 2;
+        }
+    }
+
+    uint8_t estimate(size_t hash) const {
+        uint8_t m = 15;
+        for (size_t i = 0; i < rows_.size(); ++i)
+            m = std::min(m, rows_[i][index(hash, i)]);
+        return m;
+    }
+
+  private:
+    size_t width_;
+    list<list<uint8_t>> rows_;
+    size_t additions_ = 0;
+
+    size_t index(size_t hash, size_t row) const {
+        uint64_t h = hash * (0x9E3779B97F4A7C15ull + 2 * row);
+        return static_cast<size_t>((h >> 32) % width_);
+    }
+};
+
+} // namespace detail
+
+// Opt-in cache of complete responses for one or more routes (route_options::cache). Entries
+// hold the fully serialized HTTP/1.1 bytes, so a hit skips the handler, the filters and
+// serialization. Every stored response carries an ETag, and a matching If-None-Match is
+// answered with 304 from the cache.
+class response_cache {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    explicit response_cache(cache_options opts = {})
+        : opts_(std::move(opts)), shards_(std::max<size_t>(opts_.shards, 1)) {
+        for (auto& s : shards_)
+            s = std::make_unique<shard>(opts_.max_bytes / shards_.size());
+    }
+
+    string key(const request& req) const {
+        string k = req.http_method.str();
+        k.append(" ").append(req.path);
+        if (opts_.include_query && !req.query_string.empty())
+            k.append("?").append(req.query_string);
+
+        for (const string& name : opts_.vary)
+            k.append("\n").append(req.get_header(name));
+        return k;
+    }
+
+    // fills `res` from the cache; false on a miss
+    bool serve(const string& key, const request& req, response& res) {
+        entry_ptr e = shard_for(key).find(key, hash(key), clock::now(), opts_.policy);
+        if (!e)
+            return false;
+
+        res = matches(req.get_header("If-None-Match"), e->etag) ? not_modified(*e) : e->res;
+        return true;
+    }
+
+    // Caches a freshly produced response if it may be shared, and rewrites `res` to the stored
+    // form so it is serialized only once.
+    void store(const string& key, const request& req, response& res) {
+        if (!storable(req, res))
+            return;
+
+        if (res.get_header("ETag").empty())
+            res.set_header("ETag", make_etag(res.body_view()));
+
+        auto e        = std::make_shared<entry>();
+        e->etag       = res.get_header("ETag");
+        e->expires    = clock::now() + opts_.ttl;
+        string head   = res.head_string();
+        auto wire     = std::make_shared<string>(head);
+        wire->append(res.body_view());
+        e->res        = res;
+        e->res.set_wire(std::move(wire), head.size());
+        e->bytes      = e->res.get_wire()->size() + key.size() + sizeof(entry);
+
+        shard_for(key).insert(key, hash(key), e, opts_.policy);
+
+        res = matches(req.get_header("If-None-Match"), e->etag) ? not_modified(*e) : e->res;
+    }
+
+    // drops every cached variant of `path`, for any method and query
+    void invalidate(const string& path) {
+        for (auto& s : shards_)
+            s->erase_if([&path](const string& key) {
+                size_t start = key.find(' ') + 1;
+                size_t end   = key.find_first_of("?\n", start);
+                return key.compare(start, end == string::npos ? string::npos : end - start, path) == 0;
+            });
+    }
+
+    void clear() {
+        for (auto& s : shards_)
+            s->erase_if([](const string&) { return true; });
+    }
+
+    size_t bytes() const {
+        size_t total = 0;
+        for (auto& s : shards_)
+            total += s->bytes();
+        return total;
+    }
+
+  private:
+    struct entry {
+        response res;
+        string etag;
+        clock::time_point expires;
+        size_t bytes = 0;
+    };
+
+    using entry_ptr = std::shared_ptr<const entry>;
+
+    class shard {
+      public:
+        explicit shard(size_t budget) : budget_(budget) {}
+
+        entry_ptr find(const string& key, size_t h, clock::time_point now, eviction policy) {
+            std::lock_guard lock(mutex_);
+            if (policy == eviction::tiny_lfu)
+                sketch_.increment(h);
+
+            auto it = index_.find(key);
+            if (it == index_.end())
+                return nullptr;
+
+            if (it->second->second->expires <= now) {
+                remove(it->second);
+                return nullptr;
+            }
+
+            lru_.splice(lru_.begin(), lru_, it->second);
+            return it->second->second;
+        }
+
+        void insert(const string& key, size_t h, entry_ptr e, eviction policy) {
+            if (e->bytes > budget_)
+                return;
+
+            std::lock_guard lock(mutex_);
+            auto it = index_.find(key);
+            if (it != index_.end())
+                remove(it->second);
+
+            // TinyLFU admission: a new entry only displaces victims that are used less often,
+            // so a scan of one-off URLs cannot flush the hot set
+            while (bytes_ + e->bytes > budget_ && !lru_.empty()) {
+                if (policy == eviction::tiny_lfu &&
+                    sketch_.estimate(h) <= sketch_.estimate(std::hash<string>()(lru_.back().first)))
+                    return;
+                remove(std::prev(lru_.end()));
+            }
+
+            bytes_ += e->bytes;
+            lru_.emplace_front(key, std::move(e));
+            index_[key] = lru_.begin();
+        }
+
+        template <typename Pred>
+        void erase_if(Pred pred) {
+            std::lock_guard lock(mutex_);
+            for (auto it = lru_.begin(); it != lru_.end();) {
+                auto next = std::next(it);
+                if (pred(it->first))
+                    remove(it);
+                it = next;
+            }
+        }
+
+        size_t bytes() const {
+            std::lock_guard lock(mutex_);
+            return bytes_;
+        }
+
+      private:
+        using slot = std::pair<string, entry_ptr>;
+
+        mutable std::mutex mutex_;
+        std::list<slot> lru_;
+        std::unordered_map<string, std::list<slot>::iterator> index_;
+        detail::frequency_sketch sketch_;
+        size_t bytes_ = 0;
+        size_t budget_;
+
+        void remove(std::list<slot>::iterator it) {
+            bytes_ -= it->second->bytes;
+            index_.erase(it->first);
+            lru_.erase(it);
+        }
+    };
+
+    cache_options opts_;
+    list<std::unique_ptr<shard>> shards_;
+
+    static size_t hash(const string& key) { return std::hash<string>()(key); }
+
+    shard& shard_for(const string& key) { return *shards_[hash(key) % shards_.size()]; }
+
+    static bool storable(const request& req, const response& res) {
+        if (req.http_method.str() != "GET" || res.get_status_code() != 200 || res.is_streaming() ||
+            res.get_wire() || res.is_static())
+            return false;
+
+        string cc = res.get_header("Cache-Control");
+        return cc.find("no-store") == string::npos && cc.find("private") == string::npos &&
+               res.get_header("Set-Cookie").empty();
+    }
+
+    static string make_etag(std::string_view body) {
+        uint64_t h = 14695981039346656037ull;
+        for (unsigned char c : body)
+            h = (h ^ c) * 1099511628211ull;
+
+        char buffer[24];
+        std::snprintf(buffer, sizeof(buffer), "\"%016llx\"", static_cast<unsigned long long>(h));
+        return buffer;
+    }
+
+    // weak comparison (RFC 9110 section 13.1.2): W/ prefixes are ignored
+    static bool matches(const string& if_none_match, const string& etag) {
+        if (if_none_match.empty())
+            return false;
+
+        auto opaque = [](std::string_view t) {
+            if (t.size() >= 2 && t[0] == 'W' && t[1] == '/')
+                t.remove_prefix(2);
+            return t;
+        };
+
+        std::string_view rest = if_none_match;
+        while (!rest.empty()) {
+            size_t comma       = rest.find(',');
+            std::string_view t = rest.substr(0, comma);
+            while (!t.empty() && t.front() == ' ')
+                t.remove_prefix(1);
+            while (!t.empty() && t.back() == ' ')
+                t.remove_suffix(1);
+
+            if (t == "*" || opaque(t) == opaque(etag))
+                return true;
+            if (comma == std::string_view::npos)
+                break;
+            rest.remove_prefix(comma + 1);
+        }
+        return false;
+    }
+
+    static response not_modified(const entry& e) {
+        response res;
+        res.set_status_code(304);
+        res.set_status_message("Not Modified");
+        for (const char* name : {"ETag", "Cache-Control", "Vary", "Expires", "Last-Modified", "Content-Location"}) {
+            string value = e.res.get_header(name);
+            if (!value.empty())
+                res.set_header(name, value);
+        }
+        return res;
+    }
+};
+
+} // namespace net::http
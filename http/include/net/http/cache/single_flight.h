@@ -0,0 +1,129 @@
+#pragma once
+// std
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// lib
+#include <types.h>
+#include "../request.h"
+#include "../response.h"
+
+namespace net::http {
+
+struct single_flight_options {
+    // how long a request waits for the one in flight before running the handler itself
+    std::chrono::milliseconds max_wait{5000};
+    // request headers that are part of the key next to method, path and query
+    list<string> vary = {"Accept-Encoding"};
+};
+
+// Opt-in request coalescing for one or more routes (route_options::coalesce). While a handler
+// runs for a key, identical requests wait for it instead of running it again, and all of them
+// are sent the same serialized response bytes. A waiter runs the handler itself when the
+// wait exceeds max_wait, the handler threw, or its response streams and cannot be shared.
+class single_flight {
+  public:
+    explicit single_flight(single_flight_options opts = {}) : opts_(std::move(opts)) {}
+
+    string key(const request& req) const {
+        string k = req.http_method.str();
+        k.append(" ").append(req.path);
+        if (!req.query_string.empty())
+            k.append("?").append(req.query_string);
+
+        for (const string& name : opts_.vary)
+            k.append("\n").append(req.get_header(name));
+        return k;
+    }
+
+    response run(const string& key, const std::function<response()>& produce) {
+        std::shared_ptr<flight> f;
+        bool leader;
+        {
+            std::lock_guard lock(mutex_);
+            auto it = flights_.find(key);
+            leader  = it == flights_.end();
+            if (leader) {
+                f = std::make_shared<flight>();
+                flights_.emplace(key, f);
+            } else {
+                f = it->second;
+                ++f->waiters;
+            }
+        }
+
+        if (!leader) {
+            std::unique_lock lock(f->mutex);
+            if (f->done_cv.wait_for(lock, opts_.max_wait, [&] { return f->done; }) && f->shared) {
+                coalesced_.fetch_add(1, std::memory_order_relaxed);
+                return f->res;
+            }
+            lock.unlock();
+            return produce();
+        }
+
+        response res;
+        try {
+            res = produce();
+        } catch (...) {
+            finish(key, f, nullptr);
+            throw;
+        }
+        finish(key, f, &res);
+        return res;
+    }
+
+    // requests answered with another request's response
+    uint64_t coalesced() const { return coalesced_.load(std::memory_order_relaxed); }
+
+  private:
+    struct flight {
+        std::mutex mutex;
+        std::condition_variable done_cv;
+        bool done   = false;
+        bool shared = false;
+        response res;
+        // written under single_flight::mutex_
+        size_t waiters = 0;
+    };
+
+    single_flight_options opts_;
+    std::mutex mutex_;
+    std::unordered_map<string, std::shared_ptr<flight>> flights_;
+    std::atomic<uint64_t> coalesced_{0};
+
+    // `res` is null when the handler threw
+    void finish(const string& key, const std::shared_ptr<flight>& f, const response* res) {
+        size_t waiters;
+        {
+            // later requests start a flight of their own
+            std::lock_guard lock(mutex_);
+            flights_.erase(key);
+            waiters = f->waiters;
+        }
+        if (waiters == 0)
+            return;
+
+        std::lock_guard lock(f->mutex);
+        if (res && !res->is_streaming()) {
+            f->res = *res;
+            if (!f->res.get_wire() && !f->res.is_static()) {
+                // serialized once for every waiter
+                string head = f->res.head_string();
+                auto wire   = std::make_shared<string>(head);
+                wire->append(f->res.body_view());
+                f->res.set_wire(std::move(wire), head.size());
+            }
+            f->shared = true;
+        }
+        f->done = true;
+        f->done_cv.notify_all();
+    }
+};
+
+} // namespace net::http
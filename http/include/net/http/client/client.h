@@ -0,0 +1,504 @@
+#pragma once
+// std
+#include <chrono>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+// lib
+#include <net/event_loop.h>
+#include "../request.h"
+#include "connection_pool.h"
+#include "response_parser.h"
+
+namespace net::http {
+
+struct client_options {
+    std::chrono::milliseconds connect_timeout{5000};
+    std::chrono::milliseconds read_timeout{30000};
+    std::chrono::seconds idle_timeout{60};
+    size_t max_connections_per_host = 16;
+    size_t max_idle_per_host        = 16;
+    // requests in flight per connection; values above 1 pipeline idempotent requests
+    size_t pipeline_depth           = 1;
+    // event loop threads; hosts are pinned to one loop so per-host state needs no locking
+    size_t threads                  = 1;
+};
+
+struct client_result {
+    response res;
+    string error;
+
+    bool ok() const { return error.empty(); }
+};
+
+struct url {
+    string host;
+    int port = 80;
+    string target;
+
+    static url parse(const string& text) {
+        url u;
+        size_t pos = 0;
+        if (text.compare(0, 7, "http://") == 0)
+            pos = 7;
+        else if (text.find("://") != string::npos)
+            throw std::invalid_argument("Unsupported URL scheme: " + text);
+
+        size_t path_start = text.find('/', pos);
+        string authority  = text.substr(pos, path_start == string::npos ? string::npos : path_start - pos);
+        u.target          = path_start == string::npos ? "/" : text.substr(path_start);
+
+        size_t colon      = authority.rfind(':');
+        size_t bracket    = authority.rfind(']');
+        if (colon != string::npos && (bracket == string::npos || colon > bracket)) {
+            u.host = authority.substr(0, colon);
+            u.port = std::stoi(authority.substr(colon + 1));
+        } else {
+            u.host = authority;
+        }
+
+        if (u.host.size() > 1 && u.host.front() == '[' && u.host.back() == ']')
+            u.host = u.host.substr(1, u.host.size() - 2);
+
+        if (u.host.empty())
+            throw std::invalid_argument("URL has no host: " + text);
+
+        return u;
+    }
+};
+
+// Asynchronous HTTP/1.1 client. Requests for a host are pinned to one event loop that owns that
+// host's connections, pending queue and keep-alive pool. Callbacks run on that loop thread and
+// must not block.
+class client {
+  public:
+    using callback = std::function<void(client_result&&)>;
+
+    client(client_options options = {}) : options_(options) {
+        size_t count = options_.threads == 0 ? 1 : options_.threads;
+        for (size_t i = 0; i < count; ++i) {
+            auto w    = std::make_unique<worker>(options_);
+            worker* p = w.get();
+            w->thread = std::thread([p] { p->loop.run(); });
+            workers_.push_back(std::move(w));
+        }
+    }
+
+    ~client() {
+        for (auto& w : workers_) {
+            w->loop.stop();
+            if (w->thread.joinable())
+                w->thread.join();
+        }
+    }
+
+    client(const client&)            = delete;
+    client& operator=(const client&) = delete;
+
+    void send(const string& host, int port, request req, callback cb) {
+        if (req.http_version.empty())
+            req.http_version = "HTTP/1.1";
+        if (!req.headers.count("Host"))
+            req.headers["Host"] = port == 80 ? host : host + ":" + std::to_string(port);
+
+        auto p        = std::make_shared<pending>();
+        p->idempotent = req.http_method.equals(method::Get) || req.http_method.str() == "HEAD";
+        p->head       = req.http_method.str() == "HEAD";
+        p->wire       = req.to_string();
+        p->cb         = std::move(cb);
+
+        net::ip_endpoint ep;
+        try {
+            ep = resolve(host, port);
+        } catch (const std::exception& ex) {
+            p->cb({response(), ex.what()});
+            return;
+        }
+
+        string key = host + ":" + std::to_string(port);
+        worker& w  = *workers_[std::hash<string>{}(key) % workers_.size()];
+        w.loop.post([&w, key, ep, p] { w.enqueue(key, ep, p); });
+    }
+
+    void get(const string& target, callback cb) {
+        url u = url::parse(target);
+
+        request req(method::Get);
+        req.full_path = u.target;
+        send(u.host, u.port, std::move(req), std::move(cb));
+    }
+
+    response send(const string& host, int port, request req) {
+        std::promise<client_result> done;
+        auto future = done.get_future();
+        send(host, port, std::move(req), [&done](client_result&& r) { done.set_value(std::move(r)); });
+
+        client_result r = future.get();
+        if (!r.ok())
+            throw std::runtime_error(r.error);
+        return std::move(r.res);
+    }
+
+    response get(const string& target) {
+        url u = url::parse(target);
+
+        request req(method::Get);
+        req.full_path = u.target;
+        return send(u.host, u.port, std::move(req));
+    }
+
+  private:
+    struct pending {
+        string wire;
+        callback cb;
+        bool idempotent = false;
+        bool head       = false;
+        int retries     = 0;
+    };
+
+    struct worker;
+    struct host_state;
+
+    struct connection {
+        net::sock_ptr socket;
+        host_state* host = nullptr;
+        string in;
+        string out;
+        size_t out_offset = 0;
+        std::deque<std::shared_ptr<pending>> inflight;
+        response_parser parser;
+        bool connecting                 = false;
+        net::event_loop::timer_id timer = 0;
+    };
+
+    struct host_state {
+        string key;
+        net::ip_endpoint ep;
+        std::deque<std::shared_ptr<pending>> queue;
+        std::vector<std::shared_ptr<connection>> conns;
+        // cleared once the host answers with Connection: close or HTTP/1.0
+        bool pipelining = true;
+    };
+
+    struct worker {
+        const client_options& options;
+        net::event_loop loop;
+        std::thread thread;
+        connection_pool idle;
+        std::unordered_map<string, host_state> hosts;
+
+        worker(const client_options& o)
+            : options(o), idle(o.max_idle_per_host, o.idle_timeout) {}
+
+        void enqueue(const string& key, const net::ip_endpoint& ep, std::shared_ptr<pending> p) {
+            host_state& h = hosts[key];
+            if (h.key.empty()) {
+                h.key = key;
+                h.ep  = ep;
+            }
+
+            h.queue.push_back(std::move(p));
+            dispatch(h);
+        }
+
+        void dispatch(host_state& h) {
+            while (!h.queue.empty()) {
+                std::shared_ptr<pending>& next   = h.queue.front();
+                std::shared_ptr<connection> conn = pick(h, *next);
+                if (!conn && h.conns.empty()) {
+                    std::shared_ptr<pending> p = std::move(next);
+                    h.queue.pop_front();
+                    p->cb({response(), "connect failed"});
+                    continue;
+                }
+
+                if (!conn)
+                    return; // every connection is busy; completions call dispatch again
+
+                conn->inflight.push_back(next);
+                conn->out.append(next->wire);
+                h.queue.pop_front();
+
+                if (conn->inflight.size() == 1) {
+                    conn->parser.reset(conn->inflight.front()->head);
+                    if (!conn->connecting)
+                        arm(conn, options.read_timeout, "read timeout");
+                }
+
+                if (!conn->connecting)
+                    flush(conn);
+            }
+        }
+
+        std::shared_ptr<connection> pick(host_state& h, const pending& next) {
+            // pipelining only ever stacks idempotent requests behind idempotent ones
+            if (options.pipeline_depth > 1 && next.idempotent && h.pipelining) {
+                for (auto& c : h.conns) {
+                    if (!c->inflight.empty() && c->inflight.size() < options.pipeline_depth &&
+                        c->inflight.back()->idempotent)
+                        return c;
+                }
+            }
+
+            for (auto& c : h.conns)
+                if (c->inflight.empty())
+                    return c;
+
+            if (net::sock_ptr s = idle.acquire(h.key))
+                return adopt(h, std::move(s), false);
+
+            if (h.conns.size() >= options.max_connections_per_host)
+                return nullptr;
+
+            return open(h);
+        }
+
+        std::shared_ptr<connection> open(host_state& h) {
+            net::sock_ptr s;
+            try {
+                s = std::make_shared<net::socket>(h.ep);
+            } catch (const std::exception&) {
+                return nullptr;
+            }
+
+            s->non_blocking = true;
+            u_long mode     = 1;
+            ioctlsocket(*s, FIONBIO, &mode);
+
+            if (!s->connect(h.ep)) {
+                s->close();
+                return nullptr;
+            }
+
+            auto conn = adopt(h, std::move(s), true);
+            arm(conn, options.connect_timeout, "connect timeout");
+            return conn;
+        }
+
+        std::shared_ptr<connection> adopt(host_state& h, net::sock_ptr s, bool connecting) {
+            auto conn        = std::make_shared<connection>();
+            conn->socket     = std::move(s);
+            conn->host       = &h;
+            conn->connecting = connecting;
+            h.conns.push_back(conn);
+
+            std::weak_ptr<connection> weak = conn;
+            loop.watch(*conn->socket, connecting ? net::io_write : net::io_read, [this, weak](int ev) {
+                if (auto c = weak.lock())
+                    on_event(c, ev);
+            });
+            return conn;
+        }
+
+        void arm(const std::shared_ptr<connection>& c, std::chrono::milliseconds timeout,
+                 const char* reason) {
+            loop.cancel(c->timer);
+            std::weak_ptr<connection> weak = c;
+            c->timer = loop.schedule(timeout, [this, weak, reason] {
+                if (auto conn = weak.lock()) {
+                    conn->timer = 0;
+                    fail(conn, reason, false);
+                }
+            });
+        }
+
+        void on_event(const std::shared_ptr<connection>& c, int events) {
+            if (c->connecting) {
+                int err          = 0;
+                socklen_t len    = sizeof(err);
+                getsockopt(*c->socket, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&err), &len);
+                if ((events & net::io_error) || err != 0) {
+                    fail(c, "connect failed", false);
+                    return;
+                }
+
+                c->connecting = false;
+                if (!c->inflight.empty())
+                    arm(c, options.read_timeout, "read timeout");
+                else
+                    loop.cancel(c->timer);
+            }
+
+            if (events & net::io_write)
+                flush(c);
+
+            if ((events & (net::io_read | net::io_error)) && c->socket->is_valid())
+                receive(c);
+        }
+
+        void flush(const std::shared_ptr<connection>& c) {
+            while (c->out_offset < c->out.size()) {
+                int sent = ::send(*c->socket, c->out.data() + c->out_offset,
+                                  static_cast<int>(c->out.size() - c->out_offset), net::send_flags);
+                if (sent > 0) {
+                    c->out_offset += sent;
+                    continue;
+                }
+
+                if (sent < 0 && WSAGetLastError() == WSAEWOULDBLOCK)
+                    break;
+
+                fail(c, "write failed", true);
+                return;
+            }
+
+            if (c->out_offset == c->out.size()) {
+                c->out.clear();
+                c->out_offset = 0;
+            }
+
+            loop.update(*c->socket, c->out.empty() ? net::io_read : net::io_read | net::io_write);
+        }
+
+        void receive(const std::shared_ptr<connection>& c) {
+            char buffer[16384];
+            while (true) {
+                int n = ::recv(*c->socket, buffer, sizeof(buffer), 0);
+                if (n > 0) {
+                    c->in.append(buffer, n);
+                    continue;
+                }
+
+                if (n < 0 && WSAGetLastError() == WSAEWOULDBLOCK)
+                    break;
+
+                // orderly close or hard error
+                parse(c);
+                if (!c->socket->is_valid() || !loop.watching(*c->socket))
+                    return;
+
+                if (!c->inflight.empty()) {
+                    c->parser.finish();
+                    if (c->parser.done() && !complete(c))
+                        return;
+                }
+
+                fail(c, "connection closed by peer", true);
+                return;
+            }
+
+            if (!c->inflight.empty())
+                arm(c, options.read_timeout, "read timeout");
+            parse(c);
+        }
+
+        void parse(const std::shared_ptr<connection>& c) {
+            size_t offset = 0;
+            while (!c->inflight.empty() && offset < c->in.size()) {
+                offset += c->parser.feed(c->in.data() + offset, c->in.size() - offset);
+
+                if (c->parser.failed()) {
+                    c->in.clear();
+                    fail(c, c->parser.error(), false);
+                    return;
+                }
+
+                if (!c->parser.done())
+                    break;
+
+                if (!complete(c))
+                    return;
+            }
+
+            c->in.erase(0, offset);
+        }
+
+        // returns false when the connection was closed or handed back to the pool
+        bool complete(const std::shared_ptr<connection>& c) {
+            std::shared_ptr<pending> p = std::move(c->inflight.front());
+            c->inflight.pop_front();
+            bool keep_alive = c->parser.keep_alive();
+
+            p->cb({c->parser.take(), ""});
+
+            if (!keep_alive) {
+                c->host->pipelining = false;
+                fail(c, "connection closed by peer", true);
+                return false;
+            }
+
+            if (!c->inflight.empty()) {
+                c->parser.reset(c->inflight.front()->head);
+                arm(c, options.read_timeout, "read timeout");
+                return true;
+            }
+
+            loop.cancel(c->timer);
+            c->timer      = 0;
+            host_state& h = *c->host;
+
+            if (!h.queue.empty()) {
+                dispatch(h);
+                return !c->inflight.empty();
+            }
+
+            if (c->in.empty()) {
+                loop.unwatch(*c->socket);
+                idle.release(h.key, c->socket);
+                detach(c);
+                return false;
+            }
+
+            fail(c, "unexpected data on idle connection", false);
+            return false;
+        }
+
+        // Closes the connection. With `retry`, requests that never saw a response byte go back
+        // to the host queue (pipelined requests are idempotent), the rest fail with `reason`.
+        void fail(std::shared_ptr<connection> c, const string& reason, bool retry) {
+            loop.cancel(c->timer);
+            loop.unwatch(*c->socket);
+            c->socket->close();
+            detach(c);
+
+            host_state& h = *c->host;
+            bool started  = c->parser.in_progress();
+            while (!c->inflight.empty()) {
+                std::shared_ptr<pending> p = std::move(c->inflight.back());
+                c->inflight.pop_back();
+
+                bool first = c->inflight.empty();
+                if (retry && p->idempotent && !(first && started) && p->retries++ < 1)
+                    h.queue.push_front(std::move(p));
+                else
+                    p->cb({response(), reason});
+            }
+
+            dispatch(h);
+        }
+
+        void detach(const std::shared_ptr<connection>& c) {
+            auto& conns = c->host->conns;
+            conns.erase(std::remove(conns.begin(), conns.end(), c), conns.end());
+        }
+    };
+
+    client_options options_;
+    std::vector<std::unique_ptr<worker>> workers_;
+
+    std::mutex resolve_mutex_;
+    std::unordered_map<string, net::ip_endpoint> resolved_;
+
+    net::ip_endpoint resolve(const string& host, int port) {
+        string key = host + ":" + std::to_string(port);
+        {
+            std::lock_guard lock(resolve_mutex_);
+            auto it = resolved_.find(key);
+            if (it != resolved_.end())
+                return it->second;
+        }
+
+        net::ip_endpoint ep = net::ip_endpoint::resolve(host, port);
+
+        std::lock_guard lock(resolve_mutex_);
+        resolved_[key] = ep;
+        return ep;
+    }
+};
+
+} // namespace net::http
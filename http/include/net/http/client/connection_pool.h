@@ -0,0 +1,118 @@
+#pragma once
+// std
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+// lib
+#include <net/socket_registry.h>
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+namespace net::http {
+
+// Keep-alive connections keyed by "host:port". Shared by the client and the proxy handler.
+class connection_pool {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    connection_pool(size_t max_idle_per_host = 8,
+                    std::chrono::seconds idle_timeout = std::chrono::seconds(60))
+        : max_idle_per_host_(max_idle_per_host), idle_timeout_(idle_timeout) {}
+
+    ~connection_pool() { clear(); }
+
+    // an idle connection the peer has not closed in the meantime, or nullptr
+    net::sock_ptr acquire(const string& key) {
+        std::lock_guard lock(mutex_);
+        auto it = idle_.find(key);
+        if (it == idle_.end())
+            return nullptr;
+
+        auto& conns           = it->second;
+        clock::time_point now = clock::now();
+        while (!conns.empty()) {
+            entry e = std::move(conns.back());
+            conns.pop_back();
+
+            if (now - e.since < idle_timeout_ && is_reusable(*e.socket))
+                return e.socket;
+
+            e.socket->close();
+        }
+
+        return nullptr;
+    }
+
+    void release(const string& key, net::sock_ptr socket) {
+        if (!socket || !socket->is_valid())
+            return;
+
+        std::lock_guard lock(mutex_);
+        auto& conns = idle_[key];
+        if (conns.size() >= max_idle_per_host_) {
+            conns.front().socket->close();
+            conns.pop_front();
+        }
+
+        conns.push_back({std::move(socket), clock::now()});
+    }
+
+    void evict_expired() {
+        std::lock_guard lock(mutex_);
+        clock::time_point now = clock::now();
+        for (auto& [key, conns] : idle_) {
+            while (!conns.empty() && now - conns.front().since >= idle_timeout_) {
+                conns.front().socket->close();
+                conns.pop_front();
+            }
+        }
+    }
+
+    size_t idle(const string& key) const {
+        std::lock_guard lock(mutex_);
+        auto it = idle_.find(key);
+        return it == idle_.end() ? 0 : it->second.size();
+    }
+
+    void clear() {
+        std::lock_guard lock(mutex_);
+        for (auto& [key, conns] : idle_)
+            for (auto& e : conns)
+                e.socket->close();
+        idle_.clear();
+    }
+
+    // An idle keep-alive socket must have nothing to read: readable means either the peer
+    // closed it (recv == 0) or sent bytes we never asked for, and both make it unusable.
+    static bool is_reusable(const net::socket& s) {
+        if (!s.is_valid())
+            return false;
+
+        pollfd p{};
+        p.fd     = static_cast<decltype(p.fd)>(static_cast<SOCKET>(s));
+        p.events = POLLIN;
+#ifdef _WIN32
+        int ready = ::WSAPoll(&p, 1, 0);
+#else
+        int ready = ::poll(&p, 1, 0);
+#endif
+        return ready == 0;
+    }
+
+  private:
+    struct entry {
+        net::sock_ptr socket;
+        clock::time_point since;
+    };
+
+    size_t max_idle_per_host_;
+    std::chrono::seconds idle_timeout_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<string, std::deque<entry>> idle_;
+};
+
+} // namespace net::http
@@ -0,0 +1,298 @@
+#pragma once
+// std
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <functional>
+#include <string_view>
+
+// lib
+#include "../response.h"
+
+namespace net::http {
+
+// Incremental HTTP/1.x response parser. It scans the caller's receive buffer in place and never
+// buffers partial input itself: feed() consumes only complete protocol elements and reports how
+// many bytes it used, so the caller keeps the unconsumed tail and presents it again with more.
+class response_parser {
+  public:
+    enum class state {
+        status_line,
+        headers,
+        body,
+        chunk_size,
+        chunk_data,
+        chunk_data_end,
+        trailers,
+        until_close,
+        done,
+        error
+    };
+
+    using body_sink = std::function<bool(const char*, size_t)>;
+
+    response_parser() { reset(); }
+
+    void reset(bool head_request = false) {
+        state_          = state::status_line;
+        res_            = response();
+        body_           = list<char>();
+        error_.clear();
+        head_request_   = head_request;
+        remaining_      = 0;
+        content_length_ = -1;
+        chunked_        = false;
+        keep_alive_     = true;
+        sink_           = nullptr;
+    }
+
+    size_t feed(const char* data, size_t len) {
+        size_t pos = 0;
+
+        while (pos < len && state_ != state::done && state_ != state::error) {
+            switch (state_) {
+            case state::status_line:
+            case state::headers:
+            case state::chunk_size:
+            case state::chunk_data_end:
+            case state::trailers: {
+                const char* nl = static_cast<const char*>(std::memchr(data + pos, '\n', len - pos));
+                if (!nl) {
+                    if (len - pos > max_line_)
+                        fail("header line too long");
+                    return pos;
+                }
+
+                size_t line_end = static_cast<size_t>(nl - data);
+                std::string_view line(data + pos, line_end - pos);
+                if (!line.empty() && line.back() == '\r')
+                    line.remove_suffix(1);
+
+                pos = line_end + 1;
+                on_line(line);
+                break;
+            }
+            case state::body:
+            case state::chunk_data: {
+                size_t take = static_cast<size_t>(std::min<uint64_t>(remaining_, len - pos));
+                append_body(data + pos, take);
+                pos += take;
+                remaining_ -= take;
+
+                if (remaining_ == 0 && state_ != state::error)
+                    state_ = state_ == state::body ? complete() : state::chunk_data_end;
+                break;
+            }
+            case state::until_close:
+                append_body(data + pos, len - pos);
+                pos = len;
+                break;
+            default:
+                return pos;
+            }
+        }
+
+        return pos;
+    }
+
+    // peer closed the connection
+    void finish() {
+        if (state_ == state::until_close)
+            state_ = complete();
+        else if (state_ != state::done)
+            fail("connection closed before response was complete");
+    }
+
+    // Hands body bytes to `sink` instead of collecting them, starting with whatever was already
+    // collected. Used to splice a body through without holding it in memory.
+    void stream_body(body_sink sink) {
+        sink_ = std::move(sink);
+        if (!body_.empty()) {
+            if (!sink_(body_.data(), body_.size()))
+                fail("body sink failed");
+            body_.clear();
+        }
+    }
+
+    // status and headers are final; body bytes may still be outstanding
+    bool headers_complete() const {
+        return state_ != state::status_line && state_ != state::headers && state_ != state::error;
+    }
+
+    const response& peek() const { return res_; }
+
+    bool done() const { return state_ == state::done; }
+    bool failed() const { return state_ == state::error; }
+    bool in_progress() const { return state_ != state::status_line && !done() && !failed(); }
+    const string& error() const { return error_; }
+
+    bool keep_alive() const { return keep_alive_; }
+
+    response take() { return std::move(res_); }
+
+  private:
+    static constexpr size_t max_line_ = 64 * 1024;
+
+    state state_;
+    response res_;
+    list<char> body_;
+    string error_;
+    bool head_request_;
+    uint64_t remaining_;
+    int64_t content_length_;
+    bool chunked_;
+    bool keep_alive_;
+    body_sink sink_;
+
+    void append_body(const char* data, size_t len) {
+        if (!sink_)
+            body_.insert(body_.end(), data, data + len);
+        else if (len > 0 && !sink_(data, len))
+            fail("body sink failed");
+    }
+
+    void fail(const string& message) {
+        error_ = message;
+        state_ = state::error;
+    }
+
+    state complete() {
+        res_.set_body(std::move(body_));
+        return state::done;
+    }
+
+    static bool iequals(std::string_view a, std::string_view b) {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+                   return std::tolower(static_cast<unsigned char>(x)) ==
+                          std::tolower(static_cast<unsigned char>(y));
+               });
+    }
+
+    static bool contains_token(std::string_view value, std::string_view token) {
+        for (size_t i = 0; i + token.size() <= value.size(); ++i)
+            if (iequals(value.substr(i, token.size()), token))
+                return true;
+        return false;
+    }
+
+    static std::string_view trim(std::string_view v) {
+        while (!v.empty() && (v.front() == ' ' || v.front() == '\t'))
+            v.remove_prefix(1);
+        while (!v.empty() && (v.back() == ' ' || v.back() == '\t'))
+            v.remove_suffix(1);
+        return v;
+    }
+
+    void on_line(std::string_view line) {
+        switch (state_) {
+        case state::status_line:
+            on_status_line(line);
+            break;
+        case state::headers:
+            if (line.empty())
+                on_headers_complete();
+            else
+                on_header(line);
+            break;
+        case state::chunk_size: {
+            std::string_view hex = trim(line.substr(0, line.find(';')));
+            uint64_t size        = 0;
+            auto [end, ec]       = std::from_chars(hex.data(), hex.data() + hex.size(), size, 16);
+            if (ec != std::errc() || hex.empty()) {
+                fail("invalid chunk size");
+                break;
+            }
+
+            remaining_ = size;
+            state_     = size == 0 ? state::trailers : state::chunk_data;
+            break;
+        }
+        case state::chunk_data_end:
+            if (!line.empty())
+                fail("missing CRLF after chunk");
+            else
+                state_ = state::chunk_size;
+            break;
+        case state::trailers:
+            if (line.empty())
+                state_ = complete();
+            break;
+        default:
+            break;
+        }
+    }
+
+    void on_status_line(std::string_view line) {
+        if (line.empty())
+            return; // tolerate stray CRLF between pipelined responses
+
+        if (line.size() < 12 || line.substr(0, 5) != "HTTP/") {
+            fail("malformed status line");
+            return;
+        }
+
+        int code       = 0;
+        auto [end, ec] = std::from_chars(line.data() + 9, line.data() + 12, code);
+        if (ec != std::errc()) {
+            fail("malformed status code");
+            return;
+        }
+
+        keep_alive_ = line.substr(5, 3) != "1.0";
+        res_.set_status_code(code);
+        res_.set_status_message(string(trim(line.substr(12))));
+        state_ = state::headers;
+    }
+
+    void on_header(std::string_view line) {
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos)
+            return;
+
+        std::string_view name  = trim(line.substr(0, colon));
+        std::string_view value = trim(line.substr(colon + 1));
+
+        if (iequals(name, "Content-Length")) {
+            auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), content_length_);
+            if (ec != std::errc() || content_length_ < 0) {
+                fail("invalid Content-Length");
+                return;
+            }
+        } else if (iequals(name, "Transfer-Encoding")) {
+            chunked_ = contains_token(value, "chunked");
+        } else if (iequals(name, "Connection")) {
+            if (contains_token(value, "close"))
+                keep_alive_ = false;
+            else if (contains_token(value, "keep-alive"))
+                keep_alive_ = true;
+        }
+
+        res_.set_header(string(name), string(value));
+    }
+
+    void on_headers_complete() {
+        int code = res_.get_status_code();
+
+        if (code >= 100 && code < 200) {
+            // interim response (100 Continue): the real one follows on the same stream
+            reset(head_request_);
+            return;
+        }
+
+        if (head_request_ || code == 204 || code == 304) {
+            state_ = complete();
+        } else if (chunked_) {
+            state_ = state::chunk_size;
+        } else if (content_length_ >= 0) {
+            remaining_ = static_cast<uint64_t>(content_length_);
+            body_.reserve(static_cast<size_t>(std::min<int64_t>(content_length_, 16 << 20)));
+            state_ = remaining_ == 0 ? complete() : state::body;
+        } else {
+            keep_alive_ = false;
+            state_      = state::until_close;
+        }
+    }
+};
+
+} // namespace net::http
@@ -0,0 +1,259 @@
+#pragma once
+// std
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// lib
+#include <types.h>
+#include "../body_writer.h"
+#include "encoding.h"
+
+#ifdef NET_HAS_ZLIB
+#include <zlib.h>
+#endif
+#ifdef NET_HAS_ZSTD
+#include <zstd.h>
+#endif
+
+namespace net::http::compression {
+
+enum class flush_mode { none, sync, finish };
+
+namespace detail {
+
+// Compressor state is a few hundred KB per context; each worker thread keeps a couple around
+// and resets them between responses instead of allocating new ones per request.
+template <typename Context>
+class context_pool {
+  public:
+    static std::unique_ptr<Context> acquire(encoding e) {
+        auto& free = pool();
+        for (size_t i = free.size(); i > 0; --i) {
+            if (free[i - 1]->kind() == e) {
+                std::unique_ptr<Context> ctx = std::move(free[i - 1]);
+                free.erase(free.begin() + (i - 1));
+                return ctx;
+            }
+        }
+        return std::make_unique<Context>(e);
+    }
+
+    static void release(std::unique_ptr<Context> ctx) {
+        auto& free = pool();
+        if (ctx && ctx->valid() && free.size() < max_free_)
+            free.push_back(std::move(ctx));
+    }
+
+  private:
+    static constexpr size_t max_free_ = 4;
+
+    static std::vector<std::unique_ptr<Context>>& pool() {
+        thread_local std::vector<std::unique_ptr<Context>> free;
+        return free;
+    }
+};
+
+#ifdef NET_HAS_ZLIB
+class zlib_context {
+  public:
+    explicit zlib_context(encoding e) : kind_(e) {
+        // 15 window bits; +16 selects the gzip wrapper, plain 15 the zlib one ("deflate")
+        int bits = e == encoding::gzip ? 15 + 16 : 15;
+        ok_      = deflateInit2(&z_, level_, Z_DEFLATED, bits, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+
+    ~zlib_context() {
+        if (ok_)
+            deflateEnd(&z_);
+    }
+
+    zlib_context(const zlib_context&)            = delete;
+    zlib_context& operator=(const zlib_context&) = delete;
+
+    encoding kind() const { return kind_; }
+    bool valid() const { return ok_; }
+
+    bool begin(int level) {
+        if (!ok_ || deflateReset(&z_) != Z_OK)
+            return ok_ = false;
+        if (level != level_) {
+            if (deflateParams(&z_, level, Z_DEFAULT_STRATEGY) != Z_OK)
+                return ok_ = false;
+            level_ = level;
+        }
+        return true;
+    }
+
+    bool compress(const char* data, size_t len, string& out, flush_mode mode) {
+        z_.next_in  = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        z_.avail_in = static_cast<uInt>(len);
+        int flush   = mode == flush_mode::finish ? Z_FINISH : mode == flush_mode::sync ? Z_SYNC_FLUSH : Z_NO_FLUSH;
+
+        while (true) {
+            size_t used  = out.size();
+            size_t chunk = len > 16384 ? deflateBound(&z_, static_cast<uLong>(len)) : 16384;
+            out.resize(used + chunk);
+            z_.next_out  = reinterpret_cast<Bytef*>(&out[used]);
+            z_.avail_out = static_cast<uInt>(chunk);
+
+            int result = deflate(&z_, flush);
+            out.resize(used + chunk - z_.avail_out);
+            if (result == Z_STREAM_ERROR)
+                return ok_ = false;
+
+            if (mode == flush_mode::finish ? result == Z_STREAM_END : z_.avail_out != 0)
+                return true;
+        }
+    }
+
+  private:
+    encoding kind_;
+    z_stream z_{};
+    int level_ = Z_DEFAULT_COMPRESSION;
+    bool ok_   = false;
+};
+#endif
+
+#ifdef NET_HAS_ZSTD
+class zstd_context {
+  public:
+    explicit zstd_context(encoding e) : kind_(e), ctx_(ZSTD_createCCtx()) {}
+    ~zstd_context() { ZSTD_freeCCtx(ctx_); }
+
+    zstd_context(const zstd_context&)            = delete;
+    zstd_context& operator=(const zstd_context&) = delete;
+
+    encoding kind() const { return kind_; }
+    bool valid() const { return ctx_ != nullptr; }
+
+    bool begin(int level) {
+        return ctx_ && !ZSTD_isError(ZSTD_CCtx_reset(ctx_, ZSTD_reset_session_only)) &&
+               !ZSTD_isError(ZSTD_CCtx_setParameter(ctx_, ZSTD_c_compressionLevel, level));
+    }
+
+    bool compress(const char* data, size_t len, string& out, flush_mode mode) {
+        ZSTD_inBuffer in{data, len, 0};
+        ZSTD_EndDirective op = mode == flush_mode::finish ? ZSTD_e_end
+                               : mode == flush_mode::sync ? ZSTD_e_flush
+                                                          : ZSTD_e_continue;
+        while (true) {
+            size_t used  = out.size();
+            size_t chunk = ZSTD_CStreamOutSize();
+            out.resize(used + chunk);
+            ZSTD_outBuffer o{&out[used], chunk, 0};
+
+            size_t remaining = ZSTD_compressStream2(ctx_, &o, &in, op);
+            out.resize(used + o.pos);
+            if (ZSTD_isError(remaining))
+                return false;
+
+            if (op == ZSTD_e_continue ? in.pos == in.size : remaining == 0)
+                return true;
+        }
+    }
+
+  private:
+    encoding kind_;
+    ZSTD_CCtx* ctx_;
+};
+#endif
+
+} // namespace detail
+
+// Streaming compressor for one body, backed by a pooled per-thread context.
+class compressor {
+  public:
+    compressor(encoding e, int level) : encoding_(e) {
+#ifdef NET_HAS_ZLIB
+        if (e == encoding::gzip || e == encoding::deflate) {
+            zlib_ = detail::context_pool<detail::zlib_context>::acquire(e);
+            ok_   = zlib_->begin(level);
+        }
+#endif
+#ifdef NET_HAS_ZSTD
+        if (e == encoding::zstd) {
+            zstd_ = detail::context_pool<detail::zstd_context>::acquire(e);
+            ok_   = zstd_->begin(level);
+        }
+#endif
+    }
+
+    ~compressor() {
+#ifdef NET_HAS_ZLIB
+        detail::context_pool<detail::zlib_context>::release(std::move(zlib_));
+#endif
+#ifdef NET_HAS_ZSTD
+        detail::context_pool<detail::zstd_context>::release(std::move(zstd_));
+#endif
+    }
+
+    compressor(const compressor&)            = delete;
+    compressor& operator=(const compressor&) = delete;
+
+    bool valid() const { return ok_; }
+
+    // appends compressed output to `out`
+    bool compress(const char* data, size_t len, string& out, flush_mode mode = flush_mode::none) {
+        if (!ok_)
+            return false;
+#ifdef NET_HAS_ZLIB
+        if (zlib_)
+            return ok_ = zlib_->compress(data, len, out, mode);
+#endif
+#ifdef NET_HAS_ZSTD
+        if (zstd_)
+            return ok_ = zstd_->compress(data, len, out, mode);
+#endif
+        return false;
+    }
+
+  private:
+    encoding encoding_;
+    bool ok_ = false;
+#ifdef NET_HAS_ZLIB
+    std::unique_ptr<detail::zlib_context> zlib_;
+#endif
+#ifdef NET_HAS_ZSTD
+    std::unique_ptr<detail::zstd_context> zstd_;
+#endif
+};
+
+inline bool compress(encoding e, int level, std::string_view in, string& out) {
+    compressor c(e, level);
+    return c.compress(in.data(), in.size(), out, flush_mode::finish);
+}
+
+// Compresses a streamed body into `next`. finish() ends the compressed stream but leaves `next`
+// open; whoever owns `next` finishes it, as for any stacked writer.
+class compress_writer : public body_writer {
+  public:
+    compress_writer(body_writer& next, encoding e, int level, size_t capacity = 16 * 1024)
+        : next_(next), compressor_(e, level), capacity_(capacity) {}
+
+    bool write(const char* data, size_t len) override {
+        if (!compressor_.compress(data, len, buffer_))
+            return false;
+        return buffer_.size() < capacity_ || drain();
+    }
+
+    bool flush() override {
+        return compressor_.compress(nullptr, 0, buffer_, flush_mode::sync) && drain() && next_.flush();
+    }
+
+    bool finish() override { return compressor_.compress(nullptr, 0, buffer_, flush_mode::finish) && drain(); }
+
+  private:
+    body_writer& next_;
+    compressor compressor_;
+    size_t capacity_;
+    string buffer_;
+
+    bool drain() {
+        bool ok = buffer_.empty() || next_.write(buffer_.data(), buffer_.size());
+        buffer_.clear();
+        return ok;
+    }
+};
+
+} // namespace net::http::compression
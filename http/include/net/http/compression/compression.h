@@ -0,0 +1,158 @@
+#pragma once
+// std
+#include <memory>
+
+// lib
+#include "../request.h"
+#include "../response.h"
+#include "codec.h"
+#include "encoding.h"
+#include "precompressed_cache.h"
+
+namespace net::http::compression {
+
+struct options {
+    // smaller bodies are not worth the CPU or the framing overhead
+    size_t min_size = 1024;
+    // Content-Type prefixes that are compressed; images, video and archives already are
+    list<string> mime_types = {"text/", "application/json", "application/javascript",
+                               "application/xml", "image/svg+xml"};
+    list<encoding> preference = {encoding::zstd, encoding::gzip, encoding::deflate};
+    int gzip_level = 6;
+    int zstd_level = 3;
+    // budget of the precompressed variant cache; 0 disables it
+    size_t cache_bytes = 32 * 1024 * 1024;
+};
+
+// Response filter negotiating Accept-Encoding. Buffered bodies are compressed in one pass (or
+// served from the cache when the response is cacheable); streamed bodies are wrapped in a
+// compress_writer and go out chunked.
+class filter {
+  public:
+    filter(options opts = {})
+        : opts_(std::make_shared<const options>(std::move(opts))),
+          cache_(opts_->cache_bytes ? std::make_shared<precompressed_cache>(opts_->cache_bytes) : nullptr) {}
+
+    void operator()(const request& req, response& res) const {
+        int code = res.get_status_code();
+        if (code < 200 || code == 204 || code == 304 || res.is_static() || !res.get_header("Content-Encoding").empty())
+            return;
+        if (!compressible(res.get_content_type()) ||
+            res.get_header("Cache-Control").find("no-transform") != string::npos)
+            return;
+
+        // the representation depends on Accept-Encoding whichever coding is chosen
+        add_vary(res);
+
+        encoding enc = negotiate(req.get_header("Accept-Encoding"), opts_->preference);
+        if (enc == encoding::identity)
+            return;
+
+        if (res.is_streaming()) {
+            compress_stream(res, enc);
+            return;
+        }
+
+        const list<char>& body = res.get_body_data();
+        if (body.size() < opts_->min_size)
+            return;
+
+        std::string_view plain(body.data(), body.size());
+        string key;
+        precompressed_cache::value compressed;
+        if (cache_ && cacheable(res)) {
+            key        = cache_key(enc, req, res, plain);
+            compressed = cache_->find(key);
+        }
+
+        if (!compressed) {
+            string out;
+            out.reserve(plain.size() / 2);
+            if (!compress(enc, level(enc), plain, out) || out.size() >= plain.size())
+                return;
+
+            compressed = std::make_shared<const string>(std::move(out));
+            if (!key.empty())
+                cache_->insert(key, compressed);
+        }
+
+        res.set_body(list<char>(compressed->begin(), compressed->end()));
+        if (!res.get_header("Content-Length").empty()) {
+            res.remove_header("Content-Length");
+            res.set_header("Content-Length", std::to_string(compressed->size()));
+        }
+        mark_encoded(res, enc);
+    }
+
+  private:
+    std::shared_ptr<const options> opts_;
+    std::shared_ptr<precompressed_cache> cache_;
+
+    int level(encoding e) const { return e == encoding::zstd ? opts_->zstd_level : opts_->gzip_level; }
+
+    bool compressible(const string& content_type) const {
+        for (const string& prefix : opts_->mime_types)
+            if (content_type.compare(0, prefix.size(), prefix) == 0)
+                return true;
+        return false;
+    }
+
+    void compress_stream(response& res, encoding enc) const {
+        response::body_stream inner = res.get_stream();
+        int lvl                     = level(enc);
+        res.set_stream([inner, enc, lvl](body_writer& out) {
+            compress_writer writer(out, enc, lvl);
+            return inner(writer) && writer.finish();
+        });
+
+        res.remove_header("Content-Length");
+        mark_encoded(res, enc);
+    }
+
+    static void mark_encoded(response& res, encoding enc) {
+        res.set_header("Content-Encoding", to_string(enc));
+
+        // the compressed bytes differ from the identity ones, so a strong validator would lie
+        string etag = res.get_header("ETag");
+        if (!etag.empty() && etag.compare(0, 2, "W/") != 0) {
+            res.remove_header("ETag");
+            res.set_header("ETag", "W/" + etag);
+        }
+    }
+
+    static void add_vary(response& res) {
+        string vary = res.get_header("Vary");
+        if (http::detail::has_token(vary, "Accept-Encoding") || vary == "*")
+            return;
+
+        res.remove_header("Vary");
+        res.set_header("Vary", vary.empty() ? "Accept-Encoding" : vary + ", Accept-Encoding");
+    }
+
+    // only responses the application marked as reusable; anything else may be per-user
+    static bool cacheable(const response& res) {
+        string cc = res.get_header("Cache-Control");
+        if (cc.find("no-store") != string::npos || cc.find("private") != string::npos)
+            return false;
+        return !res.get_header("ETag").empty() || cc.find("max-age") != string::npos ||
+               cc.find("public") != string::npos;
+    }
+
+    // The validator identifies the body when there is one; otherwise the key includes a hash
+    // of the body, which is far cheaper than compressing it again.
+    static string cache_key(encoding enc, const request& req, const response& res, std::string_view body) {
+        string key = to_string(enc);
+        key.append("\n").append(req.path).append("\n");
+
+        string etag = res.get_header("ETag");
+        if (!etag.empty())
+            return key.append(etag);
+
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : body)
+            hash = (hash ^ c) * 1099511628211ull;
+        return key.append(std::to_string(hash)).append(":").append(std::to_string(body.size()));
+    }
+};
+
+} // namespace net::http::compression
@@ -0,0 +1,103 @@
+#pragma once
+// std
+#include <cstdlib>
+#include <string_view>
+
+// lib
+#include <types.h>
+#include "../detail/ascii.h"
+
+namespace net::http::compression {
+
+enum class encoding { identity, gzip, deflate, zstd };
+
+inline const char* to_string(encoding e) {
+    switch (e) {
+    case encoding::gzip:
+        return "gzip";
+    case encoding::deflate:
+        return "deflate";
+    case encoding::zstd:
+        return "zstd";
+    default:
+        return "identity";
+    }
+}
+
+// whether this build can produce `e` (NET_HAS_ZLIB / NET_HAS_ZSTD from CMake)
+inline bool available(encoding e) {
+    switch (e) {
+    case encoding::identity:
+        return true;
+#ifdef NET_HAS_ZLIB
+    case encoding::gzip:
+    case encoding::deflate:
+        return true;
+#endif
+#ifdef NET_HAS_ZSTD
+    case encoding::zstd:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+// q-value Accept-Encoding gives `e` (RFC 9110 section 12.5.3), 0 when it is not acceptable
+inline double quality(std::string_view accept_encoding, encoding e) {
+    double q              = 0;
+    double wildcard       = -1;
+    bool listed           = false;
+    std::string_view rest = accept_encoding;
+
+    while (!rest.empty()) {
+        size_t comma          = rest.find(',');
+        std::string_view item = rest.substr(0, comma);
+        rest                  = comma == std::string_view::npos ? std::string_view() : rest.substr(comma + 1);
+
+        size_t semi           = item.find(';');
+        std::string_view name = item.substr(0, semi);
+        while (!name.empty() && (name.front() == ' ' || name.front() == '\t'))
+            name.remove_prefix(1);
+        while (!name.empty() && (name.back() == ' ' || name.back() == '\t'))
+            name.remove_suffix(1);
+
+        double value = 1;
+        if (semi != std::string_view::npos) {
+            size_t qpos = item.find("q=", semi);
+            if (qpos != std::string_view::npos)
+                value = std::strtod(string(item.substr(qpos + 2)).c_str(), nullptr);
+        }
+
+        if (http::detail::iequals(name, to_string(e))) {
+            q      = value;
+            listed = true;
+        } else if (name == "*") {
+            wildcard = value;
+        }
+    }
+
+    return !listed && wildcard >= 0 ? wildcard : q;
+}
+
+// Picks the coding with the highest q-value in Accept-Encoding among the available ones; ties
+// go to the earlier entry of `preference`.
+inline encoding negotiate(std::string_view accept_encoding, const list<encoding>& preference) {
+    encoding best = encoding::identity;
+    double best_q = 0;
+
+    for (encoding candidate : preference) {
+        if (candidate == encoding::identity || !available(candidate))
+            continue;
+
+        double q = quality(accept_encoding, candidate);
+        if (q > best_q) {
+            best   = candidate;
+            best_q = q;
+        }
+    }
+
+    return best;
+}
+
+} // namespace net::http::compression
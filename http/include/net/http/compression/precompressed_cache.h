@@ -0,0 +1,69 @@
+#pragma once
+// std
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// lib
+#include <types.h>
+
+namespace net::http::compression {
+
+// Compressed variants of cacheable responses, evicted least-recently-used by total size, so a
+// repeat hit costs a lookup instead of a compression pass.
+class precompressed_cache {
+  public:
+    using value = std::shared_ptr<const string>;
+
+    explicit precompressed_cache(size_t max_bytes = 32 * 1024 * 1024) : max_bytes_(max_bytes) {}
+
+    value find(const string& key) {
+        std::lock_guard lock(mutex_);
+        auto it = index_.find(key);
+        if (it == index_.end())
+            return nullptr;
+
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return it->second->second;
+    }
+
+    void insert(const string& key, value v) {
+        if (!v || v->size() > max_bytes_ / 8)
+            return; // one huge body must not flush everything else
+
+        std::lock_guard lock(mutex_);
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            bytes_ -= it->second->second->size();
+            entries_.erase(it->second);
+            index_.erase(it);
+        }
+
+        bytes_ += v->size();
+        entries_.emplace_front(key, std::move(v));
+        index_[key] = entries_.begin();
+
+        while (bytes_ > max_bytes_ && !entries_.empty()) {
+            bytes_ -= entries_.back().second->size();
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        }
+    }
+
+    size_t bytes() const {
+        std::lock_guard lock(mutex_);
+        return bytes_;
+    }
+
+  private:
+    using entry = std::pair<string, value>;
+
+    mutable std::mutex mutex_;
+    std::list<entry> entries_;
+    std::unordered_map<string, std::list<entry>::iterator> index_;
+    size_t bytes_ = 0;
+    size_t max_bytes_;
+};
+
+} // namespace net::http::compression
@@ -1,9 +1,15 @@
 #pragma once
 // std
+#include <chrono>
 #include <iostream>
+#include <optional>
 
 // lib
+#include <net/socket_options.h>
 #include <net/socket_registry.h>
+#include "logging/access_log.h"
+#include "metrics/metrics.h"
+#include "metrics/tracing.h"
 #include "request.h"
 #include "response.h"
 #include "routing/router.h"
@@ -12,33 +18,214 @@ namespace net::http {
 
 class connection_handler {
     friend class server;
+    friend class simulation;
 
   public:
     connection_handler(net::sock_ptr socket, router& r) : client_socket(socket), r(r) {}
 
     ~connection_handler() {
-        if (client_socket->is_valid())
+        if (client_socket->is_valid() && !upgraded_)
             client_socket->close();
     }
 
-    void handle(const string& request_text) {
+    // set once the connection switched protocols; the socket then belongs to the starter
+    connection_starter take_upgrade() { return std::move(upgrade_); }
+
+    // counts bytes, parse errors and statuses into `m`; `accepted` starts the first-byte clock
+    void set_metrics(metrics* m, std::chrono::steady_clock::time_point accepted) {
+        metrics_  = m;
+        accepted_ = accepted;
+    }
+
+    void set_access_log(access_log* log) { log_ = log; }
+
+    // cork the socket while a response goes out in more than one write
+    void set_cork(bool cork) { cork_ = cork; }
+
+    // stamps the routed, handled and written marks of a sampled request
+    void set_trace(request_trace* trace) { trace_ = trace; }
+
+    void handle(const string& request_text) { handle(std::make_shared<const string>(request_text)); }
+
+    // the request body views `request_text` instead of copying out of it
+    void handle(std::shared_ptr<const string> request_text) {
+        if (connection_starter starter = r.route_preface(*request_text)) {
+            upgrade_  = std::move(starter);
+            upgraded_ = true;
+            return;
+        }
+
+        auto received   = std::chrono::steady_clock::now();
+        size_t bytes_in = request_text->size();
+
         response res;
+        std::optional<request> req;
+        size_t route = metrics::no_route;
         try {
-            request req = request::parse(request_text);
+            req.emplace(request::parse(std::move(request_text)));
+        } catch (const std::exception& ex) {
+            if (metrics_)
+                metrics_->add(metrics::counter::parse_errors);
+            res.set_status(400, "Bad Request");
+        }
+
+        if (req) {
+            try {
+                req->peer = &client_socket->endpoint();
+
+                if (connection_starter starter = r.route_upgrade(*req, res)) {
+                    if (send(res.head_string())) {
+                        upgrade_  = std::move(starter);
+                        upgraded_ = true;
+                    }
+                    return;
+                }
+
+                if (trace_) {
+                    trace_->stamp(request_trace::routed);
+                    trace_->method = req->http_method.str();
+                    trace_->path   = req->path;
+                }
 
-            if (!r.route_request(req, res)) {
-                res.set_status(404, "Not Found");
+                auto started = std::chrono::steady_clock::now();
+                if (!r.route_request(*req, res, &route)) {
+                    res.set_status(404, "Not Found");
+                }
+                if (metrics_)
+                    metrics_->record(metrics::timing::handler, std::chrono::steady_clock::now() - started);
+                if (trace_)
+                    trace_->stamp(request_trace::handled);
+            } catch (const std::exception& ex) {
+                res.set_status(500, "Internal server error");
+                if (trace_)
+                    trace_->stamp(request_trace::handled);
             }
-        } catch (const std::exception& ex) {
-            res.set_status(500, "Internal server error");
         }
 
-        client_socket->write(res.to_string());
+        if (metrics_)
+            metrics_->request(route, res.get_status_code());
+
+        if (trace_ && !req) {
+            trace_->stamp(request_trace::routed);
+            trace_->stamp(request_trace::handled);
+        }
+
+        respond(res);
+
+        if (trace_) {
+            trace_->stamp(request_trace::written);
+            trace_->status = res.get_status_code();
+        }
+
+        if (log_)
+            log_->log(req ? &*req : nullptr, client_socket->endpoint().ip_address(), res.get_status_code(),
+                      bytes_in, bytes_sent_, std::chrono::steady_clock::now() - received);
     }
 
   private:
+    static constexpr size_t inline_body_limit_ = 16 * 1024;
+
     net::sock_ptr client_socket;
     router& r;
+    connection_starter upgrade_;
+    bool upgraded_ = false;
+
+    metrics* metrics_ = nullptr;
+    std::chrono::steady_clock::time_point accepted_;
+    bool first_byte_sent_ = false;
+
+    access_log* log_   = nullptr;
+    size_t bytes_sent_ = 0;
+
+    request_trace* trace_ = nullptr;
+    bool cork_            = false;
+
+    void respond(response& res) {
+        if (res.is_static()) {
+            send(res.static_head(), res.body_view());
+            return;
+        }
+
+        if (res.get_wire()) {
+            // cached responses go out from the shared buffer without being serialized again
+            send(res.get_wire()->data(), res.get_wire()->size());
+            return;
+        }
+
+        if (!res.is_streaming()) {
+            // large bodies are sent from the response itself rather than copied behind the head
+            string head = res.head_string();
+            std::string_view body = res.body_view();
+            if (body.size() <= inline_body_limit_) {
+                head.append(body);
+                send(head);
+            } else {
+                corked(true);
+                if (send(head))
+                    send(body.data(), body.size());
+                corked(false);
+            }
+            return;
+        }
+
+        corked(true);
+        send_streamed(res);
+        corked(false);
+    }
+
+    void corked(bool on) {
+        if (cork_)
+            net::socket_options::set_cork(*client_socket, on);
+    }
+
+    bool send(const char* data, size_t len) { return sent(client_socket->write_all(data, len), len); }
+
+    bool send(const string& data) { return send(data.data(), data.size()); }
+
+    // head and body in one gathered write
+    bool send(std::string_view head, std::string_view body) {
+        return sent(client_socket->write_all(head, body), head.size() + body.size());
+    }
+
+    bool sent(bool ok, size_t len) {
+        if (!ok) {
+            if (metrics_ && WSAGetLastError() == WSAETIMEDOUT)
+                metrics_->add(metrics::counter::timeouts);
+            return false;
+        }
+
+        bytes_sent_ += len;
+        if (metrics_) {
+            if (!first_byte_sent_) {
+                first_byte_sent_ = true;
+                metrics_->record(metrics::timing::first_byte, std::chrono::steady_clock::now() - accepted_);
+            }
+            metrics_->add(metrics::counter::bytes_out, len);
+        }
+        return true;
+    }
+
+    void send_streamed(response& res) {
+        if (!send(res.head_string()))
+            return;
+
+        socket_body_writer writer(*client_socket, res.is_chunked());
+        try {
+            // a failed stream cannot be reported once the head is out; closing the
+            // connection without the terminating chunk tells the client it was cut short
+            if (res.stream_(writer))
+                writer.finish();
+        } catch (const std::exception& ex) {
+            std::cerr << "Response stream failed: " << ex.what() << std::endl;
+        }
+
+        bytes_sent_ += writer.bytes_written();
+        if (metrics_) {
+            metrics_->add(metrics::counter::bytes_out, writer.bytes_written());
+            if (writer.timed_out())
+                metrics_->add(metrics::counter::timeouts);
+        }
+    }
 
     bool parse_http_request(const string& text, request& req) {
         std::istringstream stream(text);
@@ -76,9 +263,9 @@ class connection_handler {
         if (it != req.headers.end()) {
             int content_length = std::stoi(it->second);
             if (content_length > 0) {
-                list<char> body(content_length);
+                string body(content_length, '\0');
                 stream.read(body.data(), content_length);
-                req.body = std::move(body);
+                req.body.assign(std::move(body));
             }
         }
 
@@ -0,0 +1,57 @@
+#pragma once
+// std
+#include <algorithm>
+#include <cctype>
+#include <string_view>
+
+namespace net::http::detail {
+
+// header names and tokens are case-insensitive (RFC 9110 section 5.1)
+inline bool iequals(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+               return std::tolower(static_cast<unsigned char>(x)) ==
+                      std::tolower(static_cast<unsigned char>(y));
+           });
+}
+
+// true when the comma-separated list `value` holds `token`, e.g. "keep-alive, Upgrade"
+inline bool has_token(std::string_view value, std::string_view token) {
+    while (!value.empty()) {
+        size_t comma          = value.find(',');
+        std::string_view item = value.substr(0, comma);
+        while (!item.empty() && (item.front() == ' ' || item.front() == '\t'))
+            item.remove_prefix(1);
+        while (!item.empty() && (item.back() == ' ' || item.back() == '\t'))
+            item.remove_suffix(1);
+
+        if (iequals(item, token))
+            return true;
+        if (comma == std::string_view::npos)
+            break;
+        value.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+// value of the first `name` header in a raw request head, without allocating; empty if absent
+inline std::string_view header_value(std::string_view head, std::string_view name) {
+    while (!head.empty()) {
+        size_t eol            = head.find("\r\n");
+        std::string_view line = head.substr(0, eol);
+        head.remove_prefix(eol == std::string_view::npos ? head.size() : eol + 2);
+
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos || !iequals(line.substr(0, colon), name))
+            continue;
+
+        std::string_view value = line.substr(colon + 1);
+        while (!value.empty() && (value.front() == ' ' || value.front() == '\t'))
+            value.remove_prefix(1);
+        while (!value.empty() && (value.back() == ' ' || value.back() == '\t'))
+            value.remove_suffix(1);
+        return value;
+    }
+    return {};
+}
+
+} // namespace net::http::detail
@@ -0,0 +1,81 @@
+#pragma once
+// std
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace net::http::detail {
+
+inline std::string base64_encode(const uint8_t* data, size_t len, bool url = false) {
+    static constexpr char std_alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    static constexpr char url_alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+    const char* alphabet = url ? url_alphabet : std_alphabet;
+
+    std::string out;
+    out.reserve((len + 2) / 3 * 4);
+
+    size_t i = 0;
+    for (; i + 2 < len; i += 3) {
+        uint32_t v = (uint32_t(data[i]) << 16) | (uint32_t(data[i + 1]) << 8) | data[i + 2];
+        out.push_back(alphabet[(v >> 18) & 63]);
+        out.push_back(alphabet[(v >> 12) & 63]);
+        out.push_back(alphabet[(v >> 6) & 63]);
+        out.push_back(alphabet[v & 63]);
+    }
+
+    if (i < len) {
+        uint32_t v = uint32_t(data[i]) << 16;
+        if (i + 1 < len)
+            v |= uint32_t(data[i + 1]) << 8;
+
+        out.push_back(alphabet[(v >> 18) & 63]);
+        out.push_back(alphabet[(v >> 12) & 63]);
+        if (i + 1 < len)
+            out.push_back(alphabet[(v >> 6) & 63]);
+        else if (!url)
+            out.push_back('=');
+        if (!url)
+            out.push_back('=');
+    }
+
+    return out;
+}
+
+// accepts both alphabets, with or without padding; returns false on any other character
+inline bool base64_decode(std::string_view in, std::string& out) {
+    out.clear();
+    out.reserve(in.size() / 4 * 3 + 3);
+
+    uint32_t acc = 0;
+    int bits     = 0;
+    for (char c : in) {
+        int v;
+        if (c >= 'A' && c <= 'Z')
+            v = c - 'A';
+        else if (c >= 'a' && c <= 'z')
+            v = c - 'a' + 26;
+        else if (c >= '0' && c <= '9')
+            v = c - '0' + 52;
+        else if (c == '+' || c == '-')
+            v = 62;
+        else if (c == '/' || c == '_')
+            v = 63;
+        else if (c == '=')
+            break;
+        else
+            return false;
+
+        acc = (acc << 6) | static_cast<uint32_t>(v);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<char>((acc >> bits) & 0xFF));
+        }
+    }
+
+    return true;
+}
+
+} // namespace net::http::detail
@@ -0,0 +1,101 @@
+#pragma once
+// std
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace net::http::detail {
+
+// SHA-1 for protocol handshakes (RFC 6455 Sec-WebSocket-Accept); not for anything security related.
+class sha1 {
+  public:
+    using digest = std::array<uint8_t, 20>;
+
+    static digest hash(std::string_view data) {
+        sha1 h;
+        h.update(data);
+        return h.final();
+    }
+
+    void update(std::string_view data) {
+        for (char c : data) {
+            block_[block_len_++] = static_cast<uint8_t>(c);
+            if (block_len_ == 64) {
+                transform();
+                block_len_ = 0;
+            }
+        }
+        total_bits_ += static_cast<uint64_t>(data.size()) * 8;
+    }
+
+    digest final() {
+        uint64_t bits        = total_bits_;
+        block_[block_len_++] = 0x80;
+        if (block_len_ > 56) {
+            std::memset(block_ + block_len_, 0, 64 - block_len_);
+            transform();
+            block_len_ = 0;
+        }
+        std::memset(block_ + block_len_, 0, 56 - block_len_);
+        for (int i = 0; i < 8; ++i)
+            block_[56 + i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+        transform();
+
+        digest out{};
+        for (int i = 0; i < 5; ++i)
+            for (int j = 0; j < 4; ++j)
+                out[i * 4 + j] = static_cast<uint8_t>(state_[i] >> (24 - 8 * j));
+        return out;
+    }
+
+  private:
+    uint32_t state_[5]   = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    uint8_t block_[64]   = {};
+    size_t block_len_    = 0;
+    uint64_t total_bits_ = 0;
+
+    static uint32_t rol(uint32_t v, int n) { return (v << n) | (v >> (32 - n)); }
+
+    void transform() {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i)
+            w[i] = (uint32_t(block_[i * 4]) << 24) | (uint32_t(block_[i * 4 + 1]) << 16) |
+                   (uint32_t(block_[i * 4 + 2]) << 8) | uint32_t(block_[i * 4 + 3]);
+        for (int i = 16; i < 80; ++i)
+            w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3], e = state_[4];
+        for (int i = 0; i < 80; ++i) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+
+            uint32_t t = rol(a, 5) + f + e + k + w[i];
+            e          = d;
+            d          = c;
+            c          = rol(b, 30);
+            b          = a;
+            a          = t;
+        }
+
+        state_[0] += a;
+        state_[1] += b;
+        state_[2] += c;
+        state_[3] += d;
+        state_[4] += e;
+    }
+};
+
+} // namespace net::http::detail
@@ -0,0 +1,52 @@
+#pragma once
+// std
+#include <cstdint>
+#include <string_view>
+
+namespace net::http::detail {
+
+// Well-formed UTF-8 (RFC 3629): no overlong forms, no surrogates, nothing past U+10FFFF.
+inline bool valid_utf8(std::string_view s) {
+    size_t i = 0;
+    while (i < s.size()) {
+        uint8_t c = static_cast<uint8_t>(s[i]);
+        if (c < 0x80) {
+            ++i;
+            continue;
+        }
+
+        size_t len;
+        uint8_t lo = 0x80, hi = 0xBF;
+        if (c >= 0xC2 && c <= 0xDF)
+            len = 2;
+        else if (c >= 0xE0 && c <= 0xEF) {
+            len = 3;
+            if (c == 0xE0)
+                lo = 0xA0;
+            else if (c == 0xED)
+                hi = 0x9F;
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            len = 4;
+            if (c == 0xF0)
+                lo = 0x90;
+            else if (c == 0xF4)
+                hi = 0x8F;
+        } else
+            return false;
+
+        if (s.size() - i < len)
+            return false;
+
+        // only the second byte has a narrower range
+        uint8_t second = static_cast<uint8_t>(s[i + 1]);
+        if (second < lo || second > hi)
+            return false;
+        for (size_t k = 2; k < len; ++k)
+            if ((static_cast<uint8_t>(s[i + k]) & 0xC0) != 0x80)
+                return false;
+        i += len;
+    }
+    return true;
+}
+
+} // namespace net::http::detail
@@ -0,0 +1,289 @@
+#pragma once
+// std
+#include <algorithm>
+#include <functional>
+#include <string_view>
+
+// lib
+#include <types.h>
+#include "../detail/ascii.h"
+#include "../request.h"
+
+namespace net::http::form {
+
+// One multipart/form-data part (RFC 7578); `name`, `filename` and `content_type` are taken
+// from its headers.
+struct part {
+    string_map headers;
+    string name;
+    string filename;
+    string content_type;
+
+    bool is_file() const { return !filename.empty(); }
+};
+
+// boundary parameter of a multipart Content-Type; empty when there is none
+inline string multipart_boundary(std::string_view content_type) {
+    size_t semi = content_type.find(';');
+    if (semi == std::string_view::npos)
+        return "";
+
+    std::string_view params = content_type.substr(semi + 1);
+    while (!params.empty()) {
+        size_t next           = params.find(';');
+        std::string_view item = params.substr(0, next);
+        params.remove_prefix(next == std::string_view::npos ? params.size() : next + 1);
+
+        while (!item.empty() && (item.front() == ' ' || item.front() == '\t'))
+            item.remove_prefix(1);
+
+        size_t eq = item.find('=');
+        if (eq == std::string_view::npos || !detail::iequals(item.substr(0, eq), "boundary"))
+            continue;
+
+        std::string_view value = item.substr(eq + 1);
+        while (!value.empty() && (value.back() == ' ' || value.back() == '\t'))
+            value.remove_suffix(1);
+        if (value.size() >= 2 && value.front() == '"' && value.back() == '"')
+            value = value.substr(1, value.size() - 2);
+        return string(value);
+    }
+    return "";
+}
+
+// Incremental multipart/form-data parser. Feed it the body in pieces of any size; part contents
+// are handed to on_data as they arrive, so a file upload is never held in memory as a whole.
+// Only the bytes that might be the start of a boundary split across two pieces are kept back.
+// Boundaries are found with Boyer-Moore-Horspool, which skips most of the payload unread.
+class multipart_parser {
+  public:
+    struct handler {
+        std::function<void(const part&)> on_part_begin;
+        // views the input or an internal buffer; only valid during the call
+        std::function<void(const part&, std::string_view data)> on_data;
+        std::function<void(const part&)> on_part_end;
+    };
+
+    multipart_parser(const string& boundary, handler h, size_t max_header_size = 16 * 1024)
+        : delimiter_("\r\n--" + boundary), searcher_(delimiter_.begin(), delimiter_.end()),
+          handler_(std::move(h)), max_header_size_(max_header_size) {
+        // the first boundary may start the body without a preceding line break
+        tail_ = "\r\n";
+    }
+
+    // the searcher points into delimiter_
+    multipart_parser(const multipart_parser&)            = delete;
+    multipart_parser& operator=(const multipart_parser&) = delete;
+
+    // false once the input is found to be malformed
+    bool feed(std::string_view in) {
+        while (!in.empty() && state_ != state::failed && state_ != state::done) {
+            switch (state_) {
+            case state::preamble:
+            case state::body:
+                if (scan(in, state_ == state::body)) {
+                    if (state_ == state::body && handler_.on_part_end)
+                        handler_.on_part_end(part_);
+                    state_ = state::after_boundary;
+                }
+                break;
+            case state::after_boundary:
+                after_boundary(in);
+                break;
+            case state::headers:
+                headers(in);
+                break;
+            default:
+                in = {};
+                break;
+            }
+        }
+        return state_ != state::failed;
+    }
+
+    bool feed(const char* data, size_t len) { return feed(std::string_view(data, len)); }
+
+    // true when the closing boundary has been seen
+    bool done() const { return state_ == state::done; }
+    bool failed() const { return state_ == state::failed; }
+
+  private:
+    enum class state { preamble, after_boundary, headers, body, done, failed };
+
+    string delimiter_;
+    std::boyer_moore_horspool_searcher<string::const_iterator> searcher_;
+    handler handler_;
+    size_t max_header_size_;
+
+    state state_ = state::preamble;
+    string tail_;
+    string buffer_;
+    part part_;
+
+    void data(std::string_view d) {
+        if (!d.empty() && handler_.on_data)
+            handler_.on_data(part_, d);
+    }
+
+    // Consumes `in` up to and including the next delimiter, passing what precedes it to on_data
+    // when `emit` is set. Without a delimiter, the last delimiter-1 bytes are kept in tail_.
+    bool scan(std::string_view& in, bool emit) {
+        const size_t keep = delimiter_.size() - 1;
+
+        if (!tail_.empty()) {
+            // a delimiter that starts in the kept bytes ends within the next `keep` input bytes
+            string joined = tail_;
+            joined.append(in.substr(0, keep));
+            size_t found = joined.find(delimiter_);
+            if (found != string::npos) {
+                if (emit)
+                    data(std::string_view(joined).substr(0, found));
+                in.remove_prefix(found + delimiter_.size() - tail_.size());
+                tail_.clear();
+                return true;
+            }
+
+            if (in.size() < keep) {
+                tail_ = std::move(joined);
+                if (tail_.size() > keep) {
+                    if (emit)
+                        data(std::string_view(tail_).substr(0, tail_.size() - keep));
+                    tail_.erase(0, tail_.size() - keep);
+                }
+                in = {};
+                return false;
+            }
+
+            if (emit)
+                data(tail_);
+            tail_.clear();
+        }
+
+        auto it = std::search(in.begin(), in.end(), searcher_);
+        if (it != in.end()) {
+            size_t found = static_cast<size_t>(it - in.begin());
+            if (emit)
+                data(in.substr(0, found));
+            in.remove_prefix(found + delimiter_.size());
+            return true;
+        }
+
+        size_t safe = in.size() > keep ? in.size() - keep : 0;
+        if (emit)
+            data(in.substr(0, safe));
+        tail_.assign(in.substr(safe));
+        in = {};
+        return false;
+    }
+
+    // "--" closes the body, CRLF starts the next part's headers
+    void after_boundary(std::string_view& in) {
+        size_t take = std::min(in.size(), 2 - buffer_.size());
+        buffer_.append(in.substr(0, take));
+        in.remove_prefix(take);
+        if (buffer_.size() < 2)
+            return;
+
+        if (buffer_ == "--")
+            state_ = state::done;
+        else if (buffer_ == "\r\n")
+            state_ = state::headers;
+        else
+            state_ = state::failed;
+        buffer_.clear();
+    }
+
+    void headers(std::string_view& in) {
+        size_t before = buffer_.size();
+        size_t take   = std::min(in.size(), max_header_size_ + 4 - before);
+        buffer_.append(in.substr(0, take));
+
+        size_t body_start;
+        size_t block_end;
+        if (buffer_.compare(0, 2, "\r\n") == 0) {
+            block_end  = 0;
+            body_start = 2;
+        } else {
+            size_t end = buffer_.find("\r\n\r\n", before >= 3 ? before - 3 : 0);
+            if (end == string::npos) {
+                in.remove_prefix(take);
+                if (buffer_.size() >= max_header_size_ + 4)
+                    state_ = state::failed;
+                return;
+            }
+            block_end  = end + 2;
+            body_start = end + 4;
+        }
+
+        part_ = part();
+        parse_headers(std::string_view(buffer_).substr(0, block_end));
+        in.remove_prefix(body_start - before);
+        buffer_.clear();
+
+        state_ = state::body;
+        if (handler_.on_part_begin)
+            handler_.on_part_begin(part_);
+    }
+
+    void parse_headers(std::string_view block) {
+        while (!block.empty()) {
+            size_t eol            = block.find("\r\n");
+            std::string_view line = block.substr(0, eol);
+            block.remove_prefix(eol == std::string_view::npos ? block.size() : eol + 2);
+
+            size_t colon = line.find(':');
+            if (colon == std::string_view::npos)
+                continue;
+
+            std::string_view name  = line.substr(0, colon);
+            std::string_view value = line.substr(colon + 1);
+            while (!value.empty() && (value.front() == ' ' || value.front() == '\t'))
+                value.remove_prefix(1);
+
+            if (detail::iequals(name, "Content-Disposition"))
+                parse_disposition(value);
+            else if (detail::iequals(name, "Content-Type"))
+                part_.content_type = string(value);
+            part_.headers[string(name)] = string(value);
+        }
+    }
+
+    // form-data; name="field"; filename="a.txt"
+    void parse_disposition(std::string_view value) {
+        while (!value.empty()) {
+            size_t semi           = value.find(';');
+            std::string_view item = value.substr(0, semi);
+            value.remove_prefix(semi == std::string_view::npos ? value.size() : semi + 1);
+
+            while (!item.empty() && item.front() == ' ')
+                item.remove_prefix(1);
+
+            size_t eq = item.find('=');
+            if (eq == std::string_view::npos)
+                continue;
+
+            std::string_view key = item.substr(0, eq);
+            std::string_view v   = item.substr(eq + 1);
+            if (v.size() >= 2 && v.front() == '"' && v.back() == '"')
+                v = v.substr(1, v.size() - 2);
+
+            if (detail::iequals(key, "name"))
+                part_.name = string(v);
+            else if (detail::iequals(key, "filename"))
+                part_.filename = string(v);
+        }
+    }
+};
+
+// Runs the parser over a buffered request body. False when the request is not multipart or
+// the body ends before the closing boundary.
+inline bool parse_multipart(const request& req, multipart_parser::handler h) {
+    string boundary = multipart_boundary(req.get_header("Content-Type"));
+    if (boundary.empty())
+        return false;
+
+    multipart_parser parser(boundary, std::move(h));
+    return parser.feed(req.body.view()) && parser.done();
+}
+
+} // namespace net::http::form
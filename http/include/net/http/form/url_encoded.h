@@ -0,0 +1,121 @@
+#pragma once
+// std
+#include <string_view>
+
+// lib
+#include <types.h>
+
+namespace net::http::form {
+
+// Percent-decoding (RFC 3986 section 2.1); malformed escapes are kept as they are. In form
+// bodies and query strings '+' stands for a space.
+inline string decode(std::string_view s, bool plus_as_space = true) {
+    if (s.find_first_of(plus_as_space ? "%+" : "%") == std::string_view::npos)
+        return string(s);
+
+    auto hex = [](char c) -> int {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    };
+
+    string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); ++i) {
+        char c = s[i];
+        if (c == '+' && plus_as_space) {
+            out.push_back(' ');
+        } else if (c == '%' && i + 2 < s.size() && hex(s[i + 1]) >= 0 && hex(s[i + 2]) >= 0) {
+            out.push_back(static_cast<char>(hex(s[i + 1]) * 16 + hex(s[i + 2])));
+            i += 2;
+        } else {
+            out.push_back(c);
+        }
+    }
+    return out;
+}
+
+// application/x-www-form-urlencoded fields ("a=1&b=x%20y"). Construction only splits the text;
+// names and values are decoded when they are looked up. The fields view the text they were
+// parsed from, which must outlive them.
+class url_encoded {
+  public:
+    struct field {
+        std::string_view raw_name;
+        std::string_view raw_value;
+
+        string name() const { return decode(raw_name); }
+        string value() const { return decode(raw_value); }
+
+        bool is(std::string_view n) const {
+            if (raw_name.find_first_of("%+") == std::string_view::npos)
+                return raw_name == n;
+            return decode(raw_name) == n;
+        }
+    };
+
+    url_encoded() = default;
+
+    explicit url_encoded(std::string_view text) {
+        while (!text.empty()) {
+            size_t amp           = text.find('&');
+            std::string_view kv  = text.substr(0, amp);
+            text.remove_prefix(amp == std::string_view::npos ? text.size() : amp + 1);
+            if (kv.empty())
+                continue;
+
+            size_t eq = kv.find('=');
+            if (eq == std::string_view::npos)
+                fields_.push_back({kv, {}});
+            else
+                fields_.push_back({kv.substr(0, eq), kv.substr(eq + 1)});
+        }
+    }
+
+    bool has(std::string_view name) const { return find(name) != nullptr; }
+
+    // first value of `name`, decoded; empty when missing
+    string get(std::string_view name) const {
+        const field* f = find(name);
+        return f ? f->value() : string();
+    }
+
+    list<string> get_all(std::string_view name) const {
+        list<string> values;
+        for (const field& f : fields_)
+            if (f.is(name))
+                values.push_back(f.value());
+        return values;
+    }
+
+    const list<field>& fields() const { return fields_; }
+    size_t size() const { return fields_.size(); }
+    bool empty() const { return fields_.empty(); }
+
+    list<field>::const_iterator begin() const { return fields_.begin(); }
+    list<field>::const_iterator end() const { return fields_.end(); }
+
+    // decodes everything; later duplicates win
+    string_map to_map() const {
+        string_map out;
+        for (const field& f : fields_)
+            out[f.name()] = f.value();
+        return out;
+    }
+
+  private:
+    list<field> fields_;
+
+    const field* find(std::string_view name) const {
+        for (const field& f : fields_)
+            if (f.is(name))
+                return &f;
+        return nullptr;
+    }
+};
+
+} // namespace net::http::form
@@ -0,0 +1,842 @@
+#pragma once
+// std
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+// lib
+#include <net/event_loop.h>
+#include <net/output_queue.h>
+#include <net/socket_registry.h>
+#include "../body_writer.h"
+#include "../routing/router.h"
+#include "frame.h"
+#include "hpack.h"
+
+namespace net::http::http2 {
+
+struct options {
+    uint32_t max_concurrent_streams = 100;
+    // receive windows; larger than the protocol default so uploads are not throttled by RTT
+    uint32_t initial_window_size    = 1024 * 1024;
+    uint32_t connection_window      = 4 * 1024 * 1024;
+    uint32_t max_header_list_size   = 64 * 1024;
+    size_t max_body_size            = 16 * 1024 * 1024;
+    // response bytes a streaming handler may get ahead of the client before it blocks
+    size_t max_buffered_per_stream  = 1024 * 1024;
+};
+
+// runs a handler off the event loop, e.g. on the server's thread pool
+using executor = std::function<void(std::function<void()>)>;
+
+// Back-pressure between a handler streaming its body on a worker thread and the loop framing it.
+struct body_channel {
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t queued  = 0;
+    bool cancelled = false;
+
+    bool reserve(size_t n, size_t limit) {
+        std::unique_lock lock(mutex);
+        cv.wait(lock, [&] { return cancelled || queued < limit; });
+        queued += n;
+        return !cancelled;
+    }
+
+    void sent(size_t n) {
+        {
+            std::lock_guard lock(mutex);
+            queued -= std::min(n, queued);
+        }
+        cv.notify_all();
+    }
+
+    bool is_cancelled() {
+        std::lock_guard lock(mutex);
+        return cancelled;
+    }
+
+    void cancel() {
+        {
+            std::lock_guard lock(mutex);
+            cancelled = true;
+        }
+        cv.notify_all();
+    }
+};
+
+// One HTTP/2 connection (RFC 7540) on the event loop. Frames are parsed and produced on the
+// loop thread; each complete request runs through the router on the executor, and its response
+// is framed back on the loop under per-stream and connection flow control.
+class connection : public std::enable_shared_from_this<connection> {
+  public:
+    connection(net::event_loop& loop, net::sock_ptr socket, router& r, executor exec, const options& opts)
+        : loop_(loop), socket_(std::move(socket)), router_(r), exec_(std::move(exec)), opts_(opts),
+          decoder_(table_size_, opts.max_header_list_size) {
+        local_.max_concurrent_streams = opts_.max_concurrent_streams;
+        local_.initial_window_size    = opts_.initial_window_size;
+        local_.max_header_list_size   = opts_.max_header_list_size;
+        recv_window_                  = std::max<int64_t>(opts_.connection_window, default_window);
+    }
+
+    // prior knowledge: `initial` is everything read from the socket so far, preface included
+    void start(const string& initial) {
+        in_ = initial;
+        begin();
+    }
+
+    // h2c upgrade (RFC 7540 section 3.2): the upgrading request becomes stream 1, which the
+    // client has already half-closed; `peer` comes from its HTTP2-Settings header
+    void start_upgraded(request req, const settings& peer) {
+        peer_ = peer;
+        encoder_.set_max_table_size(std::min<uint32_t>(peer_.header_table_size, table_size_));
+
+        // only bodiless requests are upgraded, so anything after the head is the client preface
+        in_.assign(req.body.begin(), req.body.end());
+        req.body.clear();
+        req.peer = &socket_->endpoint();
+
+        last_stream_id_ = 1;
+        stream& s       = open_stream(1);
+        s.req           = std::move(req);
+        s.remote_closed = true;
+        dispatch(1, s);
+
+        begin();
+    }
+
+    // loop thread: GOAWAY, no new streams; the connection closes once the open ones are done
+    void go_away() {
+        if (going_away_ || closing_ || closed_)
+            return;
+
+        going_away_ = true;
+        if (streams_.empty()) {
+            begin_close(error_code::no_error);
+            return;
+        }
+        out_.push(encode_goaway(last_stream_id_, error_code::no_error));
+        flush();
+    }
+
+    // loop thread: `fn` runs once when the connection is closed
+    void on_shutdown(std::function<void()> fn) { on_shutdown_ = std::move(fn); }
+
+  private:
+    using connection_ptr = std::shared_ptr<connection>;
+
+    static constexpr uint32_t table_size_ = 4096;
+    static constexpr size_t high_water_   = 256 * 1024;
+
+    struct stream {
+        request req;
+        bool remote_closed = false;
+        bool headers_sent  = false;
+        bool streaming     = false;
+        // the last body byte is in `pending`; END_STREAM goes out with it
+        bool end_queued    = false;
+        int64_t send_window;
+        int64_t recv_window;
+        uint32_t recv_unacked = 0;
+        string pending;
+        size_t pending_offset = 0;
+        std::shared_ptr<body_channel> channel;
+    };
+
+    // worker-side body_writer: chunks are handed to the loop, bounded by the stream's channel
+    class stream_writer : public body_writer {
+      public:
+        stream_writer(connection_ptr conn, uint32_t id, std::shared_ptr<body_channel> channel)
+            : conn_(std::move(conn)), id_(id), channel_(std::move(channel)) {}
+
+        bool write(const char* data, size_t len) override {
+            buffer_.append(data, len);
+            return buffer_.size() < min_frame_size || flush();
+        }
+
+        bool flush() override { return send(false); }
+
+        bool finish() override { return send(true); }
+
+        void abort() {
+            connection_ptr conn = conn_;
+            uint32_t id         = id_;
+            conn->loop_.post([conn, id] {
+                conn->reset(id, error_code::internal_error);
+                conn->pump();
+            });
+        }
+
+      private:
+        connection_ptr conn_;
+        uint32_t id_;
+        std::shared_ptr<body_channel> channel_;
+        string buffer_;
+
+        bool send(bool end) {
+            if (buffer_.empty() && !end)
+                return true;
+            if (!channel_->reserve(buffer_.size(), conn_->opts_.max_buffered_per_stream))
+                return false;
+
+            connection_ptr conn = conn_;
+            uint32_t id         = id_;
+            conn->loop_.post([conn, id, chunk = std::move(buffer_), end]() mutable {
+                conn->on_body(id, std::move(chunk), end);
+            });
+            buffer_.clear();
+            return true;
+        }
+    };
+
+    net::event_loop& loop_;
+    net::sock_ptr socket_;
+    router& router_;
+    executor exec_;
+    options opts_;
+
+    settings local_;
+    settings peer_;
+    hpack::decoder decoder_;
+    hpack::encoder encoder_;
+
+    std::map<uint32_t, stream> streams_;
+    uint32_t last_stream_id_ = 0;
+
+    string in_;
+    output_queue out_;
+    bool preface_received_ = false;
+    bool going_away_       = false;
+    bool closing_          = false;
+    std::function<void()> on_shutdown_;
+    bool closed_           = false;
+
+    int64_t send_window_ = default_window;
+    int64_t recv_window_;
+    uint32_t recv_unacked_ = 0;
+
+    // header block being collected across HEADERS and CONTINUATION frames
+    string header_block_;
+    uint32_t header_stream_ = 0;
+    bool header_end_stream_ = false;
+    bool in_continuation_   = false;
+
+    void begin() {
+        u_long mode           = 1;
+        socket_->non_blocking = true;
+        ioctlsocket(*socket_, FIONBIO, &mode);
+
+        // the reactor owns the connection until shutdown() unwatches it
+        connection_ptr self = shared_from_this();
+        loop_.watch(*socket_, net::io_read, [self](int events) { self->on_io(events); });
+
+        out_.push(local_.encode());
+        if (recv_window_ > default_window)
+            out_.push(encode_window_update(0, static_cast<uint32_t>(recv_window_ - default_window)));
+
+        if (!in_.empty())
+            process();
+        pump();
+    }
+
+    void on_io(int events) {
+        if (events & net::io_write)
+            pump();
+
+        if (!(events & (net::io_read | net::io_error)) || closed_)
+            return;
+
+        char buffer[16384];
+        while (true) {
+            int n = ::recv(*socket_, buffer, sizeof(buffer), 0);
+            if (n > 0) {
+                in_.append(buffer, n);
+                continue;
+            }
+
+            if (n < 0 && WSAGetLastError() == WSAEWOULDBLOCK)
+                break;
+
+            shutdown();
+            return;
+        }
+
+        process();
+        pump();
+    }
+
+    void process() {
+        size_t pos = 0;
+        if (!preface_received_) {
+            size_t n = std::min(in_.size(), client_preface.size());
+            if (in_.compare(0, n, client_preface.data(), n) != 0) {
+                shutdown();
+                return;
+            }
+            if (n < client_preface.size())
+                return;
+
+            preface_received_ = true;
+            pos               = client_preface.size();
+        }
+
+        while (!closing_ && in_.size() - pos >= frame_header_size) {
+            frame_header h = parse_frame_header(in_.data() + pos);
+            if (h.length > local_.max_frame_size) {
+                fail(error_code::frame_size_error);
+                break;
+            }
+
+            if (in_.size() - pos - frame_header_size < h.length)
+                break;
+
+            std::string_view payload(in_.data() + pos + frame_header_size, h.length);
+            pos += frame_header_size + h.length;
+
+            if (!on_frame(h, payload))
+                break;
+        }
+
+        in_.erase(0, pos);
+    }
+
+    bool on_frame(const frame_header& h, std::string_view payload) {
+        if (in_continuation_ && (h.type != frame_type::continuation || h.stream_id != header_stream_))
+            return fail(error_code::protocol_error);
+
+        switch (h.type) {
+        case frame_type::data:
+            return on_data(h, payload);
+        case frame_type::headers:
+            return on_headers(h, payload);
+        case frame_type::continuation:
+            if (!in_continuation_)
+                return fail(error_code::protocol_error);
+            // bound the block so a CONTINUATION flood cannot grow it without limit
+            if (header_block_.size() + payload.size() > 2 * size_t(opts_.max_header_list_size))
+                return fail(error_code::enhance_your_calm);
+            header_block_.append(payload);
+            return !h.has(flags::end_headers) || on_header_block();
+        case frame_type::priority:
+            if (h.stream_id == 0)
+                return fail(error_code::protocol_error);
+            if (payload.size() != 5)
+                reset(h.stream_id, error_code::frame_size_error);
+            return true;
+        case frame_type::rst_stream:
+            if (h.stream_id == 0 || h.stream_id > last_stream_id_)
+                return fail(error_code::protocol_error);
+            if (payload.size() != 4)
+                return fail(error_code::frame_size_error);
+            close_stream(h.stream_id);
+            return true;
+        case frame_type::settings:
+            return on_settings(h, payload);
+        case frame_type::push_promise:
+            return fail(error_code::protocol_error);
+        case frame_type::ping:
+            if (h.stream_id != 0)
+                return fail(error_code::protocol_error);
+            if (payload.size() != 8)
+                return fail(error_code::frame_size_error);
+            if (!h.has(flags::ack))
+                out_.push(encode_frame(frame_type::ping, flags::ack, 0, payload));
+            return true;
+        case frame_type::goaway:
+            if (h.stream_id != 0)
+                return fail(error_code::protocol_error);
+            going_away_ = true;
+            if (streams_.empty())
+                begin_close(error_code::no_error);
+            return true;
+        case frame_type::window_update:
+            return on_window_update(h, payload);
+        default:
+            // unknown frame types are ignored (RFC 7540 section 4.1)
+            return true;
+        }
+    }
+
+    // strips the pad length and padding (and the priority fields of HEADERS)
+    static bool unpad(const frame_header& h, std::string_view payload, size_t skip, std::string_view& out) {
+        size_t pad = 0;
+        if (h.has(flags::padded)) {
+            if (payload.empty())
+                return false;
+            pad = static_cast<uint8_t>(payload[0]);
+            payload.remove_prefix(1);
+        }
+
+        if (payload.size() < skip + pad)
+            return false;
+
+        out = payload.substr(skip, payload.size() - skip - pad);
+        return true;
+    }
+
+    bool on_data(const frame_header& h, std::string_view payload) {
+        if (h.stream_id == 0)
+            return fail(error_code::protocol_error);
+
+        // flow control counts the whole payload, padding included
+        if (static_cast<int64_t>(payload.size()) > recv_window_)
+            return fail(error_code::flow_control_error);
+        recv_window_ -= payload.size();
+        recv_unacked_ += static_cast<uint32_t>(payload.size());
+        if (recv_unacked_ >= opts_.connection_window / 2) {
+            out_.push(encode_window_update(0, recv_unacked_));
+            recv_window_ += recv_unacked_;
+            recv_unacked_ = 0;
+        }
+
+        std::string_view data;
+        if (!unpad(h, payload, 0, data))
+            return fail(error_code::protocol_error);
+
+        auto it = streams_.find(h.stream_id);
+        if (it == streams_.end() || it->second.remote_closed) {
+            if (h.stream_id > last_stream_id_)
+                return fail(error_code::protocol_error);
+            reset(h.stream_id, error_code::stream_closed);
+            return true;
+        }
+
+        stream& s = it->second;
+        if (static_cast<int64_t>(payload.size()) > s.recv_window) {
+            reset(h.stream_id, error_code::flow_control_error);
+            return true;
+        }
+        s.recv_window -= payload.size();
+
+        if (s.req.body.size() + data.size() > opts_.max_body_size) {
+            reset(h.stream_id, error_code::cancel);
+            return true;
+        }
+        s.req.body.append(data);
+
+        if (h.has(flags::end_stream)) {
+            s.remote_closed = true;
+            dispatch(h.stream_id, s);
+            return true;
+        }
+
+        s.recv_unacked += static_cast<uint32_t>(payload.size());
+        if (s.recv_unacked >= opts_.initial_window_size / 2) {
+            out_.push(encode_window_update(h.stream_id, s.recv_unacked));
+            s.recv_window += s.recv_unacked;
+            s.recv_unacked = 0;
+        }
+        return true;
+    }
+
+    bool on_headers(const frame_header& h, std::string_view payload) {
+        if (h.stream_id == 0 || h.stream_id % 2 == 0)
+            return fail(error_code::protocol_error);
+
+        std::string_view block;
+        if (!unpad(h, payload, h.has(flags::priority) ? 5 : 0, block))
+            return fail(error_code::protocol_error);
+
+        auto it = streams_.find(h.stream_id);
+        if (it != streams_.end()) {
+            // trailers: only valid while the request body is open, and they end it
+            if (it->second.remote_closed || !h.has(flags::end_stream))
+                return fail(error_code::protocol_error);
+        } else {
+            if (h.stream_id <= last_stream_id_)
+                return fail(error_code::protocol_error);
+            last_stream_id_ = h.stream_id;
+        }
+
+        header_stream_     = h.stream_id;
+        header_end_stream_ = h.has(flags::end_stream);
+        header_block_.assign(block);
+
+        if (h.has(flags::end_headers))
+            return on_header_block();
+
+        in_continuation_ = true;
+        return true;
+    }
+
+    bool on_header_block() {
+        in_continuation_ = false;
+
+        header_list fields;
+        hpack::decode_status status = decoder_.decode(header_block_, fields);
+        header_block_.clear();
+        if (status == hpack::decode_status::error)
+            return fail(error_code::compression_error);
+
+        uint32_t id = header_stream_;
+        auto it     = streams_.find(id);
+        if (it != streams_.end()) {
+            it->second.remote_closed = true;
+            dispatch(id, it->second);
+            return true;
+        }
+
+        if (going_away_ || streams_.size() >= opts_.max_concurrent_streams) {
+            reset(id, error_code::refused_stream);
+            return true;
+        }
+
+        stream& s = open_stream(id);
+        if (status == hpack::decode_status::too_large) {
+            response res;
+            res.set_status(431, "Request Header Fields Too Large");
+            s.remote_closed = true;
+            on_response(id, res, nullptr);
+            return true;
+        }
+
+        if (!build_request(fields, s.req)) {
+            reset(id, error_code::protocol_error);
+            return true;
+        }
+
+        if (header_end_stream_) {
+            s.remote_closed = true;
+            dispatch(id, s);
+        }
+        return true;
+    }
+
+    bool on_settings(const frame_header& h, std::string_view payload) {
+        if (h.stream_id != 0)
+            return fail(error_code::protocol_error);
+
+        if (h.has(flags::ack))
+            return payload.empty() || fail(error_code::frame_size_error);
+
+        uint32_t old_window = peer_.initial_window_size;
+        error_code err      = error_code::no_error;
+        if (!peer_.apply(payload, err))
+            return fail(err);
+
+        // a new initial window shifts every open stream's window by the difference
+        int64_t delta = int64_t(peer_.initial_window_size) - old_window;
+        for (auto& [id, s] : streams_) {
+            s.send_window += delta;
+            if (s.send_window > max_window)
+                return fail(error_code::flow_control_error);
+        }
+
+        encoder_.set_max_table_size(std::min<uint32_t>(peer_.header_table_size, table_size_));
+        out_.push(encode_frame(frame_type::settings, flags::ack, 0, {}));
+        return true;
+    }
+
+    bool on_window_update(const frame_header& h, std::string_view payload) {
+        if (payload.size() != 4)
+            return fail(error_code::frame_size_error);
+
+        uint32_t increment = read_u32(payload.data()) & 0x7FFFFFFF;
+        if (h.stream_id == 0) {
+            if (increment == 0)
+                return fail(error_code::protocol_error);
+            send_window_ += increment;
+            return send_window_ <= max_window || fail(error_code::flow_control_error);
+        }
+
+        auto it = streams_.find(h.stream_id);
+        if (it == streams_.end())
+            return h.stream_id <= last_stream_id_ || fail(error_code::protocol_error);
+
+        if (increment == 0) {
+            reset(h.stream_id, error_code::protocol_error);
+            return true;
+        }
+
+        it->second.send_window += increment;
+        if (it->second.send_window > max_window)
+            reset(h.stream_id, error_code::flow_control_error);
+        return true;
+    }
+
+    bool build_request(const header_list& fields, request& req) {
+        string m, scheme, path, authority;
+        bool regular = false;
+
+        for (const header_field& f : fields) {
+            if (f.name.empty())
+                return false;
+
+            if (f.name[0] == ':') {
+                // pseudo-headers come first and only the request ones are allowed
+                if (regular)
+                    return false;
+                if (f.name == ":method")
+                    m = f.value;
+                else if (f.name == ":scheme")
+                    scheme = f.value;
+                else if (f.name == ":path")
+                    path = f.value;
+                else if (f.name == ":authority")
+                    authority = f.value;
+                else
+                    return false;
+                continue;
+            }
+
+            regular = true;
+            if (std::any_of(f.name.begin(), f.name.end(), [](char c) { return std::isupper(static_cast<unsigned char>(c)); }))
+                return false;
+            if (f.name == "connection" || f.name == "keep-alive" || f.name == "proxy-connection" ||
+                f.name == "transfer-encoding" || f.name == "upgrade")
+                return false;
+
+            string& slot = req.headers[f.name];
+            if (!slot.empty())
+                slot.append(f.name == "cookie" ? "; " : ", ");
+            slot.append(f.value);
+        }
+
+        if (m.empty() || scheme.empty() || path.empty())
+            return false;
+
+        req.http_method  = m;
+        req.http_version = "HTTP/2.0";
+        req.set_target(path);
+        if (!authority.empty() && !req.headers.count("host"))
+            req.headers["host"] = authority;
+        req.peer = &socket_->endpoint();
+        return true;
+    }
+
+    stream& open_stream(uint32_t id) {
+        stream& s     = streams_[id];
+        s.send_window = peer_.initial_window_size;
+        s.recv_window = local_.initial_window_size;
+        return s;
+    }
+
+    void dispatch(uint32_t id, stream& s) {
+        s.channel   = std::make_shared<body_channel>();
+        auto req    = std::make_shared<request>(std::move(s.req));
+        auto self   = shared_from_this();
+        auto channel = s.channel;
+
+        exec_([self, id, req, channel] { self->handle(id, *req, channel); });
+    }
+
+    // worker thread
+    void handle(uint32_t id, request& req, const std::shared_ptr<body_channel>& channel) {
+        auto res = std::make_shared<response>();
+        try {
+            if (!router_.route_request(req, *res))
+                res->set_status(404, "Not Found");
+        } catch (const std::exception& ex) {
+            *res = response();
+            res->set_status(500, "Internal server error");
+        }
+
+        response::body_stream body = res->get_stream();
+        connection_ptr self        = shared_from_this();
+        loop_.post([self, id, res, channel] { self->on_response(id, *res, channel); });
+        if (!body)
+            return;
+
+        stream_writer writer(self, id, channel);
+        try {
+            if (body(writer) && writer.finish())
+                return;
+        } catch (const std::exception& ex) {
+            std::cerr << "Response stream failed: " << ex.what() << std::endl;
+        }
+
+        if (!channel->is_cancelled())
+            writer.abort();
+    }
+
+    void on_response(uint32_t id, const response& res, const std::shared_ptr<body_channel>& channel) {
+        auto it = streams_.find(id);
+        if (it == streams_.end() || closing_)
+            return;
+
+        stream& s        = it->second;
+        bool streaming   = res.is_streaming();
+        std::string_view body = res.body_view();
+
+        header_list fields;
+        fields.push_back({":status", std::to_string(res.get_status_code())});
+        bool has_length = false;
+        for (const auto& [key, value] : res.get_headers()) {
+            string name = key;
+            std::transform(name.begin(), name.end(), name.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            if (name == "connection" || name == "keep-alive" || name == "transfer-encoding" ||
+                name == "upgrade" || name == "proxy-connection" || name == "content-type")
+                continue;
+            has_length |= name == "content-length";
+            fields.push_back({std::move(name), value});
+        }
+
+        string content_type = res.get_content_type();
+        if (!content_type.empty())
+            fields.push_back({"content-type", content_type});
+        if (!streaming && !has_length)
+            fields.push_back({"content-length", std::to_string(body.size())});
+
+        bool end = !streaming && body.empty();
+        string block;
+        encoder_.encode(fields, block);
+        out_.push(encode_headers(id, block, end, peer_.max_frame_size));
+        s.headers_sent = true;
+
+        if (end) {
+            finish_stream(id);
+        } else if (streaming) {
+            s.streaming = true;
+            s.channel   = channel;
+        } else {
+            s.pending.assign(body.begin(), body.end());
+            s.end_queued = true;
+        }
+
+        pump();
+    }
+
+    void on_body(uint32_t id, string chunk, bool end) {
+        auto it = streams_.find(id);
+        if (it == streams_.end())
+            return;
+
+        stream& s = it->second;
+        s.pending.append(chunk);
+        s.end_queued = end;
+        pump();
+    }
+
+    // Frames pending response bodies, one DATA frame per stream per round so concurrent
+    // responses interleave. Returns whether anything was queued.
+    bool write_data() {
+        bool produced = false;
+        bool progress = true;
+        while (progress && out_.bytes() < high_water_) {
+            progress = false;
+            for (auto it = streams_.begin(); it != streams_.end() && out_.bytes() < high_water_;) {
+                uint32_t id = it->first;
+                stream& s   = it->second;
+                ++it;
+
+                size_t left = s.pending.size() - s.pending_offset;
+                if (!s.headers_sent || (left == 0 && !s.end_queued))
+                    continue;
+
+                int64_t window = std::min(s.send_window, send_window_);
+                size_t n       = std::min<size_t>(left, std::max<int64_t>(window, 0));
+                n              = std::min<size_t>(n, peer_.max_frame_size);
+                bool last      = s.end_queued && n == left;
+                if (n == 0 && !last)
+                    continue;
+
+                out_.push(encode_frame(frame_type::data, last ? flags::end_stream : 0, id,
+                                       std::string_view(s.pending).substr(s.pending_offset, n)));
+                s.pending_offset += n;
+                s.send_window -= n;
+                send_window_ -= n;
+                if (s.streaming && n > 0)
+                    s.channel->sent(n);
+                if (s.pending_offset == s.pending.size()) {
+                    s.pending.clear();
+                    s.pending_offset = 0;
+                }
+
+                produced = progress = true;
+                if (last)
+                    finish_stream(id);
+            }
+        }
+        return produced;
+    }
+
+    void pump() {
+        while (!closed_) {
+            bool produced = !closing_ && write_data();
+            flush();
+            if (!produced || !out_.empty())
+                break;
+        }
+    }
+
+    void flush() {
+        if (closed_)
+            return;
+
+        if (!out_.flush(*socket_)) {
+            shutdown();
+            return;
+        }
+
+        if (closing_ && out_.empty()) {
+            shutdown();
+            return;
+        }
+
+        loop_.update(*socket_, out_.empty() ? net::io_read : net::io_read | net::io_write);
+    }
+
+    void finish_stream(uint32_t id) {
+        streams_.erase(id);
+        if (going_away_ && streams_.empty())
+            begin_close(error_code::no_error);
+    }
+
+    void close_stream(uint32_t id) {
+        auto it = streams_.find(id);
+        if (it == streams_.end())
+            return;
+
+        if (it->second.channel)
+            it->second.channel->cancel();
+        streams_.erase(it);
+    }
+
+    void reset(uint32_t id, error_code code) {
+        if (closed_)
+            return;
+        out_.push(encode_rst_stream(id, code));
+        close_stream(id);
+    }
+
+    // connection error: GOAWAY, then close once it is written
+    bool fail(error_code code) {
+        begin_close(code);
+        return false;
+    }
+
+    void begin_close(error_code code) {
+        if (closing_ || closed_)
+            return;
+
+        closing_ = true;
+        out_.push(encode_goaway(last_stream_id_, code));
+        flush();
+    }
+
+    void shutdown() {
+        if (closed_)
+            return;
+
+        closed_ = true;
+        for (auto& [id, s] : streams_)
+            if (s.channel)
+                s.channel->cancel();
+        streams_.clear();
+
+        loop_.unwatch(*socket_);
+        socket_->close();
+        out_.clear();
+
+        if (on_shutdown_)
+            std::exchange(on_shutdown_, nullptr)();
+    }
+};
+
+} // namespace net::http::http2
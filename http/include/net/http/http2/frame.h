@@ -0,0 +1,246 @@
+#pragma once
+// std
+#include <cstdint>
+#include <string_view>
+
+// lib
+#include <types.h>
+
+namespace net::http::http2 {
+
+inline constexpr std::string_view client_preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+inline constexpr size_t frame_header_size     = 9;
+inline constexpr uint32_t default_window      = 65535;
+inline constexpr uint32_t max_window          = 0x7FFFFFFF;
+inline constexpr uint32_t min_frame_size      = 16384;
+inline constexpr uint32_t largest_frame_size  = 0xFFFFFF;
+
+enum class frame_type : uint8_t {
+    data          = 0x0,
+    headers       = 0x1,
+    priority      = 0x2,
+    rst_stream    = 0x3,
+    settings      = 0x4,
+    push_promise  = 0x5,
+    ping          = 0x6,
+    goaway        = 0x7,
+    window_update = 0x8,
+    continuation  = 0x9
+};
+
+namespace flags {
+inline constexpr uint8_t end_stream  = 0x1;
+inline constexpr uint8_t ack         = 0x1;
+inline constexpr uint8_t end_headers = 0x4;
+inline constexpr uint8_t padded      = 0x8;
+inline constexpr uint8_t priority    = 0x20;
+} // namespace flags
+
+enum class error_code : uint32_t {
+    no_error            = 0x0,
+    protocol_error      = 0x1,
+    internal_error      = 0x2,
+    flow_control_error  = 0x3,
+    settings_timeout    = 0x4,
+    stream_closed       = 0x5,
+    frame_size_error    = 0x6,
+    refused_stream      = 0x7,
+    cancel              = 0x8,
+    compression_error   = 0x9,
+    connect_error       = 0xA,
+    enhance_your_calm   = 0xB,
+    inadequate_security = 0xC,
+    http_1_1_required   = 0xD
+};
+
+enum class settings_id : uint16_t {
+    header_table_size      = 0x1,
+    enable_push            = 0x2,
+    max_concurrent_streams = 0x3,
+    initial_window_size    = 0x4,
+    max_frame_size         = 0x5,
+    max_header_list_size   = 0x6
+};
+
+struct frame_header {
+    uint32_t length;
+    frame_type type;
+    uint8_t flags;
+    uint32_t stream_id;
+
+    bool has(uint8_t flag) const { return (flags & flag) != 0; }
+};
+
+inline uint32_t read_u32(const char* p) {
+    const uint8_t* b = reinterpret_cast<const uint8_t*>(p);
+    return (uint32_t(b[0]) << 24) | (uint32_t(b[1]) << 16) | (uint32_t(b[2]) << 8) | b[3];
+}
+
+inline void write_u32(string& out, uint32_t v) {
+    out.push_back(static_cast<char>(v >> 24));
+    out.push_back(static_cast<char>(v >> 16));
+    out.push_back(static_cast<char>(v >> 8));
+    out.push_back(static_cast<char>(v));
+}
+
+inline frame_header parse_frame_header(const char* p) {
+    const uint8_t* b = reinterpret_cast<const uint8_t*>(p);
+    frame_header h;
+    h.length    = (uint32_t(b[0]) << 16) | (uint32_t(b[1]) << 8) | b[2];
+    h.type      = static_cast<frame_type>(b[3]);
+    h.flags     = b[4];
+    h.stream_id = read_u32(p + 5) & 0x7FFFFFFF;
+    return h;
+}
+
+inline void write_frame_header(string& out, uint32_t length, frame_type type, uint8_t flags,
+                               uint32_t stream_id) {
+    out.push_back(static_cast<char>(length >> 16));
+    out.push_back(static_cast<char>(length >> 8));
+    out.push_back(static_cast<char>(length));
+    out.push_back(static_cast<char>(type));
+    out.push_back(static_cast<char>(flags));
+    write_u32(out, stream_id & 0x7FFFFFFF);
+}
+
+inline string encode_frame(frame_type type, uint8_t flags, uint32_t stream_id, std::string_view payload) {
+    string out;
+    out.reserve(frame_header_size + payload.size());
+    write_frame_header(out, static_cast<uint32_t>(payload.size()), type, flags, stream_id);
+    out.append(payload);
+    return out;
+}
+
+inline string encode_window_update(uint32_t stream_id, uint32_t increment) {
+    string out;
+    write_frame_header(out, 4, frame_type::window_update, 0, stream_id);
+    write_u32(out, increment & 0x7FFFFFFF);
+    return out;
+}
+
+inline string encode_rst_stream(uint32_t stream_id, error_code code) {
+    string out;
+    write_frame_header(out, 4, frame_type::rst_stream, 0, stream_id);
+    write_u32(out, static_cast<uint32_t>(code));
+    return out;
+}
+
+inline string encode_goaway(uint32_t last_stream_id, error_code code) {
+    string out;
+    write_frame_header(out, 8, frame_type::goaway, 0, 0);
+    write_u32(out, last_stream_id & 0x7FFFFFFF);
+    write_u32(out, static_cast<uint32_t>(code));
+    return out;
+}
+
+// Header block split into HEADERS + CONTINUATION frames of at most `max_size` bytes each.
+inline string encode_headers(uint32_t stream_id, std::string_view block, bool end_stream, size_t max_size) {
+    string out;
+    out.reserve(block.size() + frame_header_size * (1 + block.size() / max_size));
+
+    frame_type type = frame_type::headers;
+    do {
+        size_t n      = block.size() < max_size ? block.size() : max_size;
+        bool last     = n == block.size();
+        uint8_t flags = (last ? flags::end_headers : 0);
+        if (type == frame_type::headers && end_stream)
+            flags |= flags::end_stream;
+
+        write_frame_header(out, static_cast<uint32_t>(n), type, flags, stream_id);
+        out.append(block.substr(0, n));
+        block.remove_prefix(n);
+        type = frame_type::continuation;
+    } while (!block.empty());
+
+    return out;
+}
+
+struct settings {
+    uint32_t header_table_size      = 4096;
+    uint32_t enable_push            = 1;
+    uint32_t max_concurrent_streams = 0xFFFFFFFF;
+    uint32_t initial_window_size    = default_window;
+    uint32_t max_frame_size         = min_frame_size;
+    uint32_t max_header_list_size   = 0xFFFFFFFF;
+
+    // validates and applies one parameter; unknown identifiers are ignored
+    bool apply(uint16_t id, uint32_t value, error_code& err) {
+        switch (static_cast<settings_id>(id)) {
+        case settings_id::header_table_size:
+            header_table_size = value;
+            return true;
+        case settings_id::enable_push:
+            if (value > 1)
+                break;
+            enable_push = value;
+            return true;
+        case settings_id::max_concurrent_streams:
+            max_concurrent_streams = value;
+            return true;
+        case settings_id::initial_window_size:
+            if (value > max_window) {
+                err = error_code::flow_control_error;
+                return false;
+            }
+            initial_window_size = value;
+            return true;
+        case settings_id::max_frame_size:
+            if (value < min_frame_size || value > largest_frame_size)
+                break;
+            max_frame_size = value;
+            return true;
+        case settings_id::max_header_list_size:
+            max_header_list_size = value;
+            return true;
+        default:
+            return true;
+        }
+
+        err = error_code::protocol_error;
+        return false;
+    }
+
+    // a SETTINGS payload, parsed without applying it to anything but this struct
+    bool apply(std::string_view payload, error_code& err) {
+        if (payload.size() % 6 != 0) {
+            err = error_code::frame_size_error;
+            return false;
+        }
+
+        for (size_t i = 0; i < payload.size(); i += 6) {
+            uint16_t id = static_cast<uint16_t>((uint8_t(payload[i]) << 8) | uint8_t(payload[i + 1]));
+            if (!apply(id, read_u32(payload.data() + i + 2), err))
+                return false;
+        }
+        return true;
+    }
+
+    // SETTINGS frame announcing every value that differs from the protocol defaults
+    string encode() const {
+        static const settings defaults;
+        string payload;
+        auto put = [&payload](settings_id id, uint32_t value) {
+            payload.push_back(static_cast<char>(static_cast<uint16_t>(id) >> 8));
+            payload.push_back(static_cast<char>(id));
+            write_u32(payload, value);
+        };
+
+        if (header_table_size != defaults.header_table_size)
+            put(settings_id::header_table_size, header_table_size);
+        if (enable_push != defaults.enable_push)
+            put(settings_id::enable_push, enable_push);
+        if (max_concurrent_streams != defaults.max_concurrent_streams)
+            put(settings_id::max_concurrent_streams, max_concurrent_streams);
+        if (initial_window_size != defaults.initial_window_size)
+            put(settings_id::initial_window_size, initial_window_size);
+        if (max_frame_size != defaults.max_frame_size)
+            put(settings_id::max_frame_size, max_frame_size);
+        if (max_header_list_size != defaults.max_header_list_size)
+            put(settings_id::max_header_list_size, max_header_list_size);
+
+        return encode_frame(frame_type::settings, 0, 0, payload);
+    }
+};
+
+} // namespace net::http::http2
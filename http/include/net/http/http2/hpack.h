@@ -0,0 +1,393 @@
+#pragma once
+// std
+#include <cstdint>
+#include <deque>
+#include <string_view>
+#include <unordered_map>
+
+// lib
+#include <types.h>
+#include "huffman.h"
+
+namespace net::http::http2 {
+
+struct header_field {
+    string name;
+    string value;
+};
+
+using header_list = list<header_field>;
+
+namespace hpack {
+
+struct static_entry {
+    const char* name;
+    const char* value;
+};
+
+// RFC 7541 appendix A; index 1 is the first entry
+inline constexpr static_entry static_table[] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+
+inline constexpr size_t static_size = sizeof(static_table) / sizeof(static_table[0]);
+
+// size of an entry as accounted against the table limit (RFC 7541 section 4.1)
+inline size_t entry_size(const header_field& f) { return f.name.size() + f.value.size() + 32; }
+
+class dynamic_table {
+  public:
+    explicit dynamic_table(size_t max_size = 4096) : max_size_(max_size) {}
+
+    size_t size() const { return size_; }
+    size_t max_size() const { return max_size_; }
+    size_t count() const { return entries_.size(); }
+
+    // 0 is the newest entry
+    const header_field& at(size_t i) const { return entries_[i]; }
+
+    void add(header_field f) {
+        size_t n = entry_size(f);
+        evict(n > max_size_ ? max_size_ : max_size_ - n);
+
+        // an entry larger than the whole table empties it and is not stored
+        if (n > max_size_)
+            return;
+
+        size_ += n;
+        entries_.push_front(std::move(f));
+    }
+
+    void resize(size_t max_size) {
+        max_size_ = max_size;
+        evict(max_size_);
+    }
+
+  private:
+    std::deque<header_field> entries_;
+    size_t size_ = 0;
+    size_t max_size_;
+
+    void evict(size_t limit) {
+        while (size_ > limit && !entries_.empty()) {
+            size_ -= entry_size(entries_.back());
+            entries_.pop_back();
+        }
+    }
+};
+
+inline void encode_integer(string& out, uint64_t value, int prefix_bits, uint8_t first_byte) {
+    uint64_t max_prefix = (1u << prefix_bits) - 1;
+    if (value < max_prefix) {
+        out.push_back(static_cast<char>(first_byte | value));
+        return;
+    }
+
+    out.push_back(static_cast<char>(first_byte | max_prefix));
+    value -= max_prefix;
+    while (value >= 128) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+inline bool decode_integer(std::string_view in, size_t& pos, int prefix_bits, uint64_t& value) {
+    if (pos >= in.size())
+        return false;
+
+    uint64_t max_prefix = (1u << prefix_bits) - 1;
+    value               = static_cast<uint8_t>(in[pos++]) & max_prefix;
+    if (value < max_prefix)
+        return true;
+
+    for (int shift = 0; pos < in.size(); shift += 7) {
+        if (shift > 28)
+            return false; // nothing in HTTP/2 needs more than 32 bits
+        uint8_t b = static_cast<uint8_t>(in[pos++]);
+        value += static_cast<uint64_t>(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+inline void encode_string(string& out, std::string_view s) {
+    size_t huffman_length = huffman::encoded_length(s);
+    if (huffman_length < s.size()) {
+        encode_integer(out, huffman_length, 7, 0x80);
+        huffman::encode(s, out);
+    } else {
+        encode_integer(out, s.size(), 7, 0x00);
+        out.append(s);
+    }
+}
+
+inline bool decode_string(std::string_view in, size_t& pos, string& out) {
+    if (pos >= in.size())
+        return false;
+
+    bool huffman_coded = static_cast<uint8_t>(in[pos]) & 0x80;
+    uint64_t length;
+    if (!decode_integer(in, pos, 7, length) || length > in.size() - pos)
+        return false;
+
+    std::string_view raw = in.substr(pos, static_cast<size_t>(length));
+    pos += static_cast<size_t>(length);
+
+    out.clear();
+    if (!huffman_coded) {
+        out.assign(raw);
+        return true;
+    }
+    return huffman::decode(raw, out);
+}
+
+enum class decode_status { ok, error, too_large };
+
+class decoder {
+  public:
+    // `max_table_size` is what we advertise in SETTINGS_HEADER_TABLE_SIZE
+    decoder(size_t max_table_size = 4096, size_t max_list_size = 64 * 1024)
+        : table_(max_table_size), max_table_size_(max_table_size), max_list_size_(max_list_size) {}
+
+    // Decodes one complete header block. A block over the list size limit is still decoded to
+    // the end so the dynamic table stays in sync with the peer's encoder.
+    decode_status decode(std::string_view block, header_list& out) {
+        out.clear();
+        size_t pos        = 0;
+        size_t list_size  = 0;
+        bool fields_begun = false;
+
+        while (pos < block.size()) {
+            uint8_t b = static_cast<uint8_t>(block[pos]);
+            header_field field;
+
+            if (b & 0x80) {
+                uint64_t index;
+                if (!decode_integer(block, pos, 7, index) || !lookup(index, field))
+                    return decode_status::error;
+            } else if ((b & 0xE0) == 0x20) {
+                // table size updates are only allowed at the start of a block
+                uint64_t size;
+                if (fields_begun || !decode_integer(block, pos, 5, size) || size > max_table_size_)
+                    return decode_status::error;
+                table_.resize(static_cast<size_t>(size));
+                continue;
+            } else {
+                bool indexing  = (b & 0xC0) == 0x40;
+                int prefix     = indexing ? 6 : 4;
+                uint64_t index;
+                if (!decode_integer(block, pos, prefix, index))
+                    return decode_status::error;
+
+                if (index == 0) {
+                    if (!decode_string(block, pos, field.name))
+                        return decode_status::error;
+                } else {
+                    header_field named;
+                    if (!lookup(index, named))
+                        return decode_status::error;
+                    field.name = std::move(named.name);
+                }
+
+                if (!decode_string(block, pos, field.value))
+                    return decode_status::error;
+
+                if (indexing)
+                    table_.add(field);
+            }
+
+            fields_begun = true;
+            list_size += entry_size(field);
+            if (list_size <= max_list_size_)
+                out.push_back(std::move(field));
+        }
+
+        return list_size <= max_list_size_ ? decode_status::ok : decode_status::too_large;
+    }
+
+  private:
+    dynamic_table table_;
+    size_t max_table_size_;
+    size_t max_list_size_;
+
+    bool lookup(uint64_t index, header_field& out) const {
+        if (index == 0)
+            return false;
+
+        if (index <= static_size) {
+            out.name  = static_table[index - 1].name;
+            out.value = static_table[index - 1].value;
+            return true;
+        }
+
+        index -= static_size + 1;
+        if (index >= table_.count())
+            return false;
+
+        out = table_.at(static_cast<size_t>(index));
+        return true;
+    }
+};
+
+class encoder {
+  public:
+    explicit encoder(size_t max_table_size = 4096) : table_(max_table_size) {}
+
+    // the peer's SETTINGS_HEADER_TABLE_SIZE; signalled at the start of the next block
+    void set_max_table_size(size_t size) {
+        if (size == table_.max_size())
+            return;
+        table_.resize(size);
+        pending_size_update_ = true;
+    }
+
+    // names must already be lowercase
+    void encode(const header_list& fields, string& out) {
+        if (pending_size_update_) {
+            encode_integer(out, table_.max_size(), 5, 0x20);
+            pending_size_update_ = false;
+        }
+
+        for (const header_field& f : fields)
+            encode(f, out);
+    }
+
+  private:
+    dynamic_table table_;
+    bool pending_size_update_ = false;
+
+    void encode(const header_field& f, string& out) {
+        size_t name_index = 0;
+        if (size_t full = find(f, name_index)) {
+            encode_integer(out, full, 7, 0x80);
+            return;
+        }
+
+        // secrets are never indexed, not even by intermediaries re-encoding the block
+        if (sensitive(f.name)) {
+            encode_literal(out, f, name_index, 4, 0x10);
+        } else if (volatile_value(f.name) || entry_size(f) > table_.max_size() / 2) {
+            encode_literal(out, f, name_index, 4, 0x00);
+        } else {
+            encode_literal(out, f, name_index, 6, 0x40);
+            table_.add(f);
+        }
+    }
+
+    static void encode_literal(string& out, const header_field& f, size_t name_index, int prefix,
+                               uint8_t first_byte) {
+        encode_integer(out, name_index, prefix, first_byte);
+        if (name_index == 0)
+            encode_string(out, f.name);
+        encode_string(out, f.value);
+    }
+
+    // returns the index of an exact match, and sets `name_index` to a name-only match
+    size_t find(const header_field& f, size_t& name_index) const {
+        static const auto lookup = [] {
+            std::unordered_map<string, size_t> m;
+            for (size_t i = static_size; i > 0; --i) {
+                const static_entry& e = static_table[i - 1];
+                m[string(e.name)]     = i;
+                if (*e.value)
+                    m[string(e.name) + '\0' + e.value] = i;
+            }
+            return m;
+        }();
+
+        auto exact = lookup.find(f.name + '\0' + f.value);
+        if (exact != lookup.end())
+            return exact->second;
+
+        auto named = lookup.find(f.name);
+        if (named != lookup.end())
+            name_index = named->second;
+
+        for (size_t i = 0; i < table_.count(); ++i) {
+            const header_field& e = table_.at(i);
+            if (e.name != f.name)
+                continue;
+            if (e.value == f.value)
+                return static_size + 1 + i;
+            if (name_index == 0)
+                name_index = static_size + 1 + i;
+        }
+        return 0;
+    }
+
+    static bool sensitive(const string& name) {
+        return name == "authorization" || name == "cookie" || name == "set-cookie" ||
+               name == "proxy-authorization";
+    }
+
+    // values that rarely repeat would only push useful entries out of the table
+    static bool volatile_value(const string& name) {
+        return name == "content-length" || name == "date" || name == "etag" ||
+               name == "last-modified" || name == "expires" || name == "age" || name == ":path";
+    }
+};
+
+} // namespace hpack
+} // namespace net::http::http2
@@ -0,0 +1,147 @@
+#pragma once
+// std
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace net::http::http2::huffman {
+
+// Code lengths of the HPACK Huffman code (RFC 7541 appendix B), symbols 0-255 and EOS. The code
+// is canonical, so the codes themselves follow from the lengths.
+inline constexpr uint8_t code_lengths[257] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 30, 28,
+    28, 28, 28, 28, 28, 28, 28, 28, 6,  10, 10, 12, 13, 6,  8,  11, 10, 10, 8,  11, 8,  6,  6,  6,
+    5,  5,  5,  6,  6,  6,  6,  6,  6,  6,  7,  8,  15, 6,  12, 10, 13, 6,  7,  7,  7,  7,  7,  7,
+    7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  8,  7,  8,  13, 19, 13, 14, 6,
+    15, 5,  6,  5,  6,  5,  6,  6,  6,  5,  7,  7,  6,  6,  6,  5,  6,  7,  6,  5,  5,  6,  7,  7,
+    7,  7,  7,  15, 11, 14, 13, 28, 20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24, 22, 21, 20, 22, 22, 23, 23, 21,
+    23, 22, 22, 24, 21, 22, 23, 23, 21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25, 19, 21, 26, 27, 27, 26, 27, 24,
+    21, 21, 26, 26, 28, 27, 27, 27, 20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26, 30};
+
+inline constexpr int eos        = 256;
+inline constexpr int max_length = 30;
+
+struct table {
+    uint32_t codes[257]{};
+    // symbols ordered by (length, symbol); canonical codes of one length are consecutive
+    uint16_t sorted[257]{};
+    uint32_t first_code[max_length + 1]{};
+    uint16_t first_index[max_length + 1]{};
+    uint16_t count[max_length + 1]{};
+    // codes of up to 8 bits, indexed by the next 8 input bits; length 0 means "longer code"
+    uint16_t fast_symbol[256]{};
+    uint8_t fast_length[256]{};
+
+    constexpr table() {
+        for (int s = 0; s < 257; ++s)
+            ++count[code_lengths[s]];
+
+        uint16_t index = 0;
+        for (int len = 1; len <= max_length; ++len) {
+            first_index[len] = index;
+            for (int s = 0; s < 257; ++s)
+                if (code_lengths[s] == len)
+                    sorted[index++] = static_cast<uint16_t>(s);
+        }
+
+        uint32_t code = 0;
+        for (int len = 1; len <= max_length; ++len) {
+            first_code[len] = code;
+            for (int i = 0; i < count[len]; ++i)
+                codes[sorted[first_index[len] + i]] = code++;
+            code <<= 1;
+        }
+
+        for (int s = 0; s < 256; ++s) {
+            int len = code_lengths[s];
+            if (len > 8)
+                continue;
+            uint32_t base = codes[s] << (8 - len);
+            for (uint32_t fill = 0; fill < (1u << (8 - len)); ++fill) {
+                fast_symbol[base | fill] = static_cast<uint16_t>(s);
+                fast_length[base | fill] = static_cast<uint8_t>(len);
+            }
+        }
+    }
+};
+
+inline constexpr table code_table{};
+
+inline size_t encoded_length(std::string_view in) {
+    size_t bits = 0;
+    for (unsigned char c : in)
+        bits += code_lengths[c];
+    return (bits + 7) / 8;
+}
+
+inline void encode(std::string_view in, std::string& out) {
+    uint64_t acc = 0;
+    int bits     = 0;
+    for (unsigned char c : in) {
+        acc = (acc << code_lengths[c]) | code_table.codes[c];
+        bits += code_lengths[c];
+        while (bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<char>(acc >> bits));
+        }
+    }
+
+    // pad with the most significant bits of EOS (all ones)
+    if (bits > 0)
+        out.push_back(static_cast<char>((acc << (8 - bits)) | (0xFF >> bits)));
+}
+
+// Returns false on a malformed string: EOS in the data, or padding that is longer than 7 bits
+// or not all ones (RFC 7541 section 5.2).
+inline bool decode(std::string_view in, std::string& out) {
+    uint64_t acc = 0;
+    int bits     = 0;
+    size_t pos   = 0;
+
+    while (true) {
+        while (bits <= 56 - 8 && pos < in.size()) {
+            acc = (acc << 8) | static_cast<unsigned char>(in[pos++]);
+            bits += 8;
+        }
+
+        if (bits >= 8) {
+            uint32_t peek = static_cast<uint32_t>(acc >> (bits - 8)) & 0xFF;
+            if (int len = code_table.fast_length[peek]) {
+                out.push_back(static_cast<char>(code_table.fast_symbol[peek]));
+                bits -= len;
+                continue;
+            }
+        }
+
+        // canonical decode of a longer code (or a short one in the last few bits)
+        int symbol = -1;
+        int len    = 5;
+        for (; len <= max_length && len <= bits; ++len) {
+            uint32_t code = static_cast<uint32_t>(acc >> (bits - len)) & ((1u << len) - 1);
+            if (code - code_table.first_code[len] < code_table.count[len]) {
+                symbol = code_table.sorted[code_table.first_index[len] + (code - code_table.first_code[len])];
+                break;
+            }
+        }
+
+        if (symbol < 0)
+            break;
+        if (symbol == eos)
+            return false;
+
+        out.push_back(static_cast<char>(symbol));
+        bits -= len;
+    }
+
+    if (pos < in.size() || bits > 7)
+        return false;
+
+    uint32_t mask = (1u << bits) - 1;
+    return (static_cast<uint32_t>(acc) & mask) == mask;
+}
+
+} // namespace net::http::http2::huffman
@@ -1,4 +1,5 @@
 #pragma once
+#include <functional>
 #include <string>
 #include <types.h>
 #define PTR_STYLE
@@ -9,7 +10,8 @@ struct request;
 class response;
 
 #ifdef PTR_STYLE
-using route_handler = response (*)(const request&);
+// plain functions still convert; stateful handlers (proxy, caches) bind their state
+using route_handler = std::function<response(const request&)>;
 #else
 using route_handler = std::function<void(const req&, res&)>;
 #endif
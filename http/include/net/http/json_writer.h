@@ -0,0 +1,267 @@
+#pragma once
+// std
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+// lib
+#include <types.h>
+#include "body_writer.h"
+
+using json = nlohmann::json;
+
+namespace net::http {
+
+// Appends to an in-memory body; lets the same serializer fill a buffered response.
+class buffer_body_writer : public body_writer {
+  public:
+    explicit buffer_body_writer(list<char>& out) : out_(out) {}
+
+    bool write(const char* data, size_t len) override {
+        out_.insert(out_.end(), data, data + len);
+        return true;
+    }
+
+    bool flush() override { return true; }
+    bool finish() override { return true; }
+
+    using body_writer::write;
+
+  private:
+    list<char>& out_;
+};
+
+// Serializes JSON token by token into a body_writer, without building the document as a
+// string first. Output is staged in a fixed buffer, so memory stays bounded by `capacity`
+// plus whatever the writer underneath buffers. Commas and colons are inserted automatically:
+//
+//     w.begin_object().key("id").value(42).key("tags").begin_array().value("a").end_array().end_object();
+class json_writer {
+  public:
+    explicit json_writer(body_writer& out, size_t capacity = 8 * 1024) : out_(out), capacity_(capacity) {
+        buffer_.reserve(capacity_);
+    }
+
+    json_writer(const json_writer&)            = delete;
+    json_writer& operator=(const json_writer&) = delete;
+
+    ~json_writer() { flush(); }
+
+    json_writer& begin_object() { return open('{'); }
+    json_writer& end_object() { return close('}'); }
+    json_writer& begin_array() { return open('['); }
+    json_writer& end_array() { return close(']'); }
+
+    json_writer& key(std::string_view name) {
+        separate();
+        put_string(name);
+        put(':');
+        after_key_ = true;
+        return *this;
+    }
+
+    json_writer& value(std::string_view s) {
+        separate();
+        put_string(s);
+        return *this;
+    }
+
+    json_writer& value(const char* s) { return value(std::string_view(s)); }
+    json_writer& value(const string& s) { return value(std::string_view(s)); }
+
+    json_writer& value(bool b) {
+        separate();
+        append(b ? std::string_view("true") : std::string_view("false"));
+        return *this;
+    }
+
+    json_writer& value(std::nullptr_t) {
+        separate();
+        append("null");
+        return *this;
+    }
+
+    template <typename T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, int> = 0>
+    json_writer& value(T n) {
+        separate();
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), n);
+        append(std::string_view(digits, result.ptr - digits));
+        return *this;
+    }
+
+    // shortest representation that reads back to the same double; NaN and infinity become null
+    json_writer& value(double d) {
+        separate();
+        if (!std::isfinite(d)) {
+            append("null");
+            return *this;
+        }
+
+        char digits[32];
+        auto result = std::to_chars(digits, digits + sizeof(digits), d);
+        std::string_view text(digits, result.ptr - digits);
+        append(text);
+        // keep the value a float when read back, like json::dump does
+        if (text.find_first_of(".e") == std::string_view::npos)
+            append(".0");
+        return *this;
+    }
+
+    json_writer& value(float f) { return value(static_cast<double>(f)); }
+
+    json_writer& value(const json& j) {
+        using type = json::value_t;
+        switch (j.type()) {
+        case type::null:
+            return value(nullptr);
+        case type::boolean:
+            return value(j.get<bool>());
+        case type::number_integer:
+            return value(j.get<int64_t>());
+        case type::number_unsigned:
+            return value(j.get<uint64_t>());
+        case type::number_float:
+            return value(j.get<double>());
+        case type::string:
+            return value(std::string_view(j.get_ref<const json::string_t&>()));
+        case type::array:
+            begin_array();
+            for (const json& element : j)
+                value(element);
+            return end_array();
+        case type::object:
+            begin_object();
+            for (auto it = j.begin(); it != j.end(); ++it) {
+                key(it.key());
+                value(it.value());
+            }
+            return end_object();
+        default:
+            return raw(j.dump());
+        }
+    }
+
+    // an already serialized JSON value, written as is
+    json_writer& raw(std::string_view text) {
+        separate();
+        append(text);
+        return *this;
+    }
+
+    // hands the staged bytes to the underlying writer; false once the writer has failed
+    bool flush() {
+        if (!buffer_.empty()) {
+            ok_ = ok_ && out_.write(buffer_.data(), buffer_.size());
+            buffer_.clear();
+        }
+        return ok_;
+    }
+
+    bool ok() const { return ok_; }
+
+  private:
+    body_writer& out_;
+    size_t capacity_;
+    string buffer_;
+    // one entry per open container: true until its first element is written
+    list<bool> first_;
+    bool after_key_ = false;
+    bool ok_        = true;
+
+    json_writer& open(char c) {
+        separate();
+        put(c);
+        first_.push_back(true);
+        return *this;
+    }
+
+    json_writer& close(char c) {
+        first_.pop_back();
+        put(c);
+        return *this;
+    }
+
+    void separate() {
+        if (after_key_) {
+            after_key_ = false;
+            return;
+        }
+
+        if (first_.empty())
+            return;
+
+        if (!first_.back())
+            put(',');
+        first_.back() = false;
+    }
+
+    void put(char c) {
+        if (buffer_.size() == capacity_)
+            flush();
+        buffer_.push_back(c);
+    }
+
+    void append(std::string_view s) {
+        if (buffer_.size() + s.size() > capacity_)
+            flush();
+
+        if (s.size() >= capacity_) {
+            ok_ = ok_ && out_.write(s.data(), s.size());
+            return;
+        }
+
+        buffer_.append(s.data(), s.size());
+    }
+
+    // Runs of characters that need no escaping are copied in one piece.
+    void put_string(std::string_view s) {
+        static constexpr char hex[] = "0123456789abcdef";
+
+        put('"');
+        size_t run = 0;
+        for (size_t i = 0; i < s.size(); ++i) {
+            unsigned char c = static_cast<unsigned char>(s[i]);
+            if (c >= 0x20 && c != '"' && c != '\\')
+                continue;
+
+            append(s.substr(run, i - run));
+            run = i + 1;
+
+            switch (c) {
+            case '"':
+                append("\\\"");
+                break;
+            case '\\':
+                append("\\\\");
+                break;
+            case '\n':
+                append("\\n");
+                break;
+            case '\r':
+                append("\\r");
+                break;
+            case '\t':
+                append("\\t");
+                break;
+            case '\b':
+                append("\\b");
+                break;
+            case '\f':
+                append("\\f");
+                break;
+            default: {
+                char escape[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+                append(std::string_view(escape, sizeof(escape)));
+            }
+            }
+        }
+
+        append(s.substr(run));
+        put('"');
+    }
+};
+
+} // namespace net::http
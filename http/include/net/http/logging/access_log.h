@@ -0,0 +1,391 @@
+#pragma once
+// std
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+
+// lib
+#include <types.h>
+#include "../json_writer.h"
+#include "../request.h"
+
+namespace net::http {
+
+enum class log_format { common, combined, json };
+
+struct access_log_options {
+    // file to append to; "-" writes to stdout and never rotates
+    string path = "access.log";
+    log_format format = log_format::combined;
+    // records each request thread can have waiting; more are dropped, not waited for
+    size_t ring_capacity = 4096;
+    // the file is rotated to path.1 ... path.<max_files> once it would grow past this
+    size_t max_file_bytes = 64 * 1024 * 1024;
+    int max_files         = 5;
+    std::chrono::milliseconds flush_interval{100};
+};
+
+// One request as the writer thread sees it. Fixed size so the rings never allocate; longer
+// strings are cut off.
+struct access_record {
+    int64_t time_ns;
+    uint64_t duration_ns;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    int status;
+    char method[8];
+    char protocol[12];
+    char remote[48];
+    // with the query string
+    char path[256];
+    char referer[128];
+    char user_agent[128];
+};
+
+// Asynchronous access log. Request threads copy a record into a ring of their own (single
+// producer, single consumer) and return; a background thread formats the rings' contents
+// and appends them to the file in one write per batch. A full ring drops the record and
+// counts it in dropped() instead of blocking the request.
+class access_log {
+  public:
+    explicit access_log(access_log_options opts = {}) : opts_(std::move(opts)), id_(next_id()) {
+        capacity_ = 1;
+        while (capacity_ < opts_.ring_capacity)
+            capacity_ <<= 1;
+
+        open();
+        writer_ = std::thread([this] { run(); });
+    }
+
+    ~access_log() {
+        {
+            std::lock_guard lock(wake_mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_one();
+        writer_.join();
+        close();
+    }
+
+    access_log(const access_log&)            = delete;
+    access_log& operator=(const access_log&) = delete;
+
+    // `req` is null when the request could not be parsed
+    void log(const request* req, const string& remote, int status, size_t bytes_in, size_t bytes_out,
+             std::chrono::nanoseconds duration) {
+        ring& r     = local();
+        size_t head = r.head.load(std::memory_order_relaxed);
+        if (head - r.tail.load(std::memory_order_acquire) >= capacity_) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        access_record& rec = r.records[head & (capacity_ - 1)];
+        rec.time_ns        = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::system_clock::now().time_since_epoch())
+                          .count();
+        rec.duration_ns = duration.count() > 0 ? static_cast<uint64_t>(duration.count()) : 0;
+        rec.bytes_in    = bytes_in;
+        rec.bytes_out   = bytes_out;
+        rec.status      = status;
+        copy(rec.remote, {remote});
+        if (!req) {
+            copy(rec.method, {"-"});
+            copy(rec.protocol, {"-"});
+            copy(rec.path, {"-"});
+            copy(rec.referer, {});
+            copy(rec.user_agent, {});
+        } else {
+            static const string referer = "Referer", user_agent = "User-Agent";
+            const string* ref   = req->find_header(referer);
+            const string* agent = req->find_header(user_agent);
+            copy(rec.method, {req->http_method.view()});
+            copy(rec.protocol, {req->http_version});
+            if (req->query_string.empty())
+                copy(rec.path, {req->path});
+            else
+                copy(rec.path, {req->path, "?", req->query_string});
+            copy(rec.referer, {ref ? std::string_view(*ref) : std::string_view()});
+            copy(rec.user_agent, {agent ? std::string_view(*agent) : std::string_view()});
+        }
+
+        r.head.store(head + 1, std::memory_order_release);
+    }
+
+    // records discarded because a ring was full
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+    uint64_t written() const { return written_.load(std::memory_order_relaxed); }
+
+    // formats and writes everything queued so far; the writer thread does this on its own
+    void flush() {
+        std::lock_guard lock(write_mutex_);
+        drain();
+    }
+
+  private:
+    struct ring {
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+        std::unique_ptr<access_record[]> records;
+    };
+
+    access_log_options opts_;
+    uint64_t id_;
+    size_t capacity_;
+
+    std::mutex rings_mutex_;
+    list<std::unique_ptr<ring>> rings_;
+
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> written_{0};
+
+    std::mutex write_mutex_;
+    std::FILE* file_  = nullptr;
+    size_t file_size_ = 0;
+    list<char> batch_;
+
+    std::thread writer_;
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+
+    static uint64_t next_id() {
+        static std::atomic<uint64_t> id{0};
+        return ++id;
+    }
+
+    // `parts` one after another, cut off where dst ends
+    template <size_t N>
+    static void copy(char (&dst)[N], std::initializer_list<std::string_view> parts) {
+        size_t n = 0;
+        for (std::string_view part : parts) {
+            size_t take = std::min(part.size(), N - 1 - n);
+            if (take)
+                std::memcpy(dst + n, part.data(), take);
+            n += take;
+        }
+        dst[n] = '\0';
+    }
+
+    ring& local() {
+        thread_local list<std::pair<uint64_t, ring*>> owned;
+        for (const auto& [id, r] : owned)
+            if (id == id_)
+                return *r;
+
+        auto r     = std::make_unique<ring>();
+        r->records = std::make_unique<access_record[]>(capacity_);
+
+        std::lock_guard lock(rings_mutex_);
+        rings_.push_back(std::move(r));
+        owned.emplace_back(id_, rings_.back().get());
+        return *rings_.back();
+    }
+
+    void run() {
+        std::unique_lock lock(wake_mutex_);
+        while (!stopping_) {
+            wake_.wait_for(lock, opts_.flush_interval, [this] { return stopping_; });
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    }
+
+    void drain() {
+        list<ring*> rings;
+        {
+            std::lock_guard lock(rings_mutex_);
+            for (const auto& r : rings_)
+                rings.push_back(r.get());
+        }
+
+        uint64_t count = 0;
+        for (ring* r : rings) {
+            size_t tail = r->tail.load(std::memory_order_relaxed);
+            size_t head = r->head.load(std::memory_order_acquire);
+            for (; tail != head; ++tail, ++count)
+                format(r->records[tail & (capacity_ - 1)]);
+            r->tail.store(tail, std::memory_order_release);
+        }
+
+        if (batch_.empty())
+            return;
+
+        if (file_ && file_ != stdout && file_size_ + batch_.size() > opts_.max_file_bytes && file_size_ > 0)
+            rotate();
+
+        if (file_) {
+            std::fwrite(batch_.data(), 1, batch_.size(), file_);
+            std::fflush(file_);
+            file_size_ += batch_.size();
+        }
+        written_.fetch_add(count, std::memory_order_relaxed);
+        batch_.clear();
+    }
+
+    void open() {
+        if (opts_.path == "-") {
+            file_ = stdout;
+            return;
+        }
+
+        file_ = std::fopen(opts_.path.c_str(), "ab");
+        if (!file_)
+            throw std::runtime_error("Could not open access log " + opts_.path);
+
+        // batches are written whole; the stdio buffer would only split them
+        std::setvbuf(file_, nullptr, _IONBF, 0);
+        std::fseek(file_, 0, SEEK_END);
+        long size  = std::ftell(file_);
+        file_size_ = size > 0 ? static_cast<size_t>(size) : 0;
+    }
+
+    void close() {
+        if (file_ && file_ != stdout)
+            std::fclose(file_);
+        file_ = nullptr;
+    }
+
+    // access.log -> access.log.1 -> ... -> access.log.<max_files>, the oldest is removed
+    void rotate() {
+        close();
+        for (int i = opts_.max_files; i > 0; --i) {
+            string from = i == 1 ? opts_.path : opts_.path + "." + std::to_string(i - 1);
+            string to   = opts_.path + "." + std::to_string(i);
+            std::remove(to.c_str());
+            std::rename(from.c_str(), to.c_str());
+        }
+        if (opts_.max_files <= 0)
+            std::remove(opts_.path.c_str());
+
+        file_size_ = 0;
+        try {
+            open();
+        } catch (const std::exception&) {
+            // keep counting; nothing is written until the file can be opened again
+            file_ = nullptr;
+        }
+    }
+
+    void append(std::string_view s) { batch_.insert(batch_.end(), s.begin(), s.end()); }
+
+    void append(uint64_t v) {
+        char buf[24];
+        auto [end, ec] = std::to_chars(buf, buf + sizeof buf, v);
+        batch_.insert(batch_.end(), buf, end);
+    }
+
+    // CLF fields are quoted; a quote or control character inside one would end it early
+    void append_quoted(const char* s) {
+        batch_.push_back('"');
+        append_escaped(s);
+        batch_.push_back('"');
+    }
+
+    void append_escaped(const char* s) {
+        for (; *s; ++s) {
+            unsigned char c = static_cast<unsigned char>(*s);
+            if (c == '"' || c == '\\' || c < 0x20 || c == 0x7f) {
+                static constexpr char hex[] = "0123456789abcdef";
+                char esc[4] = {'\\', 'x', hex[c >> 4], hex[c & 15]};
+                batch_.insert(batch_.end(), esc, esc + 4);
+            } else {
+                batch_.push_back(*s);
+            }
+        }
+    }
+
+    void format(const access_record& rec) {
+        if (opts_.format == log_format::json) {
+            buffer_body_writer out(batch_);
+            json_writer w(out, 1024);
+            w.begin_object()
+                .key("time").value(timestamp(rec.time_ns, true))
+                .key("remote").value(rec.remote)
+                .key("method").value(rec.method)
+                .key("path").value(rec.path)
+                .key("protocol").value(rec.protocol)
+                .key("status").value(rec.status)
+                .key("bytes_in").value(rec.bytes_in)
+                .key("bytes_out").value(rec.bytes_out)
+                .key("duration_us").value(rec.duration_ns / 1000)
+                .key("referer").value(rec.referer)
+                .key("user_agent").value(rec.user_agent)
+                .end_object();
+            w.flush();
+            batch_.push_back('\n');
+            return;
+        }
+
+        // 127.0.0.1 - - [10/Oct/2000:13:55:36 +0000] "GET /a.gif HTTP/1.0" 200 2326 "ref" "agent"
+        append(*rec.remote ? rec.remote : "-");
+        append(" - - [");
+        append(timestamp(rec.time_ns, false));
+        append("] \"");
+        append_escaped(rec.method);
+        append(" ");
+        append_escaped(rec.path);
+        append(" ");
+        append_escaped(rec.protocol);
+        append("\" ");
+        append(static_cast<uint64_t>(rec.status));
+        append(" ");
+        if (rec.bytes_out)
+            append(rec.bytes_out);
+        else
+            append("-");
+
+        if (opts_.format == log_format::combined) {
+            append(" ");
+            append_quoted(*rec.referer ? rec.referer : "-");
+            append(" ");
+            append_quoted(*rec.user_agent ? rec.user_agent : "-");
+        }
+        batch_.push_back('\n');
+    }
+
+    // UTC, as 10/Oct/2000:13:55:36 +0000 (CLF) or 2000-10-10T13:55:36.123Z (ISO 8601)
+    static string timestamp(int64_t ns, bool iso) {
+        int64_t secs = ns / 1000000000;
+        int64_t days = secs / 86400;
+        int64_t rem  = secs % 86400;
+
+        // days since 1970-01-01 to a civil date (Howard Hinnant's algorithm)
+        int64_t z   = days + 719468;
+        int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+        int64_t doe = z - era * 146097;
+        int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        int64_t mp  = (5 * doy + 2) / 153;
+        int day     = static_cast<int>(doy - (153 * mp + 2) / 5 + 1);
+        int month   = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+        int year    = static_cast<int>(yoe + era * 400 + (month <= 2));
+
+        char buf[40];
+        if (iso) {
+            std::snprintf(buf, sizeof buf, "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ", year, month, day,
+                          static_cast<int>(rem / 3600), static_cast<int>(rem / 60 % 60),
+                          static_cast<int>(rem % 60), static_cast<int>(ns / 1000000 % 1000));
+        } else {
+            static constexpr const char* months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                                     "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+            std::snprintf(buf, sizeof buf, "%02d/%s/%04d:%02d:%02d:%02d +0000", day, months[month - 1], year,
+                          static_cast<int>(rem / 3600), static_cast<int>(rem / 60 % 60),
+                          static_cast<int>(rem % 60));
+        }
+        return buf;
+    }
+};
+
+} // namespace net::http
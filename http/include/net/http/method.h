@@ -2,6 +2,7 @@
 // std
 #include <algorithm>
 #include <map>
+#include <string_view>
 
 // lib
 #include <utils/string.h>
@@ -26,6 +27,8 @@ struct method {
 
     string str() const { return _method; }
 
+    std::string_view view() const { return _method; }
+
     const bool equals(const method& other) const { return str().compare(other.str()) == 0; }
 
     static method Get;     // = method("GET");
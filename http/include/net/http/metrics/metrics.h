@@ -0,0 +1,249 @@
+#pragma once
+// std
+#include <atomic>
+#include <chrono>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+// lib
+#include <net/histogram.h>
+#include <net/listen_stats.h>
+#include <types.h>
+#include "../routing/router.h"
+
+namespace net::http {
+
+// Server counters and latency histograms. Each recording thread gets a shard of its own, so
+// the hot path is a relaxed load and store to memory no other thread writes: no locks and no
+// contended cache lines. Readers (the /metrics route) add the shards up.
+class metrics {
+  public:
+    enum class counter : size_t {
+        accepted,
+        closed,
+        accept_errors,
+        bytes_in,
+        bytes_out,
+        parse_errors,
+        timeouts,
+        shed,
+        rate_limited,
+        too_large,
+        count_
+    };
+
+    enum class timing : size_t {
+        // accept to the first response byte written
+        first_byte,
+        // router::route_request, filters and cache included
+        handler,
+        count_
+    };
+
+    // route index for requests no route matched
+    static constexpr size_t no_route = SIZE_MAX;
+
+    metrics() : id_(next_id()) {}
+
+    metrics(const metrics&)            = delete;
+    metrics& operator=(const metrics&) = delete;
+
+    void add(counter c, uint64_t n = 1) { bump(local().counters[index(c)], n); }
+
+    void record(timing t, std::chrono::nanoseconds elapsed) {
+        uint64_t ns = elapsed.count() > 0 ? static_cast<uint64_t>(elapsed.count()) : 0;
+        shard& s    = local();
+        bump(s.buckets[index(t) * net::histogram::bucket_count + net::histogram::index_of(ns)], 1);
+        bump(s.sums[index(t)], ns);
+    }
+
+    // one response with `status` from route `route` (router order), or no_route
+    void request(size_t route, int status) {
+        shard& s     = local();
+        uint64_t key = (static_cast<uint64_t>(route + 1) << 16) | static_cast<uint16_t>(status);
+
+        // only this thread inserts into its map, so looking up without the lock is safe
+        auto it = s.requests.find(key);
+        if (it == s.requests.end()) {
+            std::lock_guard lock(s.requests_mutex);
+            it = s.requests.try_emplace(key, 0).first;
+        }
+        bump(it->second, 1);
+    }
+
+    uint64_t value(counter c) const {
+        uint64_t total = 0;
+        for_each_shard([&](const shard& s) { total += s.counters[index(c)].load(std::memory_order_relaxed); });
+        return total;
+    }
+
+    // accepted and not yet closed
+    uint64_t active() const {
+        uint64_t accepted = value(counter::accepted);
+        uint64_t closed   = value(counter::closed);
+        return accepted > closed ? accepted - closed : 0;
+    }
+
+    // bucket-accurate copy of a timing histogram, in nanoseconds
+    net::histogram snapshot(timing t) const {
+        net::histogram h;
+        for_each_shard([&](const shard& s) {
+            const std::atomic<uint64_t>* b = &s.buckets[index(t) * net::histogram::bucket_count];
+            for (size_t i = 0; i < net::histogram::bucket_count; ++i)
+                if (uint64_t n = b[i].load(std::memory_order_relaxed))
+                    h.record(net::histogram::highest_equivalent(i), n);
+        });
+        return h;
+    }
+
+    // Prometheus text exposition format 0.0.4; route labels come from `r`
+    string prometheus(const router& r, const net::listen_stats& listener = {}) const {
+        std::ostringstream out;
+
+        auto scalar = [&](const char* name, const char* type, const char* help, uint64_t v) {
+            out << "# HELP " << name << ' ' << help << "\n# TYPE " << name << ' ' << type << '\n'
+                << name << ' ' << v << '\n';
+        };
+
+        scalar("net_http_connections_accepted_total", "counter", "Connections accepted.", value(counter::accepted));
+        scalar("net_http_connections_active", "gauge", "Connections accepted and not yet closed.", active());
+        scalar("net_http_accept_errors_total", "counter", "Failed accept calls.", value(counter::accept_errors));
+        scalar("net_http_received_bytes_total", "counter", "Request bytes read.", value(counter::bytes_in));
+        scalar("net_http_sent_bytes_total", "counter", "Response bytes written.", value(counter::bytes_out));
+        scalar("net_http_parse_errors_total", "counter", "Requests that could not be parsed.",
+               value(counter::parse_errors));
+        scalar("net_http_timeouts_total", "counter",
+               "Connections that timed out reading a request or writing a response.", value(counter::timeouts));
+        scalar("net_http_shed_total", "counter", "Requests answered 503 by admission control.",
+               value(counter::shed));
+        scalar("net_http_rate_limited_total", "counter", "Requests answered 429 by the rate limiter.",
+               value(counter::rate_limited));
+        scalar("net_http_too_large_total", "counter", "Requests answered 431 or 413 for their size.",
+               value(counter::too_large));
+
+        if (listener.available) {
+            scalar("net_http_listen_queue_length", "gauge", "Connections waiting to be accepted.",
+                   listener.queued);
+            scalar("net_http_listen_backlog", "gauge", "Accept queue limit of the listening socket.",
+                   listener.backlog);
+            scalar("net_http_listen_overflows_total", "counter",
+                   "Handshakes completed while an accept queue was full, host-wide.", listener.overflows);
+            scalar("net_http_listen_drops_total", "counter", "SYNs dropped at listening sockets, host-wide.",
+                   listener.drops);
+        }
+
+        std::unordered_map<uint64_t, uint64_t> requests;
+        for_each_shard([&](const shard& s) {
+            std::lock_guard lock(s.requests_mutex);
+            for (const auto& [key, n] : s.requests)
+                requests[key] += n.load(std::memory_order_relaxed);
+        });
+
+        out << "# HELP net_http_requests_total Responses by route and status.\n"
+            << "# TYPE net_http_requests_total counter\n";
+        for (const auto& [key, n] : requests) {
+            size_t route       = static_cast<size_t>(key >> 16) - 1;
+            const auto* entry  = r.route_at(route);
+            out << "net_http_requests_total{method=\"" << (entry ? entry->method.str() : string())
+                << "\",route=\"" << escape(entry ? entry->pattern.original_path : string())
+                << "\",code=\"" << (key & 0xffff) << "\"} " << n << '\n';
+        }
+
+        histogram_text(out, "net_http_time_to_first_byte_seconds", "Accept to first response byte.",
+                       timing::first_byte);
+        histogram_text(out, "net_http_handler_duration_seconds", "Time spent routing and in handlers.",
+                       timing::handler);
+        return out.str();
+    }
+
+  private:
+    static constexpr size_t counter_count = static_cast<size_t>(counter::count_);
+    static constexpr size_t timing_count  = static_cast<size_t>(timing::count_);
+
+    struct alignas(64) shard {
+        std::atomic<uint64_t> counters[counter_count]{};
+        std::atomic<uint64_t> sums[timing_count]{};
+        std::unique_ptr<std::atomic<uint64_t>[]> buckets{
+            new std::atomic<uint64_t>[timing_count * net::histogram::bucket_count]()};
+
+        mutable std::mutex requests_mutex;
+        std::unordered_map<uint64_t, std::atomic<uint64_t>> requests;
+    };
+
+    uint64_t id_;
+    mutable std::mutex shards_mutex_;
+    list<std::unique_ptr<shard>> shards_;
+
+    static uint64_t next_id() {
+        static std::atomic<uint64_t> id{0};
+        return ++id;
+    }
+
+    template <typename E>
+    static constexpr size_t index(E e) {
+        return static_cast<size_t>(e);
+    }
+
+    // a single writer per shard, so no read-modify-write instruction is needed
+    static void bump(std::atomic<uint64_t>& a, uint64_t n) {
+        a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    shard& local() {
+        // keyed by id rather than address so a new instance never inherits a dead one's shard
+        thread_local list<std::pair<uint64_t, shard*>> owned;
+        for (const auto& [id, s] : owned)
+            if (id == id_)
+                return *s;
+
+        std::lock_guard lock(shards_mutex_);
+        shards_.push_back(std::make_unique<shard>());
+        owned.emplace_back(id_, shards_.back().get());
+        return *shards_.back();
+    }
+
+    template <typename Fn>
+    void for_each_shard(Fn fn) const {
+        std::lock_guard lock(shards_mutex_);
+        for (const auto& s : shards_)
+            fn(*s);
+    }
+
+    void histogram_text(std::ostringstream& out, const char* name, const char* help, timing t) const {
+        static constexpr double bounds[] = {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025,
+                                            0.05,   0.1,     0.25,   0.5,   1,      2.5,   5,     10};
+
+        uint64_t sum = 0;
+        for_each_shard([&](const shard& s) { sum += s.sums[index(t)].load(std::memory_order_relaxed); });
+
+        net::histogram h = snapshot(t);
+        uint64_t counts[std::size(bounds)] = {};
+        h.for_each_bucket([&](uint64_t upper, uint64_t n) {
+            for (size_t i = 0; i < std::size(bounds); ++i)
+                if (upper <= static_cast<uint64_t>(bounds[i] * 1e9))
+                    counts[i] += n;
+        });
+
+        out << "# HELP " << name << ' ' << help << "\n# TYPE " << name << " histogram\n";
+        for (size_t i = 0; i < std::size(bounds); ++i)
+            out << name << "_bucket{le=\"" << bounds[i] << "\"} " << counts[i] << '\n';
+        out << name << "_bucket{le=\"+Inf\"} " << h.count() << '\n'
+            << name << "_sum " << sum / 1e9 << '\n'
+            << name << "_count " << h.count() << '\n';
+    }
+
+    static string escape(const string& label) {
+        string out;
+        for (char c : label) {
+            if (c == '\\' || c == '"' || c == '\n')
+                out.push_back('\\');
+            out.push_back(c == '\n' ? 'n' : c);
+        }
+        return out;
+    }
+};
+
+} // namespace net::http
@@ -0,0 +1,162 @@
+#pragma once
+// std
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <mutex>
+
+// lib
+#include <net/histogram.h>
+#include <types.h>
+#include "../json_writer.h"
+
+namespace net::http {
+
+struct tracing_options {
+    // fraction of requests traced; 0.01 is every hundredth request
+    double sample_rate = 0.01;
+    // completed traces kept for export, oldest dropped first
+    size_t max_samples = 10000;
+};
+
+// Timestamps of one request on its way through the server. Each phase runs from its mark to
+// the next one: select is the wait in select() for the read that completed the request,
+// dispatch the time until its socket was looked at, queue the wait for a pool thread, parse
+// includes the upgrade check, handler covers routing, filters and the cache.
+struct request_trace {
+    enum mark : size_t { select_begin, select_end, read_begin, read_end, dequeued, routed, handled, written, mark_count };
+
+    static constexpr size_t phase_count = mark_count - 1;
+    static constexpr const char* phase_names[phase_count] = {"select", "dispatch", "read", "queue",
+                                                             "parse",  "handler",  "write"};
+
+    using clock = std::chrono::steady_clock;
+
+    clock::time_point marks[mark_count];
+    string method;
+    string path;
+    int status = 0;
+
+    void stamp(mark m) { marks[m] = clock::now(); }
+
+    std::chrono::nanoseconds phase(size_t i) const {
+        auto d = marks[i + 1] - marks[i];
+        return d.count() > 0 ? std::chrono::duration_cast<std::chrono::nanoseconds>(d) : std::chrono::nanoseconds(0);
+    }
+};
+
+// Collects sampled request traces. Whether a request is traced is decided once its bytes are
+// in, so an untraced request costs a counter increment; with tracing off the server does not
+// take timestamps at all. Completed traces feed a histogram per phase and are kept for export
+// as Chrome trace events (chrome://tracing, Perfetto).
+class tracer {
+  public:
+    explicit tracer(tracing_options opts = {}) : opts_(opts), epoch_(request_trace::clock::now()) {
+        every_ = opts_.sample_rate > 0 ? static_cast<uint64_t>(std::llround(1.0 / std::min(opts_.sample_rate, 1.0))) : 0;
+    }
+
+    bool sample() {
+        return every_ && seen_.fetch_add(1, std::memory_order_relaxed) % every_ == 0;
+    }
+
+    void submit(request_trace trace) {
+        std::lock_guard lock(mutex_);
+        for (size_t i = 0; i < request_trace::phase_count; ++i)
+            phases_[i].record(static_cast<uint64_t>(trace.phase(i).count()));
+
+        if (opts_.max_samples == 0)
+            return;
+        if (samples_.size() == opts_.max_samples)
+            samples_.pop_front();
+        samples_.push_back({next_id_++, std::move(trace)});
+    }
+
+    // nanoseconds spent in phase `i` (request_trace::phase_names) across all sampled requests
+    net::histogram phase(size_t i) const {
+        std::lock_guard lock(mutex_);
+        return phases_[i];
+    }
+
+    // {"traceEvents": [...]}, one row per request with a complete event per phase
+    string chrome_json() const {
+        list<char> out;
+        buffer_body_writer sink(out);
+        json_writer w(sink);
+
+        w.begin_object().key("traceEvents").begin_array();
+        {
+            std::lock_guard lock(mutex_);
+            for (const auto& [id, t] : samples_) {
+                for (size_t i = 0; i < request_trace::phase_count; ++i) {
+                    w.begin_object()
+                        .key("name").value(request_trace::phase_names[i])
+                        .key("cat").value("http")
+                        .key("ph").value("X")
+                        .key("pid").value(1)
+                        .key("tid").value(id)
+                        .key("ts").value(micros(t.marks[i] - epoch_))
+                        .key("dur").value(micros(t.marks[i + 1] - t.marks[i]))
+                        .key("args").begin_object()
+                        .key("method").value(t.method)
+                        .key("path").value(t.path)
+                        .key("status").value(t.status)
+                        .end_object()
+                        .end_object();
+                }
+            }
+        }
+        w.end_array().key("displayTimeUnit").value("ns").end_object();
+        w.flush();
+        return string(out.begin(), out.end());
+    }
+
+    // per phase: count, mean, p50, p90, p99 and max in microseconds
+    string summary_json() const {
+        list<char> out;
+        buffer_body_writer sink(out);
+        json_writer w(sink);
+
+        w.begin_object();
+        for (size_t i = 0; i < request_trace::phase_count; ++i) {
+            net::histogram h = phase(i);
+            w.key(request_trace::phase_names[i])
+                .begin_object()
+                .key("count").value(h.count())
+                .key("mean_us").value(h.mean() / 1000)
+                .key("p50_us").value(h.percentile(50) / 1000.0)
+                .key("p90_us").value(h.percentile(90) / 1000.0)
+                .key("p99_us").value(h.percentile(99) / 1000.0)
+                .key("max_us").value(h.max() / 1000.0)
+                .end_object();
+        }
+        w.end_object();
+        w.flush();
+        return string(out.begin(), out.end());
+    }
+
+    void clear() {
+        std::lock_guard lock(mutex_);
+        samples_.clear();
+        for (auto& h : phases_)
+            h.reset();
+    }
+
+  private:
+    tracing_options opts_;
+    request_trace::clock::time_point epoch_;
+    uint64_t every_;
+    std::atomic<uint64_t> seen_{0};
+
+    mutable std::mutex mutex_;
+    std::deque<std::pair<uint64_t, request_trace>> samples_;
+    net::histogram phases_[request_trace::phase_count];
+    uint64_t next_id_ = 1;
+
+    static double micros(request_trace::clock::duration d) {
+        return std::chrono::duration<double, std::micro>(d).count();
+    }
+};
+
+} // namespace net::http
@@ -0,0 +1,292 @@
+#pragma once
+// std
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <memory>
+
+// lib
+#include "../client/connection_pool.h"
+#include "../client/response_parser.h"
+#include "../request.h"
+#include "upstream.h"
+
+namespace net::http {
+
+struct proxy_options {
+    std::chrono::milliseconds connect_timeout{2000};
+    std::chrono::milliseconds read_timeout{30000};
+    size_t max_idle_per_upstream = 32;
+    std::chrono::seconds idle_timeout{60};
+    // removed from the front of the request path before forwarding, e.g. "/api"
+    string strip_prefix;
+};
+
+// Route handler forwarding requests to an upstream_pool over persistent connections. The
+// upstream response head is read inside the handler; the body is spliced to the client through
+// the response stream in fixed-size reads, so it is never held in memory as a whole.
+class proxy_handler {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    proxy_handler(std::shared_ptr<upstream_pool> upstreams, proxy_options options = {})
+        : state_(std::make_shared<shared_state>(std::move(upstreams), options)) {}
+
+    response operator()(const request& req) const {
+        upstream_ptr u = state_->upstreams->pick();
+        if (!u)
+            return gateway_error(502);
+
+        string wire = forward_request(req);
+        bool head   = req.http_method.str() == "HEAD";
+
+        // a pooled connection may have been closed by the upstream while idle; that only
+        // shows once we use it, so a failure before any response byte retries on a fresh one
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            auto x     = std::make_shared<exchange>(state_, u);
+            bool fresh = !(x->socket = state_->idle.acquire(u->key()));
+            if (fresh && !(x->socket = connect(*u)))
+                return x->fail(502);
+
+            x->parser.reset(head);
+            if (!x->socket->write_all(wire)) {
+                if (fresh)
+                    return x->fail(502);
+                x->discard();
+                continue;
+            }
+
+            read_result result = x->read_head();
+            if (result == read_result::closed && !fresh && !x->parser.in_progress()) {
+                x->discard();
+                continue;
+            }
+            if (result == read_result::timeout)
+                return x->fail(504);
+            if (result != read_result::ok)
+                return x->fail(502);
+
+            return x->respond();
+        }
+
+        return gateway_error(502);
+    }
+
+  private:
+    struct shared_state {
+        std::shared_ptr<upstream_pool> upstreams;
+        proxy_options options;
+        connection_pool idle;
+
+        shared_state(std::shared_ptr<upstream_pool> u, const proxy_options& o)
+            : upstreams(std::move(u)), options(o), idle(o.max_idle_per_upstream, o.idle_timeout) {}
+    };
+
+    enum class read_result { ok, timeout, closed, error };
+
+    // One request/response exchange with an upstream. Whoever drops the last reference without
+    // finishing the body (an aborted stream, a client that went away) closes the connection.
+    struct exchange : std::enable_shared_from_this<exchange> {
+        std::shared_ptr<shared_state> state;
+        upstream_ptr target;
+        net::sock_ptr socket;
+        response_parser parser;
+        string pending;
+        clock::time_point started = clock::now();
+        int status                = 0;
+        bool settled              = false;
+
+        exchange(std::shared_ptr<shared_state> s, upstream_ptr u)
+            : state(std::move(s)), target(std::move(u)) {
+            target->begin();
+        }
+
+        ~exchange() { settle(false); }
+
+        read_result read_head() {
+            while (!parser.headers_complete()) {
+                read_result r = read_more();
+                if (r != read_result::ok)
+                    return r;
+            }
+            return read_result::ok;
+        }
+
+        read_result read_more() {
+            if (!socket->wait_readable(static_cast<int>(state->options.read_timeout.count())))
+                return read_result::timeout;
+
+            char buffer[16384];
+            int n = ::recv(*socket, buffer, sizeof(buffer), 0);
+            if (n <= 0) {
+                parser.finish();
+                return parser.done() ? read_result::ok : read_result::closed;
+            }
+
+            pending.append(buffer, n);
+            size_t used = parser.feed(pending.data(), pending.size());
+            pending.erase(0, used);
+
+            return parser.failed() ? read_result::error : read_result::ok;
+        }
+
+        response respond() {
+            response res;
+            const response& up = parser.peek();
+            status             = up.get_status_code();
+            res.set_status_code(up.get_status_code());
+            res.set_status_message(up.get_status_message());
+
+            string content_length;
+            for (const auto& [name, value] : up.get_headers()) {
+                if (iequals(name, "Content-Length"))
+                    content_length = value;
+                else if (!hop_by_hop(name))
+                    res.set_header(name, value);
+            }
+
+            if (parser.done()) {
+                res.set_body(parser.take().get_body());
+                settle(true);
+                return res;
+            }
+
+            // keep the upstream's framing when it announced a length; otherwise re-chunk
+            if (!content_length.empty())
+                res.set_header("Content-Length", content_length);
+
+            std::shared_ptr<exchange> self = shared_from_this();
+            res.set_stream([self](body_writer& out) {
+                self->parser.stream_body(
+                    [&out](const char* data, size_t len) { return out.write(data, len); });
+
+                while (!self->parser.done()) {
+                    if (self->parser.failed() || self->read_more() != read_result::ok) {
+                        self->settle(false);
+                        return false;
+                    }
+                }
+
+                self->settle(true);
+                return true;
+            });
+            return res;
+        }
+
+        response fail(int code) {
+            settle(false);
+            return gateway_error(code);
+        }
+
+        // stale pooled connection: not the upstream's fault, so it is not held against it
+        void discard() {
+            settled = true;
+            target->end();
+            socket->close();
+        }
+
+        void settle(bool success) {
+            if (settled)
+                return;
+            settled = true;
+
+            auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - started);
+            bool healthy = success && status < 500;
+            state->upstreams->record(*target, healthy, latency);
+            target->end();
+
+            if (!socket)
+                return;
+            if (success && parser.keep_alive() && pending.empty())
+                state->idle.release(target->key(), socket);
+            else
+                socket->close();
+        }
+    };
+
+    std::shared_ptr<shared_state> state_;
+
+    net::sock_ptr connect(const upstream& u) const {
+        net::sock_ptr s;
+        try {
+            s = std::make_shared<net::socket>(u.endpoint());
+        } catch (const std::exception&) {
+            return nullptr;
+        }
+
+        // bounded connect: non-blocking connect, wait, then back to blocking I/O
+        u_long mode = 1;
+        ioctlsocket(*s, FIONBIO, &mode);
+        s->non_blocking = true;
+
+        bool connected  = s->connect(u.endpoint()) &&
+                         s->wait_writable(static_cast<int>(state_->options.connect_timeout.count()));
+
+        int err       = 0;
+        socklen_t len = sizeof(err);
+        if (connected)
+            getsockopt(*s, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&err), &len);
+
+        mode            = 0;
+        ioctlsocket(*s, FIONBIO, &mode);
+        s->non_blocking = false;
+
+        if (!connected || err != 0) {
+            s->close();
+            return nullptr;
+        }
+        return s;
+    }
+
+    string forward_request(const request& req) const {
+        request out(req.http_method);
+        out.http_version = "HTTP/1.1";
+        out.full_path    = req.full_path.empty() ? req.path : req.full_path;
+        out.body         = req.body;
+
+        const string& prefix = state_->options.strip_prefix;
+        if (!prefix.empty() && out.full_path.compare(0, prefix.size(), prefix) == 0) {
+            out.full_path.erase(0, prefix.size());
+            if (out.full_path.empty() || out.full_path.front() != '/')
+                out.full_path.insert(out.full_path.begin(), '/');
+        }
+
+        for (const auto& [name, value] : req.headers)
+            if (!hop_by_hop(name))
+                out.headers[name] = value;
+
+        if (req.peer && req.peer->is_specified() && !req.peer->is_unix()) {
+            string forwarded = req.get_header("X-Forwarded-For");
+            out.headers["X-Forwarded-For"] =
+                forwarded.empty() ? req.peer->ip_address() : forwarded + ", " + req.peer->ip_address();
+        }
+
+        return out.to_string();
+    }
+
+    static response gateway_error(int code) {
+        response res;
+        res.set_status(code, code == 504 ? "Gateway Timeout" : "Bad Gateway");
+        return res;
+    }
+
+    static bool iequals(const string& a, const char* b) {
+        size_t n = std::char_traits<char>::length(b);
+        return a.size() == n && std::equal(a.begin(), a.end(), b, [](char x, char y) {
+                   return std::tolower(static_cast<unsigned char>(x)) ==
+                          std::tolower(static_cast<unsigned char>(y));
+               });
+    }
+
+    static bool hop_by_hop(const string& name) {
+        static const char* const names[] = {"Connection", "Keep-Alive",        "Proxy-Authenticate",
+                                            "Proxy-Authorization", "TE",       "Trailer",
+                                            "Transfer-Encoding",   "Upgrade"};
+        for (const char* n : names)
+            if (iequals(name, n))
+                return true;
+        return false;
+    }
+};
+
+} // namespace net::http
@@ -0,0 +1,192 @@
+#pragma once
+// std
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <random>
+
+// lib
+#include <net/endpoint.h>
+#include <types.h>
+
+namespace net::http {
+
+enum class balance { least_connections, power_of_two };
+
+// Passive health checking: every proxied exchange feeds an exponentially weighted error rate and
+// latency. An upstream crossing either limit is ejected for `ejection_time`, then re-admitted.
+struct health_options {
+    double max_error_rate = 0.5;
+    std::chrono::milliseconds max_latency{2000};
+    // observations before an upstream may be ejected at all
+    size_t min_requests   = 20;
+    std::chrono::seconds ejection_time{10};
+    double smoothing      = 0.1;
+    // never eject more than this share of the pool at once
+    double max_ejected    = 0.5;
+};
+
+class upstream {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    upstream(const string& host, int port)
+        : host_(host), port_(port), endpoint_(net::ip_endpoint::resolve(host, port)),
+          key_(host + ":" + std::to_string(port)) {}
+
+    const string& host() const { return host_; }
+    int port() const { return port_; }
+    const net::ip_endpoint& endpoint() const { return endpoint_; }
+    const string& key() const { return key_; }
+
+    int active() const { return active_.load(std::memory_order_relaxed); }
+    void begin() { active_.fetch_add(1, std::memory_order_relaxed); }
+    void end() { active_.fetch_sub(1, std::memory_order_relaxed); }
+
+    bool ejected(clock::time_point now) const {
+        return now < clock::time_point(clock::duration(ejected_until_.load(std::memory_order_relaxed)));
+    }
+
+    double error_rate() const {
+        std::lock_guard lock(mutex_);
+        return error_rate_;
+    }
+
+    double latency_ms() const {
+        std::lock_guard lock(mutex_);
+        return latency_ms_;
+    }
+
+    // returns true when this observation pushed the upstream over a limit
+    bool record(bool success, std::chrono::milliseconds latency, const health_options& o) {
+        std::lock_guard lock(mutex_);
+        double a    = o.smoothing;
+        error_rate_ = (1 - a) * error_rate_ + a * (success ? 0.0 : 1.0);
+        latency_ms_ = (1 - a) * latency_ms_ + a * static_cast<double>(latency.count());
+        ++observations_;
+
+        return observations_ >= o.min_requests &&
+               (error_rate_ > o.max_error_rate || latency_ms_ > o.max_latency.count());
+    }
+
+    void eject(clock::time_point until) {
+        ejected_until_.store(until.time_since_epoch().count(), std::memory_order_relaxed);
+
+        // start from a clean slate after the ejection so one bad period is not held against it
+        std::lock_guard lock(mutex_);
+        error_rate_   = 0;
+        latency_ms_   = 0;
+        observations_ = 0;
+    }
+
+  private:
+    string host_;
+    int port_;
+    net::ip_endpoint endpoint_;
+    string key_;
+
+    std::atomic<int> active_{0};
+    std::atomic<clock::rep> ejected_until_{0};
+
+    mutable std::mutex mutex_;
+    double error_rate_   = 0;
+    double latency_ms_   = 0;
+    size_t observations_ = 0;
+};
+
+using upstream_ptr = std::shared_ptr<upstream>;
+
+class upstream_pool {
+  public:
+    using clock = upstream::clock;
+
+    upstream_pool(balance strategy = balance::power_of_two, health_options health = {})
+        : strategy_(strategy), health_(health) {}
+
+    upstream_pool& add(const string& host, int port) {
+        upstreams_.push_back(std::make_shared<upstream>(host, port));
+        return *this;
+    }
+
+    const list<upstream_ptr>& upstreams() const { return upstreams_; }
+
+    const health_options& health() const { return health_; }
+
+    // Ejected upstreams are skipped; if all of them are ejected, all are eligible again
+    // (panic mode) so traffic still flows rather than failing outright.
+    upstream_ptr pick() {
+        if (upstreams_.empty())
+            return nullptr;
+
+        clock::time_point now = clock::now();
+        thread_local list<upstream*> healthy;
+        healthy.clear();
+        for (auto& u : upstreams_)
+            if (!u->ejected(now))
+                healthy.push_back(u.get());
+
+        if (healthy.empty())
+            for (auto& u : upstreams_)
+                healthy.push_back(u.get());
+
+        upstream* chosen = strategy_ == balance::least_connections ? least_connections(healthy)
+                                                                    : power_of_two(healthy);
+        for (auto& u : upstreams_)
+            if (u.get() == chosen)
+                return u;
+        return nullptr;
+    }
+
+    void record(upstream& u, bool success, std::chrono::milliseconds latency) {
+        if (!u.record(success, latency, health_))
+            return;
+
+        clock::time_point now = clock::now();
+        size_t ejected        = 0;
+        for (auto& other : upstreams_)
+            if (other->ejected(now))
+                ++ejected;
+
+        if (ejected + 1 <= static_cast<size_t>(health_.max_ejected * upstreams_.size()))
+            u.eject(now + health_.ejection_time);
+    }
+
+  private:
+    balance strategy_;
+    health_options health_;
+    list<upstream_ptr> upstreams_;
+    std::atomic<size_t> rotation_{0};
+
+    static std::minstd_rand& rng() {
+        thread_local std::minstd_rand engine(std::random_device{}());
+        return engine;
+    }
+
+    upstream* least_connections(const list<upstream*>& candidates) {
+        // rotate the starting point so ties do not always land on the first upstream
+        size_t start  = rotation_.fetch_add(1, std::memory_order_relaxed);
+        upstream* best = nullptr;
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            upstream* u = candidates[(start + i) % candidates.size()];
+            if (!best || u->active() < best->active())
+                best = u;
+        }
+        return best;
+    }
+
+    static upstream* power_of_two(const list<upstream*>& candidates) {
+        if (candidates.size() == 1)
+            return candidates.front();
+
+        std::uniform_int_distribution<size_t> dist(0, candidates.size() - 1);
+        size_t a = dist(rng());
+        size_t b = dist(rng());
+        if (a == b)
+            b = (a + 1) % candidates.size();
+
+        return candidates[a]->active() <= candidates[b]->active() ? candidates[a] : candidates[b];
+    }
+};
+
+} // namespace net::http
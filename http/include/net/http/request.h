@@ -1,11 +1,18 @@
 #pragma once
 // std
+#include <charconv>
+#include <memory>
 #include <sstream>
+#include <string_view>
 
 // lib
+#include <net/endpoint.h>
 #include <utils/string.h>
+#include "detail/ascii.h"
+#include "form/url_encoded.h"
 #include "method.h"
 #include "http_types.h"
+#include "request_body.h"
 
 namespace net::http {
 
@@ -15,43 +22,109 @@ struct request {
     string full_path;
     string http_version;
     string_map headers;
-    list<char> body;
+    request_body body;
     string_map params;
-    string_map query_params;
     string query_string;
+    // peer of the connection the request arrived on; owned by the connection's socket
+    const net::ip_endpoint* peer = nullptr;
 
     request() : http_method(method::Unknown) {}
     request(method m) : http_method(m) {}
 
     string get_header(const string& name) const {
+        const string* value = find_header(name);
+        return value ? *value : string();
+    }
+
+    // like get_header without the copy; null when the header is not there
+    const string* find_header(const string& name) const {
         auto it = headers.find(name);
-        return it != headers.end() ? it->second : "";
+        if (it != headers.end())
+            return &it->second;
+
+        // clients do not agree on header casing ("Sec-WebSocket-Key" vs "sec-websocket-key")
+        for (const auto& [key, value] : headers)
+            if (detail::iequals(key, name))
+                return &value;
+        return nullptr;
     }
 
-    string get_body_as_string() const { return string(body.begin(), body.end()); }
+    string get_body_as_string() const { return body.str(); }
 
-    static request parse(const string& raw) {
-        request req;
+    // the body views the receive buffer; prefer this over get_body_as_string
+    std::string_view body_view() const { return body.view(); }
+
+    // application/x-www-form-urlencoded body fields, decoded on lookup; views the body, so it
+    // must not outlive the request
+    form::url_encoded form() const { return form::url_encoded(body.view()); }
+
+    // query string fields, decoded on lookup; views query_string, so it must not outlive the
+    // request
+    form::url_encoded query() const { return form::url_encoded(query_string); }
+
+    // every query field decoded, built on each call; later duplicates win. Prefer query().get
+    // for a few fields.
+    string_map query_params() const { return query().to_map(); }
+
+    void set_header(const string& name, const string& value) { headers[name] = value; }
+
+    // request target as it appears on the wire ("/path?a=1"); fills path and query_string
+    void set_target(const string& target) {
+        full_path = target;
+        *this     = parse_url(target);
+    }
+
+    // wire form for outbound requests (client, proxy)
+    string to_string() const {
+        string out;
+        out.reserve(64 + full_path.size() + body.size() + headers.size() * 32);
+
+        out.append(http_method.str()).append(" ");
+        out.append(full_path.empty() ? (path.empty() ? "/" : path) : full_path).append(" ");
+        out.append(http_version.empty() ? "HTTP/1.1" : http_version).append("\r\n");
+
+        for (const auto& [key, value] : headers)
+            out.append(key).append(": ").append(value).append("\r\n");
 
-        std::istringstream stream(raw);
-        string line;
+        if (!body.empty() && !headers.count("Content-Length"))
+            out.append("Content-Length: ").append(std::to_string(body.size())).append("\r\n");
 
-        if (!std::getline(stream, line) || line.empty()) {
+        out.append("\r\n");
+        out.append(body.begin(), body.end());
+        return out;
+    }
+
+    static request parse(const string& raw) { return parse(std::make_shared<const string>(raw)); }
+
+    // The body is not copied: it views `raw`, which the request keeps alive.
+    static request parse(std::shared_ptr<const string> raw) {
+        request req;
+        std::string_view text = *raw;
+
+        size_t eol = text.find('\n');
+        if (eol == 0 || eol == std::string_view::npos) {
             std::cerr << "Could not read request control data" << std::endl;
             throw std::invalid_argument("Could not read request control data.");
         }
 
+        std::string_view line = text.substr(0, eol);
         if (line.back() == '\r')
-            line.pop_back();
+            line.remove_suffix(1);
 
-        req = parse_control_data(line);
+        size_t body_start = eol + 1;
+        req = parse_control_data(string(line));
         req = parse_url(req.full_path);
-        req = parse_headers(stream);
+        req = parse_headers(text, body_start);
 
-        std::ostringstream body_stream;
-        body_stream << stream.rdbuf();
-        req.set_body(body_stream.str());
+        // anything past Content-Length belongs to the next request, not to this body
+        size_t length = text.size() - body_start;
+        string declared = req.get_header("Content-Length");
+        size_t content_length = 0;
+        if (!declared.empty() &&
+            std::from_chars(declared.data(), declared.data() + declared.size(), content_length).ec == std::errc())
+            length = std::min(length, content_length);
 
+        req.body = request_body(std::move(raw), body_start, length);
         return req;
     }
 
@@ -76,18 +149,15 @@ struct request {
     struct uri_data {
         string path;
         string query_string;
-        string_map query_params;
 
-        std::tuple<string&&, string&&, string_map&&> operator()() {
-            return std::make_tuple(std::move(path), std::move(query_string),
-                                   std::move(query_params));
+        std::tuple<string&&, string&&> operator()() {
+            return std::make_tuple(std::move(path), std::move(query_string));
         }
     };
 
     request& const operator=(uri_data&& data) {
         this->path         = std::move(data.path);
         this->query_string = std::move(data.query_string);
-        this->query_params = std::move(data.query_params);
         return *this;
     }
 
@@ -96,7 +166,7 @@ struct request {
         return *this;
     }
 
-    void set_body(string content) { body = list<char>(content.begin(), content.end()); }
+    void set_body(string content) { body.assign(std::move(content)); }
 
     void set_control_data(control_data&& data) {}
 
@@ -118,18 +188,6 @@ struct request {
         if (pos != string::npos) {
             u_d.path         = url.substr(0, pos);
             u_d.query_string = url.substr(pos + 1);
-
-            std::istringstream qstream(u_d.query_string);
-            string kv;
-
-            while (std::getline(qstream, kv, '&')) {
-                auto eq = kv.find('=');
-                if (eq != string::npos) {
-                    string key            = kv.substr(0, eq);
-                    string val            = kv.substr(eq + 1);
-                    u_d.query_params[key] = val;
-                }
-            }
         } else {
             u_d.path = url;
         }
@@ -137,23 +195,29 @@ struct request {
         return u_d;
     }
 
-    static string_map parse_headers(std::istringstream& stream) {
+    // reads header lines from `pos` up to the blank line and leaves `pos` at the body
+    static string_map parse_headers(std::string_view text, size_t& pos) {
         string_map headers;
-        string header_line;
 
-        while (std::getline(stream, header_line) && header_line != "\r") {
-            if (!header_line.empty() && header_line.back() == '\r') {
-                header_line.pop_back();
-            }
+        while (pos < text.size()) {
+            size_t eol = text.find('\n', pos);
+            if (eol == std::string_view::npos)
+                eol = text.size();
 
-            auto colon = header_line.find(':');
-            if (colon != string::npos) {
-                string key   = header_line.substr(0, colon);
-                string value = header_line.substr(colon + 1);
+            std::string_view header_line = text.substr(pos, eol - pos);
+            pos = std::min(eol + 1, text.size());
+
+            if (!header_line.empty() && header_line.back() == '\r')
+                header_line.remove_suffix(1);
+            if (header_line.empty())
+                break;
 
+            auto colon = header_line.find(':');
+            if (colon != std::string_view::npos) {
+                std::string_view value = header_line.substr(colon + 1);
                 if (!value.empty() && value.front() == ' ')
-                    value.erase(0, 1);
-                headers[key] = value;
+                    value.remove_prefix(1);
+                headers[string(header_line.substr(0, colon))] = string(value);
             }
         }
 
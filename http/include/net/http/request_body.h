@@ -0,0 +1,75 @@
+#pragma once
+// std
+#include <memory>
+#include <string_view>
+
+// lib
+#include <types.h>
+
+namespace net::http {
+
+// Request payload. A parsed request views the receive buffer it arrived in, so the body is not
+// copied out of it; copies of the request share that buffer. Appending (HTTP/2 DATA frames)
+// moves the body into a buffer of its own first.
+class request_body {
+  public:
+    using const_iterator = const char*;
+
+    request_body() = default;
+
+    request_body(std::shared_ptr<const string> buffer, size_t offset, size_t length)
+        : buffer_(std::move(buffer)), view_(std::string_view(*buffer_).substr(offset, length)) {}
+
+    const char* data() const { return view_.data(); }
+    size_t size() const { return view_.size(); }
+    bool empty() const { return view_.empty(); }
+
+    const_iterator begin() const { return view_.data(); }
+    const_iterator end() const { return view_.data() + view_.size(); }
+
+    char operator[](size_t i) const { return view_[i]; }
+
+    std::string_view view() const { return view_; }
+    operator std::string_view() const { return view_; }
+
+    string str() const { return string(view_); }
+
+    void assign(string data) {
+        auto owned = std::make_shared<string>(std::move(data));
+        view_      = *owned;
+        buffer_    = std::move(owned);
+        owned_     = true;
+    }
+
+    template <typename It>
+    void assign(It first, It last) {
+        assign(string(first, last));
+    }
+
+    void append(std::string_view data) {
+        if (!owned_ || buffer_.use_count() != 1) {
+            string copy;
+            copy.reserve(view_.size() + data.size());
+            copy.append(view_);
+            assign(std::move(copy));
+        }
+
+        // only reached for a buffer this body created and holds alone
+        string& owned = const_cast<string&>(*buffer_);
+        owned.append(data);
+        view_ = owned;
+    }
+
+    void clear() {
+        buffer_.reset();
+        view_  = {};
+        owned_ = false;
+    }
+
+  private:
+    std::shared_ptr<const string> buffer_;
+    std::string_view view_;
+    bool owned_ = false;
+};
+
+} // namespace net::http
@@ -1,10 +1,16 @@
 #pragma once
 // std
+#include <functional>
+#include <memory>
 #include <sstream>
+#include <string_view>
 
 // lib
 #include <types.h>
 #include <utils/string.h>
+#include "body_writer.h"
+#include "detail/ascii.h"
+#include "json_writer.h"
 #include "status.h"
 
 using json = nlohmann::json;
@@ -21,35 +27,86 @@ class response {
     friend response_debug_view;
 #endif
 
+  public:
+    using body_stream = std::function<bool(body_writer&)>;
+
   private:
     string version_ = "HTTP/1.1";
     status status_;
     string_map headers_;
     list<char> body_;
+    body_stream stream_;
+    // preserialized HTTP/1.1 form shared with a cache entry; the body is its tail
+    std::shared_ptr<const string> wire_;
+    size_t wire_head_size_ = 0;
+    // serialized form in memory that outlives every response, e.g. an embedded asset
+    std::string_view static_head_;
+    std::string_view static_body_;
 
     string content_type_;
 
     static string const get_status_text(int code) {
         switch (code) {
+        case 101:
+            return "Switching Protocols";
         case 200:
             return "OK";
         case 201:
             return "Created";
         case 204:
             return "No Content";
+        case 301:
+            return "Moved Permanently";
+        case 302:
+            return "Found";
+        case 304:
+            return "Not Modified";
+        case 307:
+            return "Temporary Redirect";
+        case 308:
+            return "Permanent Redirect";
         case 400:
             return "Bad Request";
+        case 401:
+            return "Unauthorized";
+        case 403:
+            return "Forbidden";
         case 404:
             return "Not Found";
+        case 405:
+            return "Method Not Allowed";
         case 409:
             return "Conflict";
+        case 413:
+            return "Content Too Large";
+        case 429:
+            return "Too Many Requests";
+        case 431:
+            return "Request Header Fields Too Large";
         case 500:
             return "Internal Server Error";
+        case 502:
+            return "Bad Gateway";
+        case 503:
+            return "Service Unavailable";
+        case 504:
+            return "Gateway Timeout";
         default:
             return "Unknown";
         }
     }
 
+    // the message that was set, e.g. relayed from an upstream, unless it could not stand in a
+    // status line
+    string reason_phrase() const {
+        if (status_.message.empty())
+            return get_status_text(status_.code);
+        for (unsigned char c : status_.message)
+            if ((c < 0x20 && c != '\t') || c == 0x7f)
+                return get_status_text(status_.code);
+        return status_.message;
+    }
+
     list<char>& body() { return body_; }
 
     string& content_type() { return content_type_; }
@@ -75,10 +132,48 @@ class response {
         }
     }
 
+    int get_status_code() const { return status_.code; }
+    const string& get_status_message() const { return status_.message; }
+
+    string get_header(const string& name) const {
+        auto it = headers_.find(name);
+        if (it != headers_.end())
+            return it->second;
+
+        // proxied and HTTP/2 responses carry lowercase names
+        for (const auto& [key, value] : headers_)
+            if (detail::iequals(key, name))
+                return value;
+        return "";
+    }
+
+    void remove_header(const string& name) {
+        for (auto it = headers_.begin(); it != headers_.end();) {
+            if (detail::iequals(it->first, name))
+                it = headers_.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    const string_map& get_headers() const { return headers_; }
+
+    // the Content-Type header, or the type implied by set_text/set_json/set_html
+    string get_content_type() const {
+        auto it = headers_.find("Content-Type");
+        return it != headers_.end() ? it->second : content_type_;
+    }
+
+    const list<char>& get_body_data() const { return body_; }
+
+    const body_stream& get_stream() const { return stream_; }
+
     string get_body() const { return string(body_.begin(), body_.end()); }
 
     void set_body(const list<char>& content) { body() = content; }
 
+    void set_body(list<char>&& content) { body() = std::move(content); }
+
     void set_body(const string& content) { body().assign(content.begin(), content.end()); }
 
     bool is_complete() const { return status_.code != 0; }
@@ -90,8 +185,19 @@ class response {
     }
 
     void set_json(const json& obj) {
-        string str    = obj.dump();
-        body()        = list<char>(str.begin(), str.end());
+        body().clear();
+        buffer_body_writer out(body());
+        json_writer(out).value(obj);
+        content_type_ = "application/json";
+    }
+
+    // Serialized while the body is sent, straight into the connection's buffer.
+    void set_json_stream(std::function<void(json_writer&)> fn) {
+        set_stream([fn = std::move(fn)](body_writer& out) {
+            json_writer writer(out);
+            fn(writer);
+            return writer.flush();
+        });
         content_type_ = "application/json";
     }
 
@@ -105,23 +211,89 @@ class response {
         content_type_ = "text/html; charset=utf-8";
     }
 
-    string to_string() const {
+    // Serves `wire` as is over HTTP/1.1; `head_size` bytes of it are the status line and headers.
+    // The headers map is kept as well so other protocols can re-frame the response.
+    void set_wire(std::shared_ptr<const string> wire, size_t head_size) {
+        body_.clear();
+        wire_           = std::move(wire);
+        wire_head_size_ = head_size;
+    }
+
+    const std::shared_ptr<const string>& get_wire() const { return wire_; }
+
+    // Like set_wire for memory that is never freed: the head and body go out in one gathered
+    // write without being copied or formatted. Headers are kept for other protocols here too.
+    void set_static(std::string_view head, std::string_view body) {
+        body_.clear();
+        wire_.reset();
+        static_head_ = head;
+        static_body_ = body;
+    }
+
+    bool is_static() const { return static_head_.data() != nullptr; }
+
+    std::string_view static_head() const { return static_head_; }
+
+    std::string_view body_view() const {
+        if (is_static())
+            return static_body_;
+        if (wire_)
+            return std::string_view(*wire_).substr(wire_head_size_);
+        return std::string_view(body_.data(), body_.size());
+    }
+
+    // The body is produced after the head is sent. Without a Content-Length header the body is
+    // sent chunked, so memory per response stays bounded by the writer's buffer.
+    void set_stream(body_stream stream) {
+        body_.clear();
+        stream_ = std::move(stream);
+    }
+
+    bool is_streaming() const { return static_cast<bool>(stream_); }
+
+    bool is_chunked() const { return is_streaming() && !headers_.count("Content-Length"); }
+
+    bool is_event_stream() const {
+        auto it = headers_.find("Content-Type");
+        return it != headers_.end() && it->second.rfind("text/event-stream", 0) == 0;
+    }
+
+    // status line and headers, terminated by the blank line
+    string head_string() const {
         std::ostringstream res;
-        res << version_ << " " << status_.code << " " << get_status_text(status_.code) << "\r\n";
+        res << version_ << " " << status_.code << " " << reason_phrase() << "\r\n";
         for (const auto& [key, value] : headers_) {
             res << key << ": " << value << "\r\n";
         }
 
+        // an upgrade response has no body and the connection stays open for the new protocol
+        if (status_.code == 101)
+            return res.str() + "\r\n";
+
         if (!headers_.count("Content-Type") && !content_type_.empty())
             res << "Content-Type: " << content_type_ << "\r\n";
-        if (!headers_.count("Content-Length"))
+        if (is_chunked())
+            res << "Transfer-Encoding: chunked\r\n";
+        // an event stream runs until the connection closes
+        else if (!headers_.count("Content-Length") && status_.code != 304 && !is_event_stream())
             res << "Content-Length: " << body_.size() << "\r\n";
 
-        res << "Connection: close\r\n\r\n" << get_body();
+        res << "Connection: close\r\n\r\n";
 
         return res.str();
     }
 
+    string to_string() const {
+        if (wire_)
+            return *wire_;
+        if (is_static())
+            return string(static_head_).append(static_body_);
+
+        string res = head_string();
+        res.append(body_.begin(), body_.end());
+        return res;
+    }
+
     static response not_found(const string& message = "") {
         response res;
         res.set_status(404, message.empty() ? get_status_text(404) : message);
@@ -154,6 +326,20 @@ class response {
         return res;
     }
 
+    // for large documents: nothing is serialized up front and memory stays bounded by the
+    // writer buffers; the response is sent chunked
+    static response json_stream(std::function<void(json_writer&)> fn) {
+        response res;
+        res.set_status_code(200);
+        res.set_json_stream(std::move(fn));
+        return res;
+    }
+
+    static response json_stream(::json obj) {
+        auto doc = std::make_shared<const ::json>(std::move(obj));
+        return json_stream([doc](json_writer& w) { w.value(*doc); });
+    }
+
     static response html(const string& html) {
         response res;
         res.set_status_code(200);
@@ -7,6 +7,7 @@
 #include <utils/net.h>
 #include "../method.h"
 #include "../http_types.h"
+#include "route_options.h"
 
 namespace net::http {
 
@@ -15,14 +16,17 @@ class route {
     struct _segment {
         string value;
         bool is_param;
+        bool is_wildcard;
 
-        _segment(string val) : value(std::move(val)), is_param(!value.empty() && value[0] == ':') {}
+        _segment(string val)
+            : value(std::move(val)), is_param(!value.empty() && value[0] == ':'),
+              is_wildcard(value == "*") {}
 
         bool is_match(const string& path_segment) const {
-            return is_param || value == path_segment;
+            return is_param || is_wildcard || value == path_segment;
         }
 
-        string param_name() const { return is_param ? value.substr(1) : ""; }
+        string param_name() const { return is_param ? value.substr(1) : is_wildcard ? "*" : ""; }
     };
 
     struct _pattern {
@@ -56,10 +60,14 @@ class route {
                 }
             }
 
-            if (input_segments.size() != segments.size())
+            // a trailing "*" matches the rest of the path (possibly nothing), e.g. "/api/*"
+            bool tail = !segments.empty() && segments.back().is_wildcard;
+            size_t fixed = tail ? segments.size() - 1 : segments.size();
+
+            if (tail ? input_segments.size() < fixed : input_segments.size() != segments.size())
                 return false;
 
-            for (size_t i = 0; i < segments.size(); ++i) {
+            for (size_t i = 0; i < fixed; ++i) {
                 const auto& seg   = segments[i];
                 const auto& input = input_segments[i];
 
@@ -70,12 +78,20 @@ class route {
                     out_params[seg.param_name()] = input;
             }
 
+            if (tail) {
+                string rest;
+                for (size_t i = fixed; i < input_segments.size(); ++i)
+                    rest.append(i == fixed ? "" : "/").append(input_segments[i]);
+                out_params["*"] = rest;
+            }
+
             return true;
         }
     } pattern;
 
     method method;
     route_handler handler;
+    route_options options;
 };
 
 using route_segment = route::_segment;
@@ -0,0 +1,23 @@
+#pragma once
+// std
+#include <memory>
+
+namespace net::http {
+
+class response_cache;
+class single_flight;
+
+// Order in which queued requests are served, and shed last to first under overload; see
+// admission/admission_control.h. Critical requests (health checks) are never shed.
+enum class priority_class { critical, high, normal, low };
+
+// Per-route behaviour beyond the handler itself; everything is off by default.
+struct route_options {
+    // serve repeat requests from this cache, see cache/response_cache.h
+    std::shared_ptr<response_cache> cache;
+    // identical concurrent requests share one handler run, see cache/single_flight.h
+    std::shared_ptr<single_flight> coalesce;
+    priority_class priority = priority_class::normal;
+};
+
+} // namespace net::http
@@ -1,34 +1,145 @@
 #pragma once
+#include <net/socket_registry.h>
 #include <utils/string.h>
+#include "../detail/ascii.h"
 #include "../request.h"
+#include "../cache/response_cache.h"
+#include "../cache/single_flight.h"
 #include "../response.h"
 #include "route.h"
 
 namespace net::http {
 
+// Takes over a connection after its upgrade response went out (WebSocket, h2c, event streams).
+using connection_starter = std::function<void(net::sock_ptr)>;
+
+// Fills in the 101 response and returns the starter, or returns an empty starter to decline,
+// in which case the request is routed as a plain HTTP request.
+using upgrade_handler = std::function<connection_starter(const request&, response&)>;
+
+// Runs on every routed response before it is sent, e.g. compression.
+using response_filter = std::function<void(const request&, response&)>;
+
+// Takes over a connection whose first bytes are not HTTP/1.x at all, e.g. an HTTP/2 preface.
+using preface_handler = std::function<connection_starter(const string& received)>;
+
 class router {
   public:
-    bool route_request(request& req, response& res) {
-        for (const auto& entry : routes) {
+    // `matched` receives the index of the route that served the request, see route_at
+    bool route_request(request& req, response& res, size_t* matched = nullptr) {
+        for (size_t i = 0; i < routes.size(); ++i) {
+            const route& entry = routes[i];
             if (!entry.method.equals(req.http_method))
                 continue;
             string_map params;
 
             if (entry.pattern.match(req.path, params)) {
                 req.params = std::move(params);
-                res        = entry.handler(req);
+                if (matched)
+                    *matched = i;
+
+                response_cache* cache = entry.options.cache.get();
+                string key            = cache ? cache->key(req) : string();
+                if (cache && cache->serve(key, req, res))
+                    return true;
+
+                auto produce = [&] {
+                    response out = entry.handler(req);
+                    for (const auto& filter : filters)
+                        filter(req, out);
+                    return out;
+                };
+                single_flight* flight = entry.options.coalesce.get();
+                res = flight ? flight->run(flight->key(req), produce) : produce();
+
+                if (cache)
+                    cache->store(key, req, res);
                 return true;
             }
         }
         return false;
     }
 
-    void register_route(method method, const std::string& path, route_handler handler) {
-        routes.push_back({route_pattern::from_string(path), method, handler});
+    void register_route(method method, const std::string& path, route_handler handler,
+                        route_options options = {}) {
+        routes.push_back({route_pattern::from_string(path), method, handler, std::move(options)});
+    }
+
+    // priority of the route `method path` would be served by, without running it
+    priority_class priority_of(const string& method, const string& path) const {
+        string_map params;
+        for (const auto& entry : routes)
+            if (entry.method.str() == method && entry.pattern.match(path, params))
+                return entry.options.priority;
+        return priority_class::normal;
+    }
+
+    bool has_priorities() const {
+        for (const auto& entry : routes)
+            if (entry.options.priority != priority_class::normal)
+                return true;
+        return false;
+    }
+
+    const route* route_at(size_t index) const { return index < routes.size() ? &routes[index] : nullptr; }
+
+    connection_starter route_upgrade(request& req, response& res) {
+        bool upgrading = detail::has_token(req.get_header("Connection"), "upgrade");
+        if (upgrades.empty() || (!upgrading && takeovers_ == 0))
+            return nullptr;
+
+        string offered = upgrading ? req.get_header("Upgrade") : string();
+        for (const auto& entry : upgrades) {
+            // takeovers have no protocol and match without an Upgrade header
+            if (!entry.protocol.empty() && !detail::has_token(offered, entry.protocol))
+                continue;
+            string_map params;
+
+            if (entry.pattern.match(req.path, params)) {
+                req.params = std::move(params);
+                if (connection_starter starter = entry.handler(req, res))
+                    return starter;
+            }
+        }
+        return nullptr;
+    }
+
+    void add_filter(response_filter filter) { filters.push_back(std::move(filter)); }
+
+    connection_starter route_preface(const string& received) {
+        for (const auto& [prefix, handler] : prefaces)
+            if (received.compare(0, prefix.size(), prefix) == 0)
+                return handler(received);
+        return nullptr;
+    }
+
+    void register_preface(const string& prefix, preface_handler handler) {
+        prefaces.emplace_back(prefix, std::move(handler));
+    }
+
+    void register_upgrade(const string& protocol, const std::string& path, upgrade_handler handler) {
+        upgrades.push_back({route_pattern::from_string(path), protocol, std::move(handler)});
+    }
+
+    // Like an upgrade, but for plain requests: the response head is sent and the starter gets
+    // the connection, e.g. for Server-Sent Events.
+    void register_takeover(const std::string& path, upgrade_handler handler) {
+        upgrades.push_back({route_pattern::from_string(path), string(), std::move(handler)});
+        ++takeovers_;
     }
 
   private:
+    struct upgrade_route {
+        route_pattern pattern;
+        string protocol;
+        upgrade_handler handler;
+    };
+
     list<route> routes;
+    list<upgrade_route> upgrades;
+    size_t takeovers_ = 0;
+    list<response_filter> filters;
+    list<std::pair<string, preface_handler>> prefaces;
     route_map get_routes;
     route_map post_routes;
 };
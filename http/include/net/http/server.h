@@ -1,26 +1,74 @@
 #pragma once
 // std
 #include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <functional>
 #include <mutex>
+#include <optional>
 #include <stdexcept>
 #include <thread>
 #include <unordered_map>
 #include <unordered_set>
 
 // lib
+#include <net/event_loop.h>
+#include <net/fd_passing.h>
+#include <net/socket_options.h>
+#include <net/tls.h>
 #include <threading/thread_pool.h>
+#include "compression/compression.h"
 #include "connection_handler.h"
+#include "admission/admission_control.h"
+#include "admission/rate_limiter.h"
+#include "assets/embedded_asset.h"
+#include "http2/connection.h"
+#include "metrics/metrics.h"
+#include "metrics/tracing.h"
+#include "proxy/proxy_handler.h"
+#include "sse/event_stream.h"
+#include "websocket/session.h"
 
 namespace net::http {
 
+struct request_limits {
+    // request line and headers; larger heads are answered 431
+    size_t max_head_bytes = 64 * 1024;
+    // announced by Content-Length; larger bodies are answered 413 before they are read
+    size_t max_body_bytes = 64 * 1024 * 1024;
+};
+
 struct connection_state {
     net::sock_ptr socket;
     string buffer;
+    std::chrono::steady_clock::time_point accepted_at = std::chrono::steady_clock::now();
+    // set when read_more failed because the connection timed out
+    bool timed_out = false;
+    // the current request went past the rate limiter
+    bool admitted = false;
+    request_limits limits;
+#ifdef NET_HAS_OPENSSL
+    // until the TLS handshake is done
+    std::unique_ptr<net::tls_session> tls;
+#endif
 
     bool read_more() {
-        char temp[8192];
+#ifdef NET_HAS_OPENSSL
+        if (tls) {
+            net::tls_session::state st = tls->handshake(*socket);
+            if (st == net::tls_session::state::pending)
+                return true;
+            tls.reset();
+            if (st == net::tls_session::state::failed)
+                return false;
+        }
+#endif
         while (true) {
             int result = socket->read(buffer);
+            // oversized() has seen enough to answer; the rest is never buffered
+            if (result > 0 && buffer.size() > limits.max_head_bytes + limits.max_body_bytes)
+                return true;
             if (result > 0)
                 continue;
             else if (result == 0) {
@@ -30,22 +78,63 @@ struct connection_state {
                 int wb  = WSAEWOULDBLOCK;
                 if (err == WSAEWOULDBLOCK)
                     return true;
+                timed_out = err == WSAETIMEDOUT;
                 return false;
             }
         }
     }
 
-    bool is_request_complete() const { return buffer.find("\r\n\r\n") != string::npos; }
+    // the head is in and so is the body it announces with Content-Length
+    bool is_request_complete() {
+        if (expected_ == 0) {
+            size_t head_end = buffer.find("\r\n\r\n");
+            if (head_end == string::npos)
+                return false;
+            head_size_ = head_end + 2;
+            expected_  = head_end + 4 + content_length(head());
+        }
+        return buffer.size() >= expected_;
+    }
+
+    // 431 or 413 when the request being read is over the limits, after is_request_complete
+    int oversized() const {
+        if (expected_ == 0)
+            return buffer.size() > limits.max_head_bytes ? 431 : 0;
+        if (head_size_ > limits.max_head_bytes)
+            return 431;
+        return expected_ - head_size_ - 2 > limits.max_body_bytes ? 413 : 0;
+    }
+
+    // header lines of the request being read; empty until is_request_complete saw them all
+    std::string_view head() const { return std::string_view(buffer).substr(0, head_size_); }
 
     string take_request() {
         string req = std::move(buffer);
         buffer.clear();
+        expected_  = 0;
+        head_size_ = 0;
+        admitted   = false;
         return req;
     }
+
+  private:
+    // head plus body bytes of the request being read, once its head is complete
+    size_t expected_  = 0;
+    size_t head_size_ = 0;
+
+    static size_t content_length(std::string_view head) {
+        std::string_view value = detail::header_value(head, "Content-Length");
+        size_t length          = 0;
+        // too large to represent is too large to accept; oversized() answers 413
+        if (std::from_chars(value.data(), value.data() + value.size(), length).ec == std::errc::result_out_of_range)
+            return SIZE_MAX / 2;
+        return length;
+    }
 };
 
 class server {
     friend connection_handler;
+    friend class simulation;
     inline static constexpr const char* _default_ip = "0.0.0.0";
     inline static constexpr int _default_port       = 8080;
 
@@ -58,9 +147,36 @@ class server {
         _server_socket = sock_registry.create_socket(ip, port);
     }
 
-    ~server() { stop(); }
+    // unix-domain (or any pre-resolved) listening address, e.g. for a same-host proxy
+    server(const net::ip_endpoint& ep) : ip_(ep.ip_address()), port_(ep.port()), router_() {
+        _server_socket = sock_registry.create_socket(ep);
+    }
+
+    // serves on a socket that is already listening: see net::take_listener and net::listen_fds
+    explicit server(net::socket&& listening)
+        : ip_(listening.endpoint().ip_address()), port_(listening.endpoint().port()), router_() {
+        inherited_     = true;
+        _server_socket = sock_registry.create_socket(std::move(listening));
+    }
+
+    ~server() {
+        stop();
+        accept_wakeup_.close();
+    }
+
+    void start() {
+        if (inherited_ || _server_socket->endpoint().is_unix()) {
+            if (!_server_socket->listen()) {
+                std::cerr << "Failed to listen on socket " << net::get_socket_error() << std::endl;
+                exit(1);
+            }
 
-    void start() { start(ip_, port_); }
+            run();
+            return;
+        }
+
+        start(ip_, port_);
+    }
 
     void start(int port) { start(ip_, port); }
 
@@ -74,15 +190,30 @@ class server {
     }
 
     void stop() {
-        running_ = false;
+        {
+            std::lock_guard lock(shutdown_mutex_);
+            running_ = false;
+        }
+        shutdown_cv_.notify_all();
+
         if (_server_socket->is_valid()) {
-            _server_socket->close();
-            std::cout << "Server socket closed";
+            // a successor process still listens on it
+            if (handed_off_)
+                _server_socket->detach();
+            else
+                _server_socket->close();
+            if (verbose_)
+                std::cout << "Server socket closed" << std::endl;
         }
 
         if (accept_thread_.joinable()) {
             accept_thread_.join();
         }
+
+        loop_.stop();
+        if (loop_thread_.joinable()) {
+            loop_thread_.join();
+        }
     }
 
     void wait() {
@@ -90,23 +221,264 @@ class server {
         shutdown_cv_.wait(lock, [this] { return !running_.load(); });
     }
 
-    server& get(const string path, route_handler handler) {
-        router_.register_route(method::Get, path, handler);
+    // Graceful shutdown: stops accepting, lets requests already read or queued finish and open
+    // connections send theirs until `deadline`, then stops. Upgraded connections are ended the
+    // way their protocol expects: WebSocket close 1001, HTTP/2 GOAWAY once the open streams are
+    // done, event streams once their queue is sent. False when connections were still open at
+    // the deadline.
+    bool drain(std::chrono::milliseconds deadline) {
+        draining_ = true;
+        loop_.post([this] {
+            // ending one may close it on the spot, which takes it out of upgraded_
+            list<std::function<void()>> ends;
+            for (const auto& [id, end] : upgraded_)
+                ends.push_back(end);
+            for (const auto& end : ends)
+                end();
+        });
+
+        auto until = std::chrono::steady_clock::now() + deadline;
+        while ((connections_.load() > 0 || (admission_ && admission_->size() > 0)) &&
+               std::chrono::steady_clock::now() < until)
+            std::this_thread::sleep_for(std::chrono::milliseconds(accept_pause_poll_ms_));
+
+        bool drained = connections_.load() == 0;
+        stop();
+        return drained;
+    }
+
+#ifndef _WIN32
+    // Hot restart, old side: waits on a unix socket at `path` for the new process, passes it
+    // the listening socket (SCM_RIGHTS) and drains. Blocks until the successor connects; the
+    // new process calls net::take_listener(path) and starts a server on the result.
+    bool hand_off(const string& path, std::chrono::milliseconds deadline) {
+        net::socket channel(net::ip_endpoint::unix_path(path));
+        if (!channel.listen())
+            return false;
+
+        net::socket successor = channel.accept();
+        while (!successor.is_valid() && WSAGetLastError() == EINTR)
+            successor = channel.accept();
+
+        bool sent = successor.is_valid() && net::send_fds(successor, {static_cast<int>(*_server_socket)});
+        successor.close();
+        channel.close();
+        if (!sent)
+            return false;
+
+        handed_off_ = true;
+        drain(deadline);
+        return true;
+    }
+#endif
+
+    server& get(const string path, route_handler handler, route_options options = {}) {
+        router_.register_route(method::Get, path, handler, std::move(options));
         return *this;
     }
 
-    server& post(const string path, route_handler handler) {
-        router_.register_route(method::Post, path, handler);
+    server& post(const string path, route_handler handler, route_options options = {}) {
+        router_.register_route(method::Post, path, handler, std::move(options));
         return *this;
     }
 
-    server& put(const string path, route_handler handler) {
-        router_.register_route(method::Put, path, handler);
+    server& put(const string path, route_handler handler, route_options options = {}) {
+        router_.register_route(method::Put, path, handler, std::move(options));
         return *this;
     }
 
-    server& del(const string path, route_handler handler) {
-        router_.register_route(method::Delete, path, handler);
+    server& del(const string path, route_handler handler, route_options options = {}) {
+        router_.register_route(method::Delete, path, handler, std::move(options));
+        return *this;
+    }
+
+    // forwards every method on `path` (typically ending in "/*") to the upstream pool
+    server& proxy(const string path, const proxy_handler& handler) {
+        for (const method& m : {method::Get, method::Post, method::Put, method::Delete})
+            router_.register_route(m, path, handler);
+        return *this;
+    }
+
+    // Files embedded with net_embed_assets, served under `mount`; an index.html also answers
+    // for its directory
+    template <size_t N>
+    server& assets(const embedded_asset (&files)[N], const string& mount = "") {
+        for (const embedded_asset& file : files) {
+            auto serve = [&file](const request& req) { return file.serve(req); };
+            string path = mount + string(file.path);
+            router_.register_route(method::Get, path, serve);
+
+            constexpr std::string_view index = "index.html";
+            if (file.path.size() >= index.size() && file.path.substr(file.path.size() - index.size()) == index)
+                router_.register_route(method::Get, path.substr(0, path.size() - index.size()), serve);
+        }
+        return *this;
+    }
+
+    // Accept-Encoding negotiation for every routed response (HTTP/1.1 and HTTP/2)
+    server& compress(compression::options opts = {}) {
+        router_.add_filter(compression::filter(std::move(opts)));
+        return *this;
+    }
+
+    // WebSocket endpoint; upgraded connections are served from the server's event loop
+    server& ws(const string path, websocket::handler handler) {
+        auto shared = std::make_shared<const websocket::handler>(std::move(handler));
+
+        router_.register_upgrade("websocket", path, [this, shared](const request& req, response& res) {
+            string key = req.get_header("Sec-WebSocket-Key");
+            if (req.http_method.str() != "GET" || key.empty() ||
+                req.get_header("Sec-WebSocket-Version") != "13")
+                return connection_starter();
+
+            res.set_status_code(101);
+            res.set_header("Upgrade", "websocket");
+            res.set_header("Connection", "Upgrade");
+            res.set_header("Sec-WebSocket-Accept", websocket::accept_key(key));
+
+            return connection_starter([this, shared, req](net::sock_ptr sock) {
+                auto session = std::make_shared<websocket::session>(loop_, std::move(sock), shared, req);
+                adopt(*session, [weak = std::weak_ptr(session)] {
+                    if (auto s = weak.lock())
+                        s->close(websocket::going_away);
+                });
+                session->start();
+            });
+        });
+        return *this;
+    }
+
+    // Server-Sent Events: a GET on `path` is answered with text/event-stream and the connection
+    // moves to the server's event loop, where handler.broker feeds it; no pool thread is held.
+    // Not supported over user-space TLS, see tls().
+    server& events(const string path, sse::handler handler) {
+        auto shared = std::make_shared<const sse::handler>(std::move(handler));
+
+        router_.register_takeover(path, [this, shared](const request& req, response& res) {
+            if (req.http_method.str() != "GET" || !shared->broker)
+                return connection_starter();
+
+            list<string> topics = shared->topics ? shared->topics(req) : list<string>{req.path};
+            if (topics.empty())
+                return connection_starter();
+
+            res.set_status_code(200);
+            res.set_header("Content-Type", "text/event-stream");
+            res.set_header("Cache-Control", "no-cache");
+            // keeps nginx from buffering the stream
+            res.set_header("X-Accel-Buffering", "no");
+
+            return connection_starter([this, shared, req, topics](net::sock_ptr sock) {
+                auto sub = std::make_shared<sse::subscriber>(loop_, std::move(sock), shared, topics);
+                adopt(*sub, [weak = std::weak_ptr(sub)] {
+                    if (auto s = weak.lock())
+                        s->end();
+                });
+                sub->start(req);
+            });
+        });
+        return *this;
+    }
+
+    // Cleartext HTTP/2 next to HTTP/1.1: prior-knowledge connections (RFC 7540 section 3.4) and
+    // "Upgrade: h2c" requests. Streams are dispatched to the same routes on the thread pool.
+    server& enable_http2(http2::options opts = {}) {
+        http2::executor exec = [this](std::function<void()> fn) { pool_.enqueue(std::move(fn)); };
+
+        // the accept loop sees "PRI * HTTP/2.0\r\n\r\n" as a complete request head
+        string preface(http2::client_preface.substr(0, http2::client_preface.find("SM")));
+        router_.register_preface(preface, [this, opts, exec](const string& received) {
+            return connection_starter([this, opts, exec, received](net::sock_ptr sock) {
+                auto conn = std::make_shared<http2::connection>(loop_, std::move(sock), router_, exec, opts);
+                adopt(*conn, go_away(conn));
+                conn->start(received);
+            });
+        });
+
+        router_.register_upgrade("h2c", "/*", [this, opts, exec](const request& req, response& res) {
+            string length = req.get_header("Content-Length");
+            string encoded = req.get_header("HTTP2-Settings");
+            string payload;
+            http2::settings peer;
+            http2::error_code err;
+
+            // requests with a body stay on HTTP/1.1 rather than buffering it for stream 1
+            if ((!length.empty() && length != "0") || !req.get_header("Transfer-Encoding").empty() ||
+                !detail::has_token(req.get_header("Connection"), "HTTP2-Settings") ||
+                !detail::base64_decode(encoded, payload) || !peer.apply(payload, err))
+                return connection_starter();
+
+            res.set_status_code(101);
+            res.set_header("Connection", "Upgrade");
+            res.set_header("Upgrade", "h2c");
+
+            return connection_starter([this, opts, exec, req, peer](net::sock_ptr sock) {
+                auto conn = std::make_shared<http2::connection>(loop_, std::move(sock), router_, exec, opts);
+                adopt(*conn, go_away(conn));
+                conn->start_upgraded(req, peer);
+            });
+        });
+        return *this;
+    }
+
+    // Prometheus scrape endpoint for the counters and timings in stats()
+    server& expose_metrics(const string& path = "/metrics") {
+        router_.register_route(method::Get, path, [this](const request&) {
+            response res;
+            res.set_status_code(200);
+            res.set_header("Content-Type", "text/plain; version=0.0.4; charset=utf-8");
+            res.set_body(metrics_.prometheus(router_, net::listen_stats::read(*_server_socket)));
+            return res;
+        });
+        return *this;
+    }
+
+    const metrics& stats() const { return metrics_; }
+
+    // one line per request, written off the request threads; see logging/access_log.h
+    server& log_access(access_log_options opts = {}) {
+        access_log_ = std::make_unique<access_log>(std::move(opts));
+        return *this;
+    }
+
+    // null unless log_access() was called
+    access_log* access_logger() { return access_log_.get(); }
+
+    // Connection cap, bounded queue and CoDel shedding in front of the thread pool; rejected
+    // requests get a 503 with Retry-After. Route priorities come from route_options.
+    server& admission(admission_options opts = {}) {
+        admission_ = std::make_unique<admission_control>(opts);
+        return *this;
+    }
+
+    // Per-client request rate limit, checked on the accept thread as soon as a request head is
+    // in; clients over the limit get a 429 with Retry-After. Call before start().
+    server& rate_limit(rate_limit_options opts = {}) {
+        limiter_ = std::make_unique<rate_limiter>(std::move(opts));
+        return *this;
+    }
+
+    // Samples requests and times each step of serving them; call before start()
+    server& trace(tracing_options opts = {}) {
+        tracer_ = std::make_unique<tracer>(opts);
+        return *this;
+    }
+
+    // null unless trace() was called
+    tracer* traces() { return tracer_.get(); }
+
+    // Chrome trace-event JSON of the sampled requests, or per-phase percentiles with ?summary
+    server& expose_traces(const string& path = "/debug/traces") {
+        router_.register_route(method::Get, path, [this](const request& req) {
+            if (!tracer_)
+                return response::not_found();
+
+            response res;
+            res.set_status_code(200);
+            res.set_header("Content-Type", "application/json");
+            res.set_body(req.query().has("summary") ? tracer_->summary_json() : tracer_->chrome_json());
+            return res;
+        });
         return *this;
     }
 
@@ -116,9 +488,47 @@ class server {
         return *this;
     }
 
+    // Largest request head and body a connection may send. Call before start().
+    server& limits(request_limits opts) {
+        limits_ = opts;
+        return *this;
+    }
+
+    // Kernel options for the listening socket and every accepted connection, e.g.
+    // net::socket_options::latency() or throughput(). Call before start().
+    server& socket_profile(net::socket_options opts) {
+        sock_opts_ = opts;
+        return *this;
+    }
+
+#ifdef NET_HAS_OPENSSL
+    // HTTPS on this server's listener. The handshake runs on the accept loop without blocking it;
+    // with opts.ktls the session keys then go to the kernel where it supports that, and the
+    // connection is served like a plain one. Otherwise records go through OpenSSL. WebSocket
+    // and h2c upgrades and Server-Sent Events are only served over kTLS, as the event loop reads
+    // and writes the socket directly: over user-space TLS an event stream gets its response head
+    // and is then closed. The listener is switched to non-blocking mode. Call before start().
+    server& tls(net::tls_options opts) {
+        tls_ = std::make_unique<net::tls_context>(std::move(opts));
+        return *this;
+    }
+
+    const net::tls_context* tls() const { return tls_.get(); }
+#endif
+
+    // start and stop messages on stdout
+    server& set_verbose(bool verbose) {
+        verbose_ = verbose;
+        return *this;
+    }
+
   private:
     net::sock_ptr _server_socket;
-    std::atomic<bool> running_;
+    std::atomic<bool> running_{false};
+    // the listening socket came from another process; it is bound and listening already
+    bool inherited_ = false;
+    std::atomic<bool> draining_{false};
+    std::atomic<bool> handed_off_{false};
     std::thread accept_thread_;
     string ip_;
     int port_;
@@ -126,13 +536,42 @@ class server {
 
     threading::thread_pool pool_;
 
+    // upgraded connections (WebSocket, HTTP/2) and event streams live here, off the select loop
+    net::event_loop loop_;
+    std::thread loop_thread_;
+
     std::unordered_map<SOCKET, connection_state> conn_state;
     std::mutex conn_state_mutex;
 
     net::socket_registry sock_registry;
     std::mutex fd_mutex_;
 
-    std::atomic<bool> verbose_;
+    metrics metrics_;
+    std::unique_ptr<access_log> access_log_;
+    std::unique_ptr<tracer> tracer_;
+
+    std::unique_ptr<admission_control> admission_;
+    std::unique_ptr<rate_limiter> limiter_;
+    // set at start when some route has a priority other than normal
+    bool prioritized_ = false;
+    std::atomic<size_t> connections_{0};
+    // loop thread: how drain() ends each upgraded connection still open, see adopt()
+    std::unordered_map<uint64_t, std::function<void()>> upgraded_;
+    uint64_t upgraded_ids_ = 0;
+    // how often a paused accept loop looks at the connection count again
+    static constexpr long accept_pause_poll_ms_ = 10;
+    // connections taken from the accept queue per wakeup
+    static constexpr size_t accept_budget_ = 64;
+
+    net::socket_options sock_opts_;
+    request_limits limits_;
+    // interrupts the accept loop's select, like event_loop's wakeup socket
+    net::socket accept_wakeup_{net::ip_endpoint("127.0.0.1", 0), net::protocol::UDP};
+#ifdef NET_HAS_OPENSSL
+    std::unique_ptr<net::tls_context> tls_;
+#endif
+
+    std::atomic<bool> verbose_{false};
     std::mutex shutdown_mutex_;
     std::condition_variable shutdown_cv_;
 
@@ -142,23 +581,39 @@ class server {
             sock_registry.drain_closed();
             net::socket_set read_set = sock_registry.snapshot();
 
-            if (!read_set.select())
+            // timestamps are only taken with tracing on
+            tracer* tr = tracer_.get();
+            request_trace::clock::time_point select_begin, select_end;
+            if (tr)
+                select_begin = request_trace::clock::now();
+
+            // at the connection cap the listening socket sits out until a connection closes, and
+            // for good once draining
+            size_t cap  = admission_ ? admission_->options().max_connections : 0;
+            bool paused = (cap && connections_.load() >= cap) || draining_.load();
+            if (paused) {
+                read_set.remove(*_server_socket);
+                if (read_set.size() == 0) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(accept_pause_poll_ms_));
+                    continue;
+                }
+            }
+
+            read_set.add(accept_wakeup_);
+            int ready = paused ? read_set.select(accept_pause_poll_ms_) : read_set.select();
+            if (ready == 0 && !paused)
                 break;
 
+            if (tr)
+                select_end = request_trace::clock::now();
+
             for (size_t i = 0; i < read_set.size(); ++i) {
                 SOCKET s = read_set.get(i);
 
-                if (s == *_server_socket) {
-                    net::sock_ptr client = sock_registry.create_socket(_server_socket->accept());
-                    if (client && client->is_valid()) {
-                        if (non_blocking()) {
-                            client->non_blocking = true;
-                            u_long mode          = 1;
-                            ioctlsocket(*client, FIONBIO, &mode);
-                        }
-
-                        sock_registry.add(std::move(client));
-                    }
+                if (s == accept_wakeup_) {
+                    drain_wakeup();
+                } else if (s == *_server_socket) {
+                    accept_pending(cap);
                 } else {
                     if (sock_registry.is_in_progress(s))
                         continue;
@@ -169,21 +624,96 @@ class server {
                     if (client && client->is_valid()) {
                         auto& state  = conn_state[s];
                         state.socket = client;
+
+                        request_trace::clock::time_point read_begin;
+                        if (tr)
+                            read_begin = request_trace::clock::now();
+
                         if (!state.read_more()) {
+                            if (state.timed_out)
+                                metrics_.add(metrics::counter::timeouts);
+                            connection_closed();
+                            cleanup(s);
                             continue;
                         }
 
-                        if (state.is_request_complete()) {
-                            string request_data = state.take_request();
+                        bool complete = state.is_request_complete();
+                        if (int status = state.oversized()) {
+                            state.take_request();
+                            reject_too_large(s, client, status);
+                            continue;
+                        }
+                        if (limiter_ && !state.admitted && !state.head().empty()) {
+                            // before the body is read or anything is queued
+                            auto wait = limiter_->acquire(limiter_->key(client->endpoint(), state.head()));
+                            if (wait.count() > 0) {
+                                state.take_request();
+                                reject_limited(s, client, wait);
+                                continue;
+                            }
+                            state.admitted = true;
+                        }
 
-                            pool_.enqueue(
-                                [this, s, client, data = std::move(request_data)]() mutable {
+                        if (complete) {
+                            string request_data = state.take_request();
+                            metrics_.add(metrics::counter::bytes_in, request_data.size());
+
+                            std::optional<request_trace> trace;
+                            if (tr && tr->sample()) {
+                                trace.emplace();
+                                trace->marks[request_trace::select_begin] = select_begin;
+                                trace->marks[request_trace::select_end]   = select_end;
+                                trace->marks[request_trace::read_begin]   = read_begin;
+                                trace->stamp(request_trace::read_end);
+                            }
+
+                            priority_class priority = priority_class::normal;
+                            string m, path;
+                            if (prioritized_ && admission_control::request_line(request_data, m, path))
+                                priority = router_.priority_of(m, path);
+
+                            auto job =
+                                [this, s, client, accepted_at = state.accepted_at, trace = std::move(trace),
+                                 data = std::move(request_data)]() mutable {
                                     connection_handler handler(client, router_);
-                                    handler.handle(data);
-
+                                    handler.set_metrics(&metrics_, accepted_at);
+                                    handler.set_access_log(access_log_.get());
+                                    handler.set_cork(sock_opts_.cork);
+                                    if (trace) {
+                                        trace->stamp(request_trace::dequeued);
+                                        handler.set_trace(&*trace);
+                                    }
+
+                                    handler.handle(std::make_shared<const string>(std::move(data)));
+                                    if (trace && !handler.upgraded_)
+                                        tracer_->submit(std::move(*trace));
+
+                                    // an upgraded connection stays open until its session ends,
+                                    // see adopt()
+                                    connection_starter starter = handler.take_upgrade();
+                                    if (starter && !client->has_transport()) {
+                                        sock_registry.release(s, [this, starter](net::sock_ptr sock) {
+                                            loop_.post([starter, sock] { starter(sock); });
+                                        });
+                                        // an event stream client sends nothing that would
+                                        // wake the loop to hand its connection over
+                                        wake_accept_loop();
+                                        return;
+                                    }
+
+                                    connection_closed();
                                     sock_registry.mark_closed(s);
-                                    sock_registry.remove_in_progress(s);
-                                });
+                                };
+
+                            if (!admission_)
+                                pool_.enqueue(std::move(job));
+                            else if (admission_->push(priority, std::move(job), [this, s, client] { reject(s, client); }))
+                                pool_.enqueue([this] { admission_->run_next(); });
+                            else
+                                reject(s, client);
+                        } else {
+                            // wait for the rest of the head or body
+                            sock_registry.remove_in_progress(s);
                         }
                     }
                 }
@@ -195,16 +725,142 @@ class server {
         if (running_)
             return;
 
-        running_ = true;
-        std::cout << "Server running on host: " << _server_socket->host() << std::endl;
+        running_     = true;
+        prioritized_ = admission_ && router_.has_priorities();
+        sock_opts_.apply_listener(*_server_socket);
+#ifdef NET_HAS_OPENSSL
+        // a blocking listener would stall the accept loop in every handshake
+        if (tls_ && !non_blocking()) {
+            non_blocking() = true;
+            u_long nb      = 1;
+            ioctlsocket(*_server_socket, FIONBIO, &nb);
+        }
+#endif
+
+        accept_wakeup_.bind();
+        accept_wakeup_.connect(accept_wakeup_.local_endpoint());
+        u_long mode = 1;
+        ioctlsocket(accept_wakeup_, FIONBIO, &mode);
+
+        if (verbose_)
+            std::cout << "Server running on host: " << _server_socket->host() << std::endl;
+        loop_thread_   = std::thread([this] { loop_.run(); });
         accept_thread_ = std::thread(&server::accept_connections_alt, this);
     }
 
+    // Empties the accept queue, up to accept_budget_ connections so a burst cannot keep the
+    // loop from reading open ones; the batch joins the select set in one step. A blocking
+    // listener gets one accept per wakeup.
+    void accept_pending(size_t cap) {
+        list<net::socket> batch;
+        size_t budget = non_blocking() ? accept_budget_ : 1;
+        while (batch.size() < budget && !(cap && connections_.load() >= cap)) {
+            net::socket accepted = _server_socket->accept(non_blocking());
+            if (!accepted.is_valid()) {
+                if (WSAGetLastError() != WSAEWOULDBLOCK)
+                    metrics_.add(metrics::counter::accept_errors);
+                break;
+            }
+
+            metrics_.add(metrics::counter::accepted);
+            ++connections_;
+            connection_state& state = conn_state[net::socket::to_socket(accepted)];
+            state                   = connection_state();
+            state.limits            = limits_;
+#ifdef NET_HAS_OPENSSL
+            if (tls_)
+                state.tls = std::make_unique<net::tls_session>(*tls_, net::socket::to_socket(accepted));
+#endif
+            sock_opts_.apply_connection(accepted);
+            batch.push_back(std::move(accepted));
+        }
+
+        if (!batch.empty())
+            sock_registry.add_all(std::move(batch));
+    }
+
+    void wake_accept_loop() {
+        char b = 1;
+        ::send(accept_wakeup_, &b, 1, 0);
+    }
+
+    void drain_wakeup() {
+        char buffer[64];
+        while (::recv(accept_wakeup_, buffer, sizeof(buffer), 0) > 0) {
+        }
+    }
+
+    void connection_closed() {
+        metrics_.add(metrics::counter::closed);
+        --connections_;
+    }
+
+    // loop thread: an upgraded connection counts as open until its session shuts down; `end`
+    // is how drain() asks it to close
+    template <class upgraded_connection>
+    void adopt(upgraded_connection& conn, std::function<void()> end) {
+        uint64_t id = ++upgraded_ids_;
+        upgraded_.emplace(id, end);
+        conn.on_shutdown([this, id] {
+            upgraded_.erase(id);
+            connection_closed();
+        });
+        // upgraded after drain() already went through upgraded_
+        if (draining_)
+            loop_.post(std::move(end));
+    }
+
+    static std::function<void()> go_away(const std::shared_ptr<http2::connection>& conn) {
+        return [weak = std::weak_ptr(conn)] {
+            if (auto c = weak.lock())
+                c->go_away();
+        };
+    }
+
+    // a rejected client that does not read its answer times out like any other
+    void answer(const net::sock_ptr& client, std::string_view wire) {
+        if (!client->write_all(wire.data(), wire.size()) && WSAGetLastError() == WSAETIMEDOUT)
+            metrics_.add(metrics::counter::timeouts);
+    }
+
+    // answers 503 without running a handler, from the accept loop or a pool thread
+    void reject(SOCKET s, const net::sock_ptr& client) {
+        answer(client, admission_->overloaded().to_string());
+        metrics_.add(metrics::counter::shed);
+        connection_closed();
+        sock_registry.mark_closed(s);
+    }
+
+    // 429 built on the stack: a client being throttled costs no allocation
+    void reject_limited(SOCKET s, const net::sock_ptr& client, std::chrono::nanoseconds wait) {
+        long long seconds = std::chrono::ceil<std::chrono::seconds>(wait).count();
+        char wire[160];
+        int len = std::snprintf(wire, sizeof wire,
+                                "HTTP/1.1 429 Too Many Requests\r\nRetry-After: %lld\r\n"
+                                "Content-Length: 0\r\nConnection: close\r\n\r\n",
+                                seconds);
+        answer(client, std::string_view(wire, static_cast<size_t>(len)));
+        metrics_.add(metrics::counter::rate_limited);
+        connection_closed();
+        sock_registry.mark_closed(s);
+    }
+
+    // 431 or 413, then the connection is closed with the rest of the request unread
+    void reject_too_large(SOCKET s, const net::sock_ptr& client, int status) {
+        const char* wire = status == 431 ? "HTTP/1.1 431 Request Header Fields Too Large\r\n"
+                                           "Content-Length: 0\r\nConnection: close\r\n\r\n"
+                                         : "HTTP/1.1 413 Content Too Large\r\n"
+                                           "Content-Length: 0\r\nConnection: close\r\n\r\n";
+        answer(client, wire);
+        metrics_.add(metrics::counter::too_large);
+        connection_closed();
+        sock_registry.mark_closed(s);
+    }
+
     void cleanup(SOCKET s) {
         sock_registry.mark_closed(s);
         std::lock_guard lock(conn_state_mutex);
         conn_state.erase(s);
-        sock_registry.remove_in_progress(s);
     }
 };
 
@@ -0,0 +1,292 @@
+#pragma once
+// std
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+
+// lib
+#include <net/transport.h>
+#include <types.h>
+#include "../server.h"
+
+namespace net::http {
+
+// Runs a server's request pipeline (buffering, parsing, routing, filters, serialization,
+// metrics and access log) over in-memory connections on the calling thread. Nothing is
+// accepted, selected on or queued: step() serves connections in the order they were opened,
+// so a script of client writes always produces the same interleaving, with no kernel or
+// scheduler noise in the numbers. The server does not need to be started. Rate limiting,
+// admission control and protocol upgrades belong to the accept loop and are not simulated.
+//
+// With a capacity, a client that does not read pushes back on the server: a response write
+// with no room blocks until a later step() finds room, or until the socket's write timeout
+// has passed on the simulation's clock, which only moves with advance(). Such a response is
+// written on a thread of its own that takes turns with the caller, so the two never run at
+// once and a script still plays out the same way every time.
+class simulation {
+  public:
+    // `capacity` bounds each direction of every connection, see net::memory_pipe
+    explicit simulation(server& srv, size_t capacity = 0) : srv_(srv), capacity_(capacity) {}
+
+    ~simulation() {
+        // responses still waiting for room fail their writes and end
+        for (auto& [id, c] : served_)
+            while (c.writer && !c.writer->done())
+                c.writer->resume(false);
+    }
+
+    simulation(const simulation&)            = delete;
+    simulation& operator=(const simulation&) = delete;
+
+    // a new client connection; the id names it in the calls below
+    size_t connect() {
+        auto [client, served] = net::memory_pipe::create(capacity_);
+
+        size_t id      = next_id_++;
+        clients_[id]   = client;
+        connection& c  = served_[id];
+        c.end          = std::make_shared<served_end>(served, now_);
+        c.state.socket = std::make_shared<net::socket>(c.end, net::ip_endpoint("127.0.0.1", 0));
+
+        srv_.metrics_.add(metrics::counter::accepted);
+        return id;
+    }
+
+    // false once the server closed the connection or its buffer is full
+    bool send(size_t id, std::string_view bytes) {
+        return clients_.at(id)->write(bytes.data(), bytes.size()) == static_cast<int>(bytes.size());
+    }
+
+    // everything the server wrote to `id` since the last call
+    string receive(size_t id, size_t max = SIZE_MAX) {
+        string out;
+        char buffer[8192];
+        int n;
+        while (out.size() < max &&
+               (n = clients_.at(id)->read(buffer, std::min(sizeof buffer, max - out.size()))) > 0)
+            out.append(buffer, n);
+        return out;
+    }
+
+    // the client hangs up; `id` is not valid for client calls afterwards
+    void close(size_t id) {
+        clients_.at(id)->close();
+        clients_.erase(id);
+    }
+
+    // the server is done with `id`
+    bool closed(size_t id) const { return served_.count(id) == 0; }
+
+    // the response to `id` waits for the client to make room
+    bool blocked(size_t id) const {
+        auto it = served_.find(id);
+        return it != served_.end() && it->second.writer && !it->second.writer->done();
+    }
+
+    // the simulation's clock, which write timeouts of served connections run on
+    std::chrono::milliseconds now() const { return now_; }
+
+    void advance(std::chrono::milliseconds by) { now_ += by; }
+
+    // looks at every open connection once, oldest first: blocked responses go on where the
+    // client made room or their timeout passed, new requests are served; returns the requests
+    // finished
+    size_t step() {
+        size_t served = 0;
+        for (auto it = served_.begin(); it != served_.end();) {
+            connection& c = it->second;
+            if (c.writer) {
+                if (!resume(c)) {
+                    ++it;
+                    continue;
+                }
+                it = finish(it);
+                ++served;
+                continue;
+            }
+
+            if (!c.state.socket->wait_readable(0)) {
+                ++it;
+                continue;
+            }
+
+            if (!c.state.read_more()) {
+                it = finish(it);
+                continue;
+            }
+            if (!c.state.is_request_complete()) {
+                ++it;
+                continue;
+            }
+
+            string data = c.state.take_request();
+            srv_.metrics_.add(metrics::counter::bytes_in, data.size());
+            if (!serve(c, std::make_shared<const string>(std::move(data)))) {
+                ++it;
+                continue;
+            }
+            it = finish(it);
+            ++served;
+        }
+        return served;
+    }
+
+    // steps until a pass serves nothing
+    size_t run() {
+        size_t total = 0;
+        while (size_t n = step())
+            total += n;
+        return total;
+    }
+
+  private:
+    // One response being written on a bounded connection. Its thread runs only between a
+    // resume() and the next block() or the end of the handler, while the simulation waits.
+    class response_writer {
+      public:
+        explicit response_writer(std::function<void()> fn)
+            : thread_([this, fn = std::move(fn)] {
+                  {
+                      std::unique_lock lock(mutex_);
+                      turn_.wait(lock, [this] { return handler_turn_; });
+                  }
+                  fn();
+                  std::lock_guard lock(mutex_);
+                  done_         = true;
+                  handler_turn_ = false;
+                  turn_.notify_all();
+              }) {}
+
+        ~response_writer() { thread_.join(); }
+
+        // simulation thread: runs the handler until it ends or blocks again; `writable` is what
+        // the blocked write is told
+        void resume(bool writable) {
+            std::unique_lock lock(mutex_);
+            writable_     = writable;
+            handler_turn_ = true;
+            turn_.notify_all();
+            turn_.wait(lock, [this] { return !handler_turn_; });
+        }
+
+        // handler thread: hands the turn back until there is room, or until the simulation
+        // gives up on the write at `deadline`
+        bool block(std::chrono::milliseconds deadline) {
+            std::unique_lock lock(mutex_);
+            deadline_     = deadline;
+            handler_turn_ = false;
+            turn_.notify_all();
+            turn_.wait(lock, [this] { return handler_turn_; });
+            return writable_;
+        }
+
+        bool done() const { return done_; }
+
+        std::chrono::milliseconds deadline() const { return deadline_; }
+
+      private:
+        std::mutex mutex_;
+        std::condition_variable turn_;
+        bool handler_turn_ = false;
+        bool done_         = false;
+        bool writable_     = false;
+        std::chrono::milliseconds deadline_{0};
+        // last, so it starts once the members above exist
+        std::thread thread_;
+    };
+
+    // The server's end of a connection: the pipe, and a write wait that blocks the response's
+    // writer on the simulation's clock
+    class served_end : public net::transport {
+      public:
+        served_end(std::shared_ptr<net::memory_pipe> pipe, const std::chrono::milliseconds& now)
+            : pipe_(std::move(pipe)), now_(now) {}
+
+        int read(char* data, size_t len) override { return pipe_->read(data, len); }
+        int write(const char* data, size_t len) override { return pipe_->write(data, len); }
+        bool readable() const override { return pipe_->readable(); }
+        bool writable() const override { return pipe_->writable(); }
+        void close() override { pipe_->close(); }
+
+        bool wait_writable(int timeout_ms) override {
+            if (!writer_ || timeout_ms == 0)
+                return writable();
+            return writer_->block(timeout_ms < 0 ? std::chrono::milliseconds::max()
+                                                 : now_ + std::chrono::milliseconds(timeout_ms));
+        }
+
+        // room again, or the client is gone and the write will say so
+        bool ready() const { return pipe_->writable() || pipe_->peer_closed(); }
+
+        response_writer* writer_ = nullptr;
+
+      private:
+        std::shared_ptr<net::memory_pipe> pipe_;
+        const std::chrono::milliseconds& now_;
+    };
+
+    struct connection {
+        connection_state state;
+        std::shared_ptr<served_end> end;
+        // set while a response waits for room
+        std::unique_ptr<response_writer> writer;
+    };
+
+    server& srv_;
+    size_t capacity_;
+    size_t next_id_ = 0;
+    std::chrono::milliseconds now_{0};
+    // ordered by id, which is what makes step() deterministic
+    std::map<size_t, connection> served_;
+    std::map<size_t, std::shared_ptr<net::memory_pipe>> clients_;
+
+    // true when the response is written; otherwise it waits for room
+    bool serve(connection& c, std::shared_ptr<const string> data) {
+        auto handle = [this, socket = c.state.socket, accepted = c.state.accepted_at, data = std::move(data)] {
+            connection_handler handler(socket, srv_.router_);
+            handler.set_metrics(&srv_.metrics_, accepted);
+            handler.set_access_log(srv_.access_log_.get());
+            handler.handle(data);
+            if (handler.upgraded_)
+                socket->close();
+        };
+
+        // an unbounded pipe always has room
+        if (capacity_ == 0) {
+            handle();
+            return true;
+        }
+
+        c.writer       = std::make_unique<response_writer>(std::move(handle));
+        c.end->writer_ = c.writer.get();
+        c.writer->resume(true);
+        return c.writer->done();
+    }
+
+    // true once the blocked response is done
+    bool resume(connection& c) {
+        if (c.end->ready())
+            c.writer->resume(true);
+        else if (now_ >= c.writer->deadline())
+            c.writer->resume(false);
+        return c.writer->done();
+    }
+
+    // like the accept loop, one request per connection
+    std::map<size_t, connection>::iterator finish(std::map<size_t, connection>::iterator it) {
+        it->second.end->writer_ = nullptr;
+        it->second.writer.reset();
+        if (it->second.state.socket->is_valid())
+            it->second.state.socket->close();
+        srv_.metrics_.add(metrics::counter::closed);
+        return served_.erase(it);
+    }
+};
+
+} // namespace net::http
@@ -0,0 +1,358 @@
+#pragma once
+// std
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+// lib
+#include <net/event_loop.h>
+#include <net/output_queue.h>
+#include <net/socket_registry.h>
+#include <types.h>
+#include "../request.h"
+
+namespace net::http::sse {
+
+class subscriber;
+class broker;
+using subscriber_ptr = std::shared_ptr<subscriber>;
+
+struct event {
+    string data;
+    // the "event:" field; unnamed events reach the browser as "message"
+    string type;
+    string id;
+    // reconnection delay the client should use, 0 to leave it alone
+    long retry_ms = 0;
+};
+
+// wire form of `ev`; every line of data becomes a data: field of its own
+inline string encode(const event& ev) {
+    string out;
+    out.reserve(ev.data.size() + ev.type.size() + ev.id.size() + 32);
+    if (!ev.id.empty())
+        out.append("id: ").append(ev.id).append("\n");
+    if (!ev.type.empty())
+        out.append("event: ").append(ev.type).append("\n");
+    if (ev.retry_ms > 0)
+        out.append("retry: ").append(std::to_string(ev.retry_ms)).append("\n");
+
+    std::string_view data = ev.data;
+    while (true) {
+        size_t nl             = data.find('\n');
+        std::string_view line = data.substr(0, nl);
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+        out.append("data: ").append(line).append("\n");
+        if (nl == std::string_view::npos)
+            break;
+        data.remove_prefix(nl + 1);
+    }
+    return out.append("\n");
+}
+
+struct options {
+    // a subscriber this far behind is disconnected; browsers reconnect with Last-Event-ID
+    size_t max_lag_events = 1024;
+    size_t max_lag_bytes  = 4 * 1024 * 1024;
+    // a comment line to every subscriber, so idle streams survive proxies and dead peers are
+    // noticed; 0 for none
+    std::chrono::milliseconds keepalive{15000};
+};
+
+struct handler {
+    // where the subscribers of this endpoint join; required
+    std::shared_ptr<sse::broker> broker;
+    // topics a request subscribes to, the request path when not set; none declines it
+    std::function<list<string>(const request&)> topics;
+    // e.g. replays what came after the request's Last-Event-ID with subscriber::send
+    std::function<void(const subscriber_ptr&, const request&)> on_open;
+    std::function<void(const subscriber_ptr&)> on_close;
+};
+
+// One open event stream. It lives on the event loop thread like a WebSocket session; send and
+// close may be called from any thread.
+class subscriber : public std::enable_shared_from_this<subscriber> {
+  public:
+    subscriber(net::event_loop& loop, net::sock_ptr socket, std::shared_ptr<const handler> h, list<string> topics)
+        : loop_(loop), socket_(std::move(socket)), handler_(std::move(h)), topics_(std::move(topics)) {}
+
+    const list<string>& topics() const { return topics_; }
+
+    // to this subscriber only
+    void send(const event& ev) { send(std::make_shared<const string>(encode(ev))); }
+
+    void send(output_queue::buffer encoded) {
+        subscriber_ptr self = shared_from_this();
+        auto fn             = [self, encoded = std::move(encoded)]() mutable {
+            if (!self->enqueue(std::move(encoded)))
+                self->leave();
+        };
+        if (loop_.in_loop_thread())
+            fn();
+        else
+            loop_.post(std::move(fn));
+    }
+
+    void close() {
+        subscriber_ptr self = shared_from_this();
+        auto fn             = [self] {
+            self->shutdown();
+            self->leave();
+        };
+        if (loop_.in_loop_thread())
+            fn();
+        else
+            loop_.post(fn);
+    }
+
+    // loop thread: stops taking events, sends what is queued, then closes
+    void end() {
+        leave();
+        ending_ = true;
+        if (out_.empty())
+            shutdown();
+    }
+
+    // loop thread: `fn` runs once when the stream is closed
+    void on_shutdown(std::function<void()> fn) { on_shutdown_ = std::move(fn); }
+
+    // loop thread: registers with the reactor and the broker
+    inline void start(const request& req);
+
+  private:
+    friend class broker;
+
+    net::event_loop& loop_;
+    net::sock_ptr socket_;
+    std::shared_ptr<const handler> handler_;
+    list<string> topics_;
+
+    output_queue out_;
+    bool open_    = true;
+    bool writing_ = false;
+    // disconnected for falling behind rather than by the peer
+    bool lagged_  = false;
+    bool ending_  = false;
+    std::function<void()> on_shutdown_;
+
+    // false once the subscriber is closed; the caller takes it out of the broker
+    inline bool enqueue(output_queue::buffer encoded);
+
+    void flush() {
+        if (!out_.flush(*socket_) || (ending_ && out_.empty())) {
+            shutdown();
+            return;
+        }
+
+        if (writing_ != !out_.empty()) {
+            writing_ = !out_.empty();
+            loop_.update(*socket_, writing_ ? net::io_read | net::io_write : net::io_read);
+        }
+    }
+
+    void on_io(int events) {
+        if (events & net::io_write)
+            flush();
+        if (open_ && (events & (net::io_read | net::io_error)))
+            drain_input();
+        if (!open_)
+            leave();
+    }
+
+    // clients send nothing after the request; anything that arrives is dropped
+    void drain_input() {
+        char buffer[1024];
+        while (true) {
+            int n = ::recv(*socket_, buffer, sizeof(buffer), 0);
+            if (n > 0)
+                continue;
+            if (n < 0 && WSAGetLastError() == WSAEWOULDBLOCK)
+                return;
+
+            shutdown();
+            return;
+        }
+    }
+
+    void shutdown() {
+        if (!open_)
+            return;
+
+        open_ = false;
+        loop_.unwatch(*socket_);
+        socket_->close();
+        out_.clear();
+
+        // after whatever loop over subscribers got us here is done
+        if (handler_->on_close) {
+            subscriber_ptr self = shared_from_this();
+            loop_.post([self] { self->handler_->on_close(self); });
+        }
+        if (on_shutdown_)
+            std::exchange(on_shutdown_, nullptr)();
+    }
+
+    inline void leave();
+};
+
+// Topic-based fan-out to subscribers. publish() encodes an event once into a shared buffer,
+// hands it to the event loop in a single task, and there the same buffer is queued on every
+// subscriber of the topic, so a publish to thousands of streams costs one allocation and one
+// wakeup plus a write per subscriber. Subscribers that fall behind by more than
+// options::max_lag_events or max_lag_bytes are disconnected. Create with std::make_shared.
+class broker : public std::enable_shared_from_this<broker> {
+  public:
+    explicit broker(sse::options opts = {}) : opts_(opts) {}
+
+    void publish(const string& topic, const event& ev) { publish(topic, std::make_shared<const string>(encode(ev))); }
+
+    void publish(const string& topic, std::string_view data) {
+        event ev;
+        ev.data = string(data);
+        publish(topic, ev);
+    }
+
+    // an event already in wire form, see encode
+    void publish(const string& topic, output_queue::buffer encoded) {
+        // nobody has subscribed yet, so there is no loop and no one to tell
+        net::event_loop* loop = loop_.load();
+        if (!loop)
+            return;
+
+        published_.fetch_add(1, std::memory_order_relaxed);
+        if (loop->in_loop_thread()) {
+            deliver(topic, encoded);
+            return;
+        }
+
+        std::shared_ptr<broker> self = shared_from_this();
+        loop->post([self, topic, encoded = std::move(encoded)] { self->deliver(topic, encoded); });
+    }
+
+    size_t subscribers() const { return subscribers_.load(std::memory_order_relaxed); }
+
+    uint64_t published() const { return published_.load(std::memory_order_relaxed); }
+
+    // subscribers disconnected for lagging
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    const sse::options& options() const { return opts_; }
+
+  private:
+    friend class subscriber;
+
+    sse::options opts_;
+    std::atomic<net::event_loop*> loop_{nullptr};
+    std::atomic<size_t> subscribers_{0};
+    std::atomic<uint64_t> published_{0};
+    std::atomic<uint64_t> dropped_{0};
+
+    // loop thread only
+    std::unordered_map<string, std::unordered_set<subscriber_ptr>> topics_;
+    std::unordered_set<subscriber_ptr> all_;
+    net::event_loop::timer_id keepalive_timer_ = 0;
+
+    void join(const subscriber_ptr& s) {
+        loop_.store(&s->loop_);
+        for (const string& topic : s->topics_)
+            topics_[topic].insert(s);
+        all_.insert(s);
+        subscribers_.store(all_.size(), std::memory_order_relaxed);
+
+        if (!keepalive_timer_ && opts_.keepalive.count() > 0)
+            schedule_keepalive(s->loop_);
+    }
+
+    void leave(const subscriber_ptr& s) {
+        if (!all_.erase(s))
+            return;
+
+        for (const string& topic : s->topics_) {
+            auto it = topics_.find(topic);
+            if (it == topics_.end())
+                continue;
+            it->second.erase(s);
+            if (it->second.empty())
+                topics_.erase(it);
+        }
+        subscribers_.store(all_.size(), std::memory_order_relaxed);
+        if (s->lagged_)
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void deliver(const string& topic, const output_queue::buffer& encoded) {
+        auto it = topics_.find(topic);
+        if (it != topics_.end())
+            send_all(it->second, encoded);
+    }
+
+    void send_all(const std::unordered_set<subscriber_ptr>& targets, const output_queue::buffer& encoded) {
+        // the sets must not change while they are walked
+        list<subscriber_ptr> closed;
+        for (const subscriber_ptr& s : targets)
+            if (!s->enqueue(encoded))
+                closed.push_back(s);
+
+        for (const subscriber_ptr& s : closed)
+            leave(s);
+    }
+
+    void schedule_keepalive(net::event_loop& loop) {
+        std::weak_ptr<broker> weak = shared_from_this();
+        keepalive_timer_           = loop.schedule(opts_.keepalive, [weak, &loop] {
+            std::shared_ptr<broker> self = weak.lock();
+            if (!self)
+                return;
+
+            self->keepalive_timer_ = 0;
+            if (self->all_.empty())
+                return;
+
+            static const output_queue::buffer comment = std::make_shared<const string>(":\n\n");
+            self->send_all(self->all_, comment);
+            if (!self->all_.empty())
+                self->schedule_keepalive(loop);
+        });
+    }
+};
+
+inline void subscriber::start(const request& req) {
+    u_long mode           = 1;
+    socket_->non_blocking = true;
+    ioctlsocket(*socket_, FIONBIO, &mode);
+
+    subscriber_ptr self = shared_from_this();
+    loop_.watch(*socket_, net::io_read, [self](int events) { self->on_io(events); });
+
+    handler_->broker->join(self);
+    if (handler_->on_open)
+        handler_->on_open(self, req);
+}
+
+inline bool subscriber::enqueue(output_queue::buffer encoded) {
+    if (!open_)
+        return false;
+
+    out_.push(std::move(encoded));
+    const sse::options& opts = handler_->broker->options();
+    if (out_.size() > opts.max_lag_events || out_.bytes() > opts.max_lag_bytes) {
+        lagged_ = true;
+        shutdown();
+        return false;
+    }
+
+    // with a backlog the socket is already watched for writability
+    if (!writing_)
+        flush();
+    return open_;
+}
+
+inline void subscriber::leave() { handler_->broker->leave(shared_from_this()); }
+
+} // namespace net::http::sse
@@ -0,0 +1,172 @@
+#pragma once
+// std
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define NET_WS_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define NET_WS_NEON 1
+#endif
+
+namespace net::http::websocket {
+
+enum class opcode : uint8_t {
+    continuation = 0x0,
+    text         = 0x1,
+    binary       = 0x2,
+    close        = 0x8,
+    ping         = 0x9,
+    pong         = 0xA
+};
+
+enum close_code : uint16_t {
+    normal_closure   = 1000,
+    going_away       = 1001,
+    protocol_error   = 1002,
+    unsupported_data = 1003,
+    // reported to on_close for a close frame without a code; never sent
+    no_status        = 1005,
+    invalid_payload  = 1007,
+    policy_violation = 1008,
+    message_too_big  = 1009,
+    internal_error   = 1011
+};
+
+struct frame_header {
+    bool fin;
+    opcode op;
+    bool masked;
+    uint8_t mask[4];
+    uint64_t length;
+    size_t size; // header bytes, payload starts here
+
+    bool is_control() const { return static_cast<uint8_t>(op) & 0x8; }
+};
+
+enum class parse_status { incomplete, ok, error };
+
+// Decodes a frame header in place; the payload is never copied by the codec.
+inline parse_status parse_header(const char* data, size_t len, frame_header& out) {
+    if (len < 2)
+        return parse_status::incomplete;
+
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+    if (p[0] & 0x70)
+        return parse_status::error; // RSV bits without a negotiated extension
+
+    out.fin        = (p[0] & 0x80) != 0;
+    out.op         = static_cast<opcode>(p[0] & 0x0F);
+    out.masked     = (p[1] & 0x80) != 0;
+    uint64_t len7  = p[1] & 0x7F;
+    size_t pos     = 2;
+
+    if (len7 == 126) {
+        if (len < 4)
+            return parse_status::incomplete;
+        out.length = (uint64_t(p[2]) << 8) | p[3];
+        pos        = 4;
+    } else if (len7 == 127) {
+        if (len < 10)
+            return parse_status::incomplete;
+        out.length = 0;
+        for (int i = 0; i < 8; ++i)
+            out.length = (out.length << 8) | p[2 + i];
+        if (out.length >> 63)
+            return parse_status::error;
+        pos = 10;
+    } else {
+        out.length = len7;
+    }
+
+    if (out.masked) {
+        if (len < pos + 4)
+            return parse_status::incomplete;
+        std::memcpy(out.mask, p + pos, 4);
+        pos += 4;
+    }
+
+    out.size = pos;
+    return parse_status::ok;
+}
+
+// XORs `len` payload bytes with the masking key. `offset` is the payload position of `data`,
+// so a payload can be unmasked in pieces. 16 bytes per step with SSE2/NEON, 8 otherwise.
+inline void unmask(char* data, size_t len, const uint8_t mask[4], size_t offset = 0) {
+    uint8_t rotated[16];
+    for (int i = 0; i < 16; ++i)
+        rotated[i] = mask[(offset + i) & 3];
+
+    size_t i = 0;
+#if defined(NET_WS_SSE2)
+    __m128i key = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rotated));
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_xor_si128(v, key));
+    }
+#elif defined(NET_WS_NEON)
+    uint8x16_t key = vld1q_u8(rotated);
+    for (; i + 16 <= len; i += 16) {
+        uint8_t* d = reinterpret_cast<uint8_t*>(data + i);
+        vst1q_u8(d, veorq_u8(vld1q_u8(d), key));
+    }
+#endif
+
+    uint64_t key64;
+    std::memcpy(&key64, rotated, 8);
+    for (; i + 8 <= len; i += 8) {
+        uint64_t v;
+        std::memcpy(&v, data + i, 8);
+        v ^= key64;
+        std::memcpy(data + i, &v, 8);
+    }
+
+    for (; i < len; ++i)
+        data[i] ^= rotated[i & 15];
+}
+
+// Server-to-client frame: unmasked, so a serialized frame can be sent to many clients as is.
+inline void encode_header(std::string& out, opcode op, uint64_t length, bool fin = true) {
+    out.push_back(static_cast<char>((fin ? 0x80 : 0x00) | static_cast<uint8_t>(op)));
+
+    if (length < 126) {
+        out.push_back(static_cast<char>(length));
+    } else if (length <= 0xFFFF) {
+        out.push_back(static_cast<char>(126));
+        out.push_back(static_cast<char>(length >> 8));
+        out.push_back(static_cast<char>(length & 0xFF));
+    } else {
+        out.push_back(static_cast<char>(127));
+        for (int i = 7; i >= 0; --i)
+            out.push_back(static_cast<char>((length >> (8 * i)) & 0xFF));
+    }
+}
+
+inline std::string encode(opcode op, std::string_view payload, bool fin = true) {
+    std::string out;
+    out.reserve(payload.size() + 10);
+    encode_header(out, op, payload.size(), fin);
+    out.append(payload);
+    return out;
+}
+
+// codes a peer may send (RFC 6455 section 7.4): registered ones and the 3000-4999 range
+inline bool valid_close_code(uint16_t code) {
+    if (code >= 3000 && code <= 4999)
+        return true;
+    return code >= 1000 && code <= 1014 && code != 1004 && code != 1005 && code != 1006;
+}
+
+inline std::string encode_close(uint16_t code, std::string_view reason = {}) {
+    std::string payload;
+    payload.push_back(static_cast<char>(code >> 8));
+    payload.push_back(static_cast<char>(code & 0xFF));
+    payload.append(reason.substr(0, 123));
+    return encode(opcode::close, payload);
+}
+
+} // namespace net::http::websocket
@@ -0,0 +1,442 @@
+#pragma once
+// std
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+
+// lib
+#include <net/event_loop.h>
+#include <net/output_queue.h>
+#include <net/socket_registry.h>
+#include "../detail/base64.h"
+#include "../detail/sha1.h"
+#include "../detail/utf8.h"
+#include "../request.h"
+#include "frame.h"
+
+namespace net::http::websocket {
+
+class session;
+class hub;
+using session_ptr = std::shared_ptr<session>;
+
+struct options {
+    size_t max_message_size = 16 * 1024 * 1024;
+    // a client whose unsent backlog exceeds this is disconnected instead of buffered forever
+    size_t max_queued_bytes = 4 * 1024 * 1024;
+    std::chrono::milliseconds ping_interval{30000};
+    // a ping left unanswered this long closes the session with 1001
+    std::chrono::milliseconds pong_timeout{10000};
+    // how long a closing session waits for its close frame to go out and the peer's reply
+    std::chrono::milliseconds close_timeout{5000};
+};
+
+struct handler {
+    std::function<void(const session_ptr&)> on_open;
+    // the view points into the receive buffer and is only valid during the call
+    std::function<void(const session_ptr&, std::string_view message, bool binary)> on_message;
+    std::function<void(const session_ptr&, uint16_t code)> on_close;
+    // sessions join on open and leave on close when set
+    std::shared_ptr<websocket::hub> hub;
+    websocket::options options;
+};
+
+// Sec-WebSocket-Accept for a client key (RFC 6455 section 4.2.2)
+inline string accept_key(const string& client_key) {
+    auto digest = detail::sha1::hash(client_key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
+    return detail::base64_encode(digest.data(), digest.size());
+}
+
+// One upgraded connection. All protocol state lives on the event loop thread; the send
+// functions may be called from any thread and hop over to the loop.
+class session : public std::enable_shared_from_this<session> {
+  public:
+    session(net::event_loop& loop, net::sock_ptr socket, std::shared_ptr<const handler> h,
+            const request& req)
+        : loop_(loop), socket_(std::move(socket)), handler_(std::move(h)), path_(req.path),
+          params_(req.params) {
+        // bytes the client sent right behind the handshake ended up as the request body
+        in_.assign(req.body.begin(), req.body.end());
+    }
+
+    const string& path() const { return path_; }
+    const string_map& params() const { return params_; }
+
+    bool is_open() const { return state_ == state::open; }
+
+    void send_text(std::string_view text) { send(std::make_shared<const string>(encode(opcode::text, text))); }
+
+    void send_binary(std::string_view data) {
+        send(std::make_shared<const string>(encode(opcode::binary, data)));
+    }
+
+    // an already serialized frame; shared between sessions by hub::broadcast
+    void send(output_queue::buffer frame) {
+        if (loop_.in_loop_thread()) {
+            enqueue(std::move(frame));
+            return;
+        }
+
+        session_ptr self = shared_from_this();
+        loop_.post([self, frame = std::move(frame)]() mutable { self->enqueue(std::move(frame)); });
+    }
+
+    void close(uint16_t code = normal_closure, std::string_view reason = {}) {
+        session_ptr self = shared_from_this();
+        string why(reason);
+        auto fn = [self, code, why] { self->start_close(code, why); };
+        if (loop_.in_loop_thread())
+            fn();
+        else
+            loop_.post(fn);
+    }
+
+    // loop thread: `fn` runs once when the connection is closed, whichever side closed it
+    void on_shutdown(std::function<void()> fn) { on_shutdown_ = std::move(fn); }
+
+    // loop thread: registers with the reactor and processes anything that arrived early
+    void start() {
+        u_long mode          = 1;
+        socket_->non_blocking = true;
+        ioctlsocket(*socket_, FIONBIO, &mode);
+
+        // the reactor owns the session until shutdown() unwatches it
+        session_ptr self = shared_from_this();
+        loop_.watch(*socket_, net::io_read, [self](int events) { self->on_io(events); });
+
+        schedule_ping();
+
+        join_hub();
+        if (handler_->on_open)
+            handler_->on_open(shared_from_this());
+
+        if (!in_.empty())
+            process();
+    }
+
+  private:
+    enum class state { open, closing, closed };
+
+    net::event_loop& loop_;
+    net::sock_ptr socket_;
+    std::shared_ptr<const handler> handler_;
+    string path_;
+    string_map params_;
+
+    state state_ = state::open;
+    string in_;
+    string message_;
+    opcode message_op_  = opcode::continuation;
+    bool in_message_    = false;
+    output_queue out_;
+
+    net::event_loop::timer_id ping_timer_ = 0;
+    // pending while a ping waits for its pong
+    net::event_loop::timer_id pong_timer_ = 0;
+    net::event_loop::timer_id close_timer_ = 0;
+    std::function<void()> on_shutdown_;
+
+    const options& opts() const { return handler_->options; }
+
+    void enqueue(output_queue::buffer frame) {
+        if (state_ != state::open)
+            return;
+
+        out_.push(std::move(frame));
+        if (out_.bytes() > opts().max_queued_bytes) {
+            // the client cannot keep up; dropping it protects every other session
+            out_.clear();
+            start_close(policy_violation, "backlog");
+            return;
+        }
+
+        flush();
+    }
+
+    void flush() {
+        if (!out_.flush(*socket_)) {
+            shutdown(going_away);
+            return;
+        }
+
+        if (state_ == state::closing && out_.empty()) {
+            shutdown(normal_closure);
+            return;
+        }
+
+        if (socket_->is_valid())
+            loop_.update(*socket_, out_.empty() ? net::io_read : net::io_read | net::io_write);
+    }
+
+    void on_io(int events) {
+        if (events & net::io_write)
+            flush();
+
+        if (!(events & (net::io_read | net::io_error)) || state_ == state::closed)
+            return;
+
+        char buffer[16384];
+        while (true) {
+            int n = ::recv(*socket_, buffer, sizeof(buffer), 0);
+            if (n > 0) {
+                in_.append(buffer, n);
+                continue;
+            }
+
+            if (n < 0 && WSAGetLastError() == WSAEWOULDBLOCK)
+                break;
+
+            process();
+            shutdown(going_away);
+            return;
+        }
+
+        process();
+    }
+
+    void process() {
+        size_t pos = 0;
+        while (state_ != state::closed) {
+            frame_header h;
+            parse_status status = parse_header(in_.data() + pos, in_.size() - pos, h);
+            if (status == parse_status::incomplete)
+                break;
+
+            if (status == parse_status::error || !h.masked) {
+                start_close(protocol_error, "");
+                break;
+            }
+
+            if (h.length > opts().max_message_size) {
+                start_close(message_too_big, "");
+                break;
+            }
+
+            if (in_.size() - pos - h.size < h.length)
+                break;
+
+            char* payload = in_.data() + pos + h.size;
+            size_t length = static_cast<size_t>(h.length);
+            unmask(payload, length, h.mask);
+            pos += h.size + length;
+
+            if (!on_frame(h, std::string_view(payload, length)))
+                break;
+        }
+
+        in_.erase(0, pos);
+    }
+
+    bool on_frame(const frame_header& h, std::string_view payload) {
+        if (h.is_control()) {
+            if (!h.fin || payload.size() > 125) {
+                start_close(protocol_error, "");
+                return false;
+            }
+
+            switch (h.op) {
+            case opcode::ping:
+                enqueue(std::make_shared<const string>(encode(opcode::pong, payload)));
+                return true;
+            case opcode::pong:
+                loop_.cancel(pong_timer_);
+                pong_timer_ = 0;
+                return true;
+            case opcode::close: {
+                uint16_t code = payload.size() >= 2
+                                    ? static_cast<uint16_t>((uint8_t(payload[0]) << 8) | uint8_t(payload[1]))
+                                    : static_cast<uint16_t>(no_status);
+                bool valid    = payload.empty() || (payload.size() >= 2 && valid_close_code(code) &&
+                                                 detail::valid_utf8(payload.substr(2)));
+                start_close(valid ? code : static_cast<uint16_t>(protocol_error), "");
+                return false;
+            }
+            default:
+                start_close(protocol_error, "");
+                return false;
+            }
+        }
+
+        if (h.op == opcode::continuation) {
+            if (!in_message_) {
+                start_close(protocol_error, "");
+                return false;
+            }
+
+            if (message_.size() + payload.size() > opts().max_message_size) {
+                start_close(message_too_big, "");
+                return false;
+            }
+
+            message_.append(payload);
+            if (h.fin) {
+                in_message_ = false;
+                if (message_op_ == opcode::text && !detail::valid_utf8(message_)) {
+                    start_close(invalid_payload, "");
+                    return false;
+                }
+                deliver(message_, message_op_ == opcode::binary);
+                message_.clear();
+            }
+            return true;
+        }
+
+        if (h.op != opcode::text && h.op != opcode::binary) {
+            start_close(protocol_error, "");
+            return false;
+        }
+
+        if (in_message_) {
+            start_close(protocol_error, "");
+            return false;
+        }
+
+        if (h.fin) {
+            if (h.op == opcode::text && !detail::valid_utf8(payload)) {
+                start_close(invalid_payload, "");
+                return false;
+            }
+            // the common case: a whole message in one frame, delivered straight from the buffer
+            deliver(payload, h.op == opcode::binary);
+        } else {
+            in_message_ = true;
+            message_op_ = h.op;
+            message_.assign(payload);
+        }
+        return true;
+    }
+
+    void deliver(std::string_view message, bool binary) {
+        if (handler_->on_message && state_ == state::open)
+            handler_->on_message(shared_from_this(), message, binary);
+    }
+
+    void schedule_ping() {
+        std::weak_ptr<session> weak = shared_from_this();
+        ping_timer_                 = loop_.schedule(opts().ping_interval, [weak] {
+            if (auto s = weak.lock())
+                s->on_ping_timer();
+        });
+    }
+
+    void on_ping_timer() {
+        ping_timer_ = 0;
+        if (state_ != state::open)
+            return;
+
+        schedule_ping();
+        // the last ping is still unanswered; its deadline decides
+        if (pong_timer_)
+            return;
+
+        enqueue(std::make_shared<const string>(encode(opcode::ping, {})));
+        std::weak_ptr<session> weak = shared_from_this();
+        pong_timer_                 = loop_.schedule(opts().pong_timeout, [weak] {
+            if (auto s = weak.lock()) {
+                s->pong_timer_ = 0;
+                s->shutdown(going_away);
+            }
+        });
+    }
+
+    void start_close(uint16_t code, const string& reason) {
+        if (state_ != state::open)
+            return;
+
+        out_.push(encode_close(code == no_status ? static_cast<uint16_t>(normal_closure) : code, reason));
+        state_ = state::closing;
+        notify_close(code);
+
+        // a peer that reads nothing never lets the close frame out, so it is not waited for
+        std::weak_ptr<session> weak = shared_from_this();
+        close_timer_                = loop_.schedule(opts().close_timeout, [weak] {
+            if (auto s = weak.lock()) {
+                s->close_timer_ = 0;
+                s->shutdown(going_away);
+            }
+        });
+        flush();
+    }
+
+    void shutdown(uint16_t code) {
+        if (state_ == state::closed)
+            return;
+
+        if (state_ == state::open)
+            notify_close(code);
+
+        state_ = state::closed;
+        loop_.cancel(ping_timer_);
+        loop_.cancel(pong_timer_);
+        loop_.cancel(close_timer_);
+        loop_.unwatch(*socket_);
+        socket_->close();
+        out_.clear();
+
+        if (on_shutdown_)
+            std::exchange(on_shutdown_, nullptr)();
+    }
+
+    void join_hub();
+    void notify_close(uint16_t code);
+};
+
+// Broadcast group. The frame is serialized once and the same buffer is queued on every session.
+class hub {
+  public:
+    void join(const session_ptr& s) {
+        std::lock_guard lock(mutex_);
+        sessions_.insert(s);
+    }
+
+    void leave(const session_ptr& s) {
+        std::lock_guard lock(mutex_);
+        sessions_.erase(s);
+    }
+
+    size_t size() const {
+        std::lock_guard lock(mutex_);
+        return sessions_.size();
+    }
+
+    void broadcast_text(std::string_view text) { broadcast(encode(opcode::text, text)); }
+
+    void broadcast_binary(std::string_view data) { broadcast(encode(opcode::binary, data)); }
+
+    void broadcast(string frame) {
+        output_queue::buffer shared = std::make_shared<const string>(std::move(frame));
+
+        // sending can close a session, which leaves the hub; never do that under the lock
+        list<session_ptr> targets;
+        {
+            std::lock_guard lock(mutex_);
+            targets.assign(sessions_.begin(), sessions_.end());
+        }
+
+        for (const session_ptr& s : targets)
+            s->send(shared);
+    }
+
+  private:
+    mutable std::mutex mutex_;
+    std::unordered_set<session_ptr> sessions_;
+};
+
+inline void session::join_hub() {
+    if (handler_->hub)
+        handler_->hub->join(shared_from_this());
+}
+
+inline void session::notify_close(uint16_t code) {
+    session_ptr self = shared_from_this();
+    if (handler_->hub)
+        handler_->hub->leave(self);
+    if (handler_->on_close)
+        handler_->on_close(self, code);
+}
+
+} // namespace net::http::websocket
@@ -1,22 +1,36 @@
 #pragma once
 // std
+#include <cstddef>
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
 #include <string>
 
 // libs
 #include <utils/net.h>
-
+#ifdef _WIN32
+#include <afunix.h>
+#else
+#include <netdb.h>
+#include <sys/un.h>
+#endif
 
 using string = std::string;
 
 namespace net {
 
+enum class address_family : unsigned short {
+    Unspecified = AF_UNSPEC,
+    IPv4        = AF_INET,
+    IPv6        = AF_INET6,
+    Unix        = AF_UNIX
+};
+
 class ip_address {
     friend class ip_endpoint;
 
   public:
     static string from_binary(uint32_t ip) {
-        struct in_addr addr;
         char _ip[INET_ADDRSTRLEN];
         return inet_ntop(AF_INET, &ip, _ip, INET_ADDRSTRLEN);
     }
@@ -29,61 +43,202 @@ class ip_address {
         }
         return addr.s_addr;
     }
+
+    static bool is_v6(const string& ip) { return ip.find(':') != string::npos; }
+
+    static string to_string(const sockaddr* addr) {
+        char buffer[INET6_ADDRSTRLEN] = {};
+        switch (addr->sa_family) {
+        case AF_INET:
+            inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in*>(addr)->sin_addr, buffer,
+                      INET6_ADDRSTRLEN);
+            break;
+        case AF_INET6:
+            inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6*>(addr)->sin6_addr, buffer,
+                      INET6_ADDRSTRLEN);
+            break;
+        default:
+            break;
+        }
+        return buffer;
+    }
 };
 
 class ip_endpoint {
     friend class socket;
 
-    sockaddr_in saddr_;
-    string ip_;
-    int port_;
+    sockaddr_storage storage_;
+    socklen_t len_;
 
-    socklen_t len{};
+    // formatted on first use; accepted sockets never pay for it unless asked
+    mutable string text_;
+    mutable bool text_valid_ = false;
 
   public:
-    ip_endpoint() : len(sizeof(saddr_)), saddr_{}, ip_(DEFAULT_IP), port_(DEFAULT_PORT) {
-        saddr_.sin_family      = AF_INET;
-        saddr_.sin_addr.s_addr = ip_address::from_string(ip_);
-        saddr_.sin_port        = htons(port_);
+    ip_endpoint() : storage_{}, len_(sizeof(storage_)) { storage_.ss_family = AF_UNSPEC; }
+
+    ip_endpoint(const string& ip, int port) : storage_{}, len_(0) { set(ip, port); }
+
+    ip_endpoint(const sockaddr* addr, socklen_t len) : storage_{}, len_(len) {
+        if (len_ > static_cast<socklen_t>(sizeof(storage_)))
+            len_ = sizeof(storage_);
+        std::memcpy(&storage_, addr, len_);
+    }
+
+    static ip_endpoint any(int port, address_family family = address_family::IPv4) {
+        return ip_endpoint(family == address_family::IPv6 ? "::" : "0.0.0.0", port);
     }
 
-    ip_endpoint(const string& ip, int port) : saddr_{}, ip_(ip), port_(port) {
-        saddr_.sin_family      = AF_INET;
-        saddr_.sin_addr.s_addr = ip_address::from_string(ip_);
-        saddr_.sin_port        = htons(port_);
+    // blocking name lookup; numeric addresses resolve without touching DNS
+    static ip_endpoint resolve(const string& host, int port) {
+        addrinfo hints{};
+        hints.ai_family   = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* found   = nullptr;
+        if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &found) != 0 || !found)
+            throw std::runtime_error("Could not resolve host " + host);
+
+        ip_endpoint ep(found->ai_addr, static_cast<socklen_t>(found->ai_addrlen));
+        freeaddrinfo(found);
+        return ep;
     }
 
-    const string ip_address() { return ip_; }
-    const string& ip_address() const { return ip_; }
+    static ip_endpoint unix_path(const string& path) {
+        ip_endpoint ep;
+        sockaddr_un& addr = ep.as<sockaddr_un>();
+        if (path.size() >= sizeof(addr.sun_path))
+            throw std::invalid_argument("Unix socket path too long");
+
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.data(), path.size());
+        ep.len_ = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size() + 1);
+        return ep;
+    }
 
-    const int port() { return port_; }
-    const int& port() const { return port_; }
+#ifdef __linux__
+    // Linux abstract namespace: leading NUL, no filesystem entry, gone with the last fd
+    static ip_endpoint abstract_unix(const string& name) {
+        ip_endpoint ep;
+        sockaddr_un& addr = ep.as<sockaddr_un>();
+        if (name.size() + 1 > sizeof(addr.sun_path))
+            throw std::invalid_argument("Unix socket name too long");
+
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path + 1, name.data(), name.size());
+        ep.len_ = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + 1 + name.size());
+        return ep;
+    }
+#endif
 
-    sockaddr_in& native() { return saddr_; }
-    const sockaddr_in& native() const { return saddr_; }
+    address_family family() const { return static_cast<address_family>(storage_.ss_family); }
 
-    string to_string() { return ip_ + ":" + std::to_string(port_); }
+    bool is_v4() const { return storage_.ss_family == AF_INET; }
+    bool is_v6() const { return storage_.ss_family == AF_INET6; }
+    bool is_unix() const { return storage_.ss_family == AF_UNIX; }
+    bool is_specified() const { return storage_.ss_family != AF_UNSPEC; }
 
-    void set(const string& ip, uint16_t port) {
-        ip_  = ip;
-        port = port;
+    bool is_abstract() const {
+        return is_unix() && len_ > static_cast<socklen_t>(offsetof(sockaddr_un, sun_path)) &&
+               as<sockaddr_un>().sun_path[0] == '\0';
     }
 
-    sockaddr* get_sockaddr() { return reinterpret_cast<sockaddr*>(&saddr_); }
+    const string& ip_address() const {
+        if (!text_valid_) {
+            text_       = is_unix() ? path() : net::ip_address::to_string(get_sockaddr());
+            text_valid_ = true;
+        }
+        return text_;
+    }
 
-    const sockaddr* get_sockaddr() const { return reinterpret_cast<const sockaddr*>(&saddr_); }
+    int port() const {
+        switch (storage_.ss_family) {
+        case AF_INET:
+            return ntohs(as<sockaddr_in>().sin_port);
+        case AF_INET6:
+            return ntohs(as<sockaddr_in6>().sin6_port);
+        default:
+            return 0;
+        }
+    }
+
+    string path() const {
+        if (!is_unix())
+            return "";
+
+        const sockaddr_un& addr = as<sockaddr_un>();
+        size_t max = len_ > static_cast<socklen_t>(offsetof(sockaddr_un, sun_path))
+                         ? len_ - offsetof(sockaddr_un, sun_path)
+                         : 0;
+        if (is_abstract())
+            return "@" + string(addr.sun_path + 1, max - 1);
+        return string(addr.sun_path, strnlen(addr.sun_path, max));
+    }
 
-    operator const sockaddr_in&() const { return saddr_; }
+    string to_string() const {
+        if (is_unix())
+            return "unix:" + path();
+        if (is_v6())
+            return "[" + ip_address() + "]:" + std::to_string(port());
+        return ip_address() + ":" + std::to_string(port());
+    }
 
-    sockaddr_in& get_sockaddr_in() { return *(reinterpret_cast<sockaddr_in*>(this)); }
+    void set(const string& ip, int port) {
+        storage_    = {};
+        text_valid_ = false;
+
+        if (net::ip_address::is_v6(ip)) {
+            string host = ip.size() > 1 && ip.front() == '[' && ip.back() == ']'
+                              ? ip.substr(1, ip.size() - 2)
+                              : ip;
+
+            sockaddr_in6& addr = as<sockaddr_in6>();
+            if (inet_pton(AF_INET6, host.c_str(), &addr.sin6_addr) != 1) {
+                std::cerr << "Invalid IP Address" << std::endl;
+                throw std::invalid_argument("Invalid IP Address");
+            }
+            addr.sin6_family = AF_INET6;
+            addr.sin6_port   = htons(static_cast<uint16_t>(port));
+            len_             = sizeof(sockaddr_in6);
+        } else {
+            sockaddr_in& addr    = as<sockaddr_in>();
+            addr.sin_family      = AF_INET;
+            addr.sin_addr.s_addr = net::ip_address::from_string(ip);
+            addr.sin_port        = htons(static_cast<uint16_t>(port));
+            len_                 = sizeof(sockaddr_in);
+        }
+    }
 
-    const sockaddr_in& get_sockaddr_in() const {
-        return *(reinterpret_cast<const sockaddr_in*>(this));
+    void set_port(int port) {
+        if (is_v4())
+            as<sockaddr_in>().sin_port = htons(static_cast<uint16_t>(port));
+        else if (is_v6())
+            as<sockaddr_in6>().sin6_port = htons(static_cast<uint16_t>(port));
     }
 
-    socklen_t* get_len_ptr() { return &len; }
+    sockaddr_storage& native() { return storage_; }
+    const sockaddr_storage& native() const { return storage_; }
 
-    socklen_t size() const { return sizeof(saddr_); }
+    sockaddr* get_sockaddr() {
+        text_valid_ = false;
+        return reinterpret_cast<sockaddr*>(&storage_);
+    }
+
+    const sockaddr* get_sockaddr() const { return reinterpret_cast<const sockaddr*>(&storage_); }
+
+    socklen_t* get_len_ptr() { return &len_; }
+
+    socklen_t size() const { return len_; }
+
+  private:
+    template <typename T>
+    T& as() {
+        return *reinterpret_cast<T*>(&storage_);
+    }
+
+    template <typename T>
+    const T& as() const {
+        return *reinterpret_cast<const T*>(&storage_);
+    }
 };
 
-} // namespace net
\ No newline at end of file
+} // namespace net
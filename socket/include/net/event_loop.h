@@ -0,0 +1,267 @@
+#pragma once
+// std
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+// lib
+#include <types.h>
+#include "socket.h"
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+namespace net {
+
+enum io_event : int { io_none = 0, io_read = 1, io_write = 2, io_error = 4 };
+
+// Single-threaded reactor. watch/update/unwatch/schedule/cancel must be called on the loop
+// thread; post() is the only thread-safe entry point and is how other threads hand work in.
+// Uses poll/WSAPoll so the number of watched sockets is not bounded by FD_SETSIZE.
+class event_loop {
+  public:
+    using io_callback = std::function<void(int events)>;
+    using task        = std::function<void()>;
+    using clock       = std::chrono::steady_clock;
+    using timer_id    = uint64_t;
+
+    event_loop() : wakeup_(ip_endpoint("127.0.0.1", 0), protocol::UDP) {
+        // self-connected loopback datagram socket: portable wakeup for poll and WSAPoll
+        wakeup_.bind();
+        ip_endpoint self = wakeup_.local_endpoint();
+        wakeup_.connect(self);
+
+        u_long mode = 1;
+        ioctlsocket(wakeup_, FIONBIO, &mode);
+
+        fds_.push_back(make_pollfd(wakeup_, io_read));
+    }
+
+    ~event_loop() {
+        stop();
+        wakeup_.close();
+    }
+
+    event_loop(const event_loop&)            = delete;
+    event_loop& operator=(const event_loop&) = delete;
+
+    void watch(SOCKET s, int events, io_callback cb) {
+        auto it = handlers_.find(s);
+        if (it != handlers_.end()) {
+            it->second.callback = std::move(cb);
+            update(s, events);
+            return;
+        }
+
+        handlers_[s] = {events, std::move(cb), fds_.size()};
+        fds_.push_back(make_pollfd(s, events));
+    }
+
+    void update(SOCKET s, int events) {
+        auto it = handlers_.find(s);
+        if (it == handlers_.end())
+            return;
+
+        it->second.events              = events;
+        fds_[it->second.index].events = make_pollfd(s, events).events;
+    }
+
+    void unwatch(SOCKET s) {
+        auto it = handlers_.find(s);
+        if (it == handlers_.end())
+            return;
+
+        // the last entry takes the freed slot
+        size_t index = it->second.index;
+        if (index != fds_.size() - 1) {
+            fds_[index] = fds_.back();
+            handlers_[static_cast<SOCKET>(fds_[index].fd)].index = index;
+        }
+        fds_.pop_back();
+        handlers_.erase(it);
+    }
+
+    bool watching(SOCKET s) const { return handlers_.count(s) > 0; }
+
+    size_t size() const { return handlers_.size(); }
+
+    timer_id schedule(clock::duration delay, task fn) {
+        timer_id id           = ++last_timer_;
+        clock::time_point due = clock::now() + delay;
+        timers_.emplace(std::make_pair(due, id), std::move(fn));
+        timer_due_[id] = due;
+        return id;
+    }
+
+    void cancel(timer_id id) {
+        auto it = timer_due_.find(id);
+        if (it == timer_due_.end())
+            return;
+
+        timers_.erase({it->second, id});
+        timer_due_.erase(it);
+    }
+
+    void post(task fn) {
+        {
+            std::lock_guard lock(post_mutex_);
+            posted_.push_back(std::move(fn));
+        }
+
+        if (!in_loop_thread()) {
+            char b = 1;
+            ::send(wakeup_, &b, 1, 0);
+        }
+    }
+
+    bool in_loop_thread() const { return std::this_thread::get_id() == owner_.load(); }
+
+    void run() {
+        owner_   = std::this_thread::get_id();
+        running_ = true;
+
+        // stop() may have been called before this thread got here; that request stands
+        while (!stop_requested_.load()) {
+            int result = poll_sockets(fds_.data(), fds_.size(), next_timeout_ms());
+            if (result == SOCKET_ERROR) {
+                if (WSAGetLastError() == WSAEINTR)
+                    continue;
+                std::cerr << "[event_loop] poll failed: " << net::get_socket_error() << std::endl;
+                break;
+            }
+
+            if (fds_[0].revents != 0)
+                drain_wakeup();
+
+            // callbacks may watch and unwatch, which moves entries around in fds_
+            ready_.clear();
+            for (size_t i = 1; i < fds_.size() && ready_.size() < static_cast<size_t>(result); ++i) {
+                short revents = fds_[i].revents;
+                if (revents == 0)
+                    continue;
+
+                int events = 0;
+                if (revents & (POLLIN | POLLHUP))
+                    events |= io_read;
+                if (revents & POLLOUT)
+                    events |= io_write;
+                if (revents & (POLLERR | POLLNVAL))
+                    events |= io_error;
+                ready_.emplace_back(static_cast<SOCKET>(fds_[i].fd), events);
+            }
+
+            for (const auto& [s, events] : ready_) {
+                // a previous callback in this round may have unwatched the socket
+                auto it = handlers_.find(s);
+                if (it != handlers_.end()) {
+                    io_callback cb = it->second.callback;
+                    cb(events);
+                }
+            }
+
+            run_timers();
+            run_posted();
+        }
+
+        run_posted();
+        running_ = false;
+        owner_   = std::thread::id();
+    }
+
+    void stop() {
+        stop_requested_ = true;
+        char b   = 0;
+        ::send(wakeup_, &b, 1, 0);
+    }
+
+    bool running() const { return running_.load(); }
+
+  private:
+    struct handler {
+        int events;
+        io_callback callback;
+        // position in fds_
+        size_t index;
+    };
+
+    std::unordered_map<SOCKET, handler> handlers_;
+    // kept in step with handlers_, the wakeup socket first
+    list<pollfd> fds_;
+    list<std::pair<SOCKET, int>> ready_;
+    std::map<std::pair<clock::time_point, timer_id>, task> timers_;
+    std::unordered_map<timer_id, clock::time_point> timer_due_;
+    timer_id last_timer_ = 0;
+
+    std::mutex post_mutex_;
+    list<task> posted_;
+
+    net::socket wakeup_;
+    std::atomic<bool> running_{false};
+    std::atomic<bool> stop_requested_{false};
+    std::atomic<std::thread::id> owner_{};
+
+    static pollfd make_pollfd(SOCKET s, int events) {
+        pollfd p{};
+        p.fd     = static_cast<decltype(p.fd)>(s);
+        p.events = static_cast<short>(((events & io_read) ? POLLIN : 0) |
+                                      ((events & io_write) ? POLLOUT : 0));
+        return p;
+    }
+
+    static int poll_sockets(pollfd* fds, size_t count, int timeout_ms) {
+#ifdef _WIN32
+        return ::WSAPoll(fds, static_cast<ULONG>(count), timeout_ms);
+#else
+        return ::poll(fds, static_cast<nfds_t>(count), timeout_ms);
+#endif
+    }
+
+    int next_timeout_ms() {
+        {
+            std::lock_guard lock(post_mutex_);
+            if (!posted_.empty())
+                return 0;
+        }
+
+        if (timers_.empty())
+            return -1;
+
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+            timers_.begin()->first.first - clock::now());
+        return wait.count() < 0 ? 0 : static_cast<int>(wait.count()) + 1;
+    }
+
+    void drain_wakeup() {
+        char buffer[64];
+        while (::recv(wakeup_, buffer, sizeof(buffer), 0) > 0) {
+        }
+    }
+
+    void run_timers() {
+        clock::time_point now = clock::now();
+        while (!timers_.empty() && timers_.begin()->first.first <= now) {
+            auto it = timers_.begin();
+            task fn = std::move(it->second);
+            timer_due_.erase(it->first.second);
+            timers_.erase(it);
+            fn();
+        }
+    }
+
+    void run_posted() {
+        list<task> batch;
+        {
+            std::lock_guard lock(post_mutex_);
+            batch.swap(posted_);
+        }
+
+        for (auto& fn : batch)
+            fn();
+    }
+};
+
+} // namespace net
@@ -0,0 +1,130 @@
+#pragma once
+// Handing listening sockets from one process to another, for restarts that never refuse a
+// connection. POSIX only: Windows would need WSADuplicateSocket and a different handshake.
+#ifndef _WIN32
+// std
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// lib
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <types.h>
+#include "socket.h"
+
+namespace net {
+
+// the most descriptors one message carries
+inline constexpr size_t max_passed_fds = 16;
+
+// received descriptors should not leak into processes we exec
+#ifdef MSG_CMSG_CLOEXEC
+inline constexpr int receive_fd_flags = MSG_CMSG_CLOEXEC;
+#else
+inline constexpr int receive_fd_flags = 0;
+#endif
+
+// sends `fds` as SCM_RIGHTS ancillary data over a connected unix-domain socket
+inline bool send_fds(SOCKET via, const list<int>& fds) {
+    if (fds.empty() || fds.size() > max_passed_fds)
+        return false;
+
+    // at least one byte of ordinary data has to go with the descriptors
+    char byte = 'F';
+    iovec iov{&byte, 1};
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * max_passed_fds)] = {};
+    msghdr msg{};
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+
+    cmsghdr* cmsg    = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type  = SCM_RIGHTS;
+    cmsg->cmsg_len   = CMSG_LEN(sizeof(int) * fds.size());
+    std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+
+    ssize_t sent;
+    do {
+        sent = ::sendmsg(via, &msg, send_flags);
+    } while (sent < 0 && errno == EINTR);
+    return sent == 1;
+}
+
+// descriptors sent with send_fds; empty when the peer closed or sent none
+inline list<int> receive_fds(SOCKET via) {
+    char byte;
+    iovec iov{&byte, 1};
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * max_passed_fds)] = {};
+    msghdr msg{};
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control;
+    msg.msg_controllen = sizeof control;
+
+    ssize_t got;
+    do {
+        got = ::recvmsg(via, &msg, receive_fd_flags);
+    } while (got < 0 && errno == EINTR);
+
+    list<int> fds;
+    if (got <= 0)
+        return fds;
+
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+
+        size_t n  = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        size_t at = fds.size();
+        fds.resize(at + n);
+        std::memcpy(fds.data() + at, CMSG_DATA(cmsg), n * sizeof(int));
+    }
+    return fds;
+}
+
+// Sockets a supervisor opened for this process, systemd style (sd_listen_fds): LISTEN_FDS
+// descriptors starting at 3, meant for us when LISTEN_PID is our pid. The variables are
+// removed so child processes do not take the sockets for theirs.
+inline list<int> listen_fds() {
+    constexpr int first = 3;
+
+    list<int> fds;
+    const char* pid   = std::getenv("LISTEN_PID");
+    const char* count = std::getenv("LISTEN_FDS");
+    if (pid && count && std::strtol(pid, nullptr, 10) == static_cast<long>(::getpid())) {
+        long n = std::strtol(count, nullptr, 10);
+        for (long i = 0; i < n; ++i)
+            fds.push_back(first + static_cast<int>(i));
+    }
+
+    ::unsetenv("LISTEN_PID");
+    ::unsetenv("LISTEN_FDS");
+    ::unsetenv("LISTEN_FDNAMES");
+    return fds;
+}
+
+// connects to a process serving a handoff at `path` and takes the listening socket it sends
+inline socket take_listener(const string& path) {
+    socket channel(ip_endpoint::unix_path(path));
+    list<int> fds;
+    if (channel.connect())
+        fds = receive_fds(channel);
+    channel.close();
+
+    if (fds.empty())
+        throw std::runtime_error("No listening socket received from " + path);
+
+    for (size_t i = 1; i < fds.size(); ++i)
+        ::close(fds[i]);
+    return socket::inherit(static_cast<SOCKET>(fds[0]));
+}
+
+} // namespace net
+#endif
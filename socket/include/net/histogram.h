@@ -0,0 +1,130 @@
+#pragma once
+// std
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace net {
+
+// Log-linear histogram in the style of HdrHistogram: values below 128 are exact, larger ones
+// fall into 64 buckets per power of two, so any recorded value is reproduced within 1.6%.
+// Recording is an index computation and an increment; histograms from several threads are
+// combined with merge(). Not thread-safe.
+class histogram {
+  public:
+    static constexpr int sub_bucket_bits = 7;
+    static constexpr uint64_t sub_buckets = uint64_t(1) << sub_bucket_bits;
+    static constexpr uint64_t half_buckets = sub_buckets / 2;
+    static constexpr size_t bucket_count  = sub_buckets + (64 - sub_bucket_bits) * half_buckets;
+
+    histogram() : counts_(bucket_count) {}
+
+    void record(uint64_t value, uint64_t count = 1) {
+        counts_[index_of(value)] += count;
+        total_ += count;
+        sum_ += value * count;
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+
+    // Coordinated-omission correction: a request that took `value` while one was due every
+    // `expected_interval` also stands for the requests that could not be sent meanwhile.
+    void record_corrected(uint64_t value, uint64_t expected_interval) {
+        record(value);
+        if (expected_interval == 0)
+            return;
+
+        for (uint64_t missing = value > expected_interval ? value - expected_interval : 0;
+             missing >= expected_interval; missing -= expected_interval)
+            record(missing);
+    }
+
+    void merge(const histogram& other) {
+        for (size_t i = 0; i < bucket_count; ++i)
+            counts_[i] += other.counts_[i];
+        total_ += other.total_;
+        sum_ += other.sum_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    void reset() {
+        std::fill(counts_.begin(), counts_.end(), 0);
+        total_ = 0;
+        sum_   = 0;
+        min_   = UINT64_MAX;
+        max_   = 0;
+    }
+
+    uint64_t count() const { return total_; }
+    uint64_t min() const { return total_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const { return total_ ? static_cast<double>(sum_) / total_ : 0; }
+
+    // smallest value that `percentile` percent of the samples do not exceed (0-100)
+    uint64_t percentile(double percentile) const {
+        if (total_ == 0)
+            return 0;
+
+        uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * total_ + 0.5);
+        rank          = std::clamp<uint64_t>(rank, 1, total_);
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < bucket_count; ++i) {
+            seen += counts_[i];
+            if (seen >= rank)
+                return std::min(highest_equivalent(i), max_);
+        }
+        return max_;
+    }
+
+    // bucket upper bounds and counts, for exporters (Prometheus, JSON)
+    template <typename Fn>
+    void for_each_bucket(Fn fn) const {
+        for (size_t i = 0; i < bucket_count; ++i)
+            if (counts_[i])
+                fn(highest_equivalent(i), counts_[i]);
+    }
+
+    // bucket of `v`, and the largest value that falls into bucket `i`
+    static size_t index_of(uint64_t v) {
+        if (v < sub_buckets)
+            return static_cast<size_t>(v);
+
+        int shift = msb(v) - (sub_bucket_bits - 1);
+        return static_cast<size_t>(sub_buckets + (shift - 1) * half_buckets + ((v >> shift) - half_buckets));
+    }
+
+    static uint64_t highest_equivalent(size_t i) {
+        if (i < sub_buckets)
+            return i;
+
+        uint64_t k     = i - sub_buckets;
+        int shift      = static_cast<int>(k / half_buckets) + 1;
+        uint64_t first = (k % half_buckets + half_buckets) << shift;
+        return first + (uint64_t(1) << shift) - 1;
+    }
+
+  private:
+    std::vector<uint64_t> counts_;
+    uint64_t total_ = 0;
+    uint64_t sum_   = 0;
+    uint64_t min_   = UINT64_MAX;
+    uint64_t max_   = 0;
+
+    static int msb(uint64_t v) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanReverse64(&index, v);
+        return static_cast<int>(index);
+#else
+        return 63 - __builtin_clzll(v);
+#endif
+    }
+};
+
+} // namespace net
@@ -0,0 +1,67 @@
+#pragma once
+// std
+#include <fstream>
+#include <sstream>
+#include <string>
+
+// lib
+#include "socket.h"
+#ifdef __linux__
+#include <netinet/tcp.h>
+#endif
+
+namespace net {
+
+// Accept-queue figures for sizing the listen backlog. Linux only; elsewhere `available` stays
+// false and everything reads zero.
+struct listen_stats {
+    bool available = false;
+    // connections waiting to be accepted, and the queue's limit (TCP_INFO of the listener)
+    uint32_t queued  = 0;
+    uint32_t backlog = 0;
+    // host-wide since boot, from TcpExt in /proc/net/netstat: handshakes completed while the
+    // accept queue was full, and SYNs dropped at listening sockets for any reason
+    uint64_t overflows = 0;
+    uint64_t drops     = 0;
+
+    static listen_stats read(SOCKET listening) {
+        listen_stats st;
+#if defined(__linux__) && defined(TCP_INFO)
+        tcp_info info{};
+        socklen_t len = sizeof info;
+        // for a listener the kernel reports queue length and limit in the unacked/sacked fields
+        if (getsockopt(static_cast<int>(listening), IPPROTO_TCP, TCP_INFO, &info, &len) == 0) {
+            st.available = true;
+            st.queued    = info.tcpi_unacked;
+            st.backlog   = info.tcpi_sacked;
+        }
+        read_netstat(st);
+#endif
+        return st;
+    }
+
+  private:
+    // "TcpExt: name name ..." is followed by "TcpExt: value value ..."
+    static void read_netstat(listen_stats& st) {
+        std::ifstream in("/proc/net/netstat");
+        string names, values;
+        while (std::getline(in, names) && std::getline(in, values)) {
+            if (names.rfind("TcpExt:", 0) != 0)
+                continue;
+
+            std::istringstream n(names), v(values);
+            string name, value;
+            n >> name;
+            v >> value;
+            while (n >> name && v >> value) {
+                if (name == "ListenOverflows")
+                    st.overflows = std::stoull(value);
+                else if (name == "ListenDrops")
+                    st.drops = std::stoull(value);
+            }
+            return;
+        }
+    }
+};
+
+} // namespace net
@@ -0,0 +1,108 @@
+#pragma once
+// std
+#include <deque>
+#include <memory>
+#include <string>
+
+// lib
+#include "socket.h"
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
+namespace net {
+
+// Pending output of a non-blocking connection. Buffers are shared and immutable, so one
+// serialized message can sit in many connections' queues at once (broadcast, pub/sub).
+class output_queue {
+  public:
+    using buffer = std::shared_ptr<const string>;
+
+    void push(buffer b) {
+        if (!b || b->empty())
+            return;
+        bytes_ += b->size();
+        queue_.push_back(std::move(b));
+    }
+
+    void push(string data) { push(std::make_shared<const string>(std::move(data))); }
+
+    bool empty() const { return queue_.empty(); }
+
+    // bytes not yet accepted by the kernel
+    size_t bytes() const { return bytes_; }
+
+    size_t size() const { return queue_.size(); }
+
+    void clear() {
+        queue_.clear();
+        offset_ = 0;
+        bytes_  = 0;
+    }
+
+    // Writes as much as the socket takes, several buffers per call. Returns false on a hard
+    // error; running out of socket buffer space is not an error.
+    bool flush(SOCKET s) {
+        while (!queue_.empty()) {
+            int sent = send_batch(s);
+            if (sent < 0)
+                return WSAGetLastError() == WSAEWOULDBLOCK;
+
+            consume(static_cast<size_t>(sent));
+        }
+        return true;
+    }
+
+  private:
+    static constexpr size_t max_batch_ = 16;
+
+    std::deque<buffer> queue_;
+    size_t offset_ = 0;
+    size_t bytes_  = 0;
+
+    int send_batch(SOCKET s) {
+        size_t count = queue_.size() < max_batch_ ? queue_.size() : max_batch_;
+#ifdef _WIN32
+        WSABUF bufs[max_batch_];
+        for (size_t i = 0; i < count; ++i) {
+            size_t skip  = i == 0 ? offset_ : 0;
+            bufs[i].buf  = const_cast<char*>(queue_[i]->data() + skip);
+            bufs[i].len  = static_cast<ULONG>(queue_[i]->size() - skip);
+        }
+
+        DWORD sent = 0;
+        if (WSASend(s, bufs, static_cast<DWORD>(count), &sent, 0, nullptr, nullptr) != 0)
+            return -1;
+        return static_cast<int>(sent);
+#else
+        iovec iov[max_batch_];
+        for (size_t i = 0; i < count; ++i) {
+            size_t skip      = i == 0 ? offset_ : 0;
+            iov[i].iov_base  = const_cast<char*>(queue_[i]->data() + skip);
+            iov[i].iov_len   = queue_[i]->size() - skip;
+        }
+
+        msghdr msg{};
+        msg.msg_iov    = iov;
+        msg.msg_iovlen = count;
+        return static_cast<int>(::sendmsg(static_cast<int>(s), &msg, send_flags));
+#endif
+    }
+
+    void consume(size_t sent) {
+        bytes_ -= sent;
+        while (sent > 0) {
+            size_t left = queue_.front()->size() - offset_;
+            if (sent < left) {
+                offset_ += sent;
+                return;
+            }
+
+            sent -= left;
+            offset_ = 0;
+            queue_.pop_front();
+        }
+    }
+};
+
+} // namespace net
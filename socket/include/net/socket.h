@@ -1,12 +1,22 @@
 #pragma once
 // std
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
 #include <iostream>
 #include <mutex>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 
 // libs
 #include "endpoint.h"
+#include "transport.h"
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
 
 using string = std::string;
 
@@ -19,11 +29,18 @@ static std::pair<string, uint32_t> any_addr =
 
 enum class protocol : int { TCP = IPPROTO_TCP, UDP = IPPROTO_UDP };
 
-enum class address_family : unsigned short { IPv4 = AF_INET, IPv6 = AF_INET6 };
+// writing to a connection the peer already reset must fail with EPIPE, not raise SIGPIPE
+#ifdef MSG_NOSIGNAL
+inline constexpr int send_flags = MSG_NOSIGNAL;
+#else
+inline constexpr int send_flags = 0;
+#endif
 
 class socket {
   public:
     bool non_blocking = false;
+    // how long write_all waits for a peer that stops reading before giving up; -1 for ever
+    int write_timeout_ms = 30000;
 
     socket() : socket(protocol::TCP) {}
 
@@ -34,27 +51,33 @@ class socket {
     socket(protocol protocol, const string& ip = "", int port = 3154)
         : _ep(ip.empty() ? any_addr.first : ip, port), _socket(INVALID_SOCKET) {
         pre_init();
+        open(protocol);
+    }
 
-        int type = protocol == protocol::TCP ? SOCK_STREAM : SOCK_DGRAM;
-
-        _socket  = ::socket(AF_INET, type, (int)protocol);
-
-        if (_socket == INVALID_SOCKET)
-            throw std::runtime_error("Socket creation failed.");
+    socket(const ip_endpoint& ep, protocol protocol = protocol::TCP)
+        : _ep(ep), _socket(INVALID_SOCKET) {
+        pre_init();
+        open(protocol);
     }
 
     socket(const socket& s)
-        : non_blocking(s.non_blocking), _socket(s._socket), _ep(s._ep), bound(s.bound) {}
+        : non_blocking(s.non_blocking), write_timeout_ms(s.write_timeout_ms), _socket(s._socket), _ep(s._ep),
+          bound(s.bound), _protocol(s._protocol), _transport(s._transport) {}
 
     socket& operator=(const socket& s) {
-        non_blocking = s.non_blocking;
-        _socket      = s._socket;
-        _ep          = s._ep;
-        bound        = s.bound;
+        non_blocking     = s.non_blocking;
+        write_timeout_ms = s.write_timeout_ms;
+        _socket          = s._socket;
+        _ep              = s._ep;
+        bound            = s.bound;
+        _protocol        = s._protocol;
+        _transport       = s._transport;
         return *this;
     }
 
-    socket(socket&& other) noexcept : _socket(other._socket), _ep(std::move(other._ep)) {
+    socket(socket&& other) noexcept
+        : non_blocking(other.non_blocking), write_timeout_ms(other.write_timeout_ms), _socket(other._socket),
+          _ep(std::move(other._ep)), bound(other.bound), _protocol(other._protocol), _transport(std::move(other._transport)) {
         other._socket = INVALID_SOCKET;
     }
 
@@ -64,7 +87,12 @@ class socket {
             _socket       = other._socket;
             other._socket = INVALID_SOCKET;
 
-            _ep           = std::move(other._ep);
+            _ep              = std::move(other._ep);
+            non_blocking     = other.non_blocking;
+            write_timeout_ms = other.write_timeout_ms;
+            bound            = other.bound;
+            _protocol        = other._protocol;
+            _transport       = std::move(other._transport);
         }
 
         return *this;
@@ -80,19 +108,29 @@ class socket {
         if (bound)
             return true;
 
+        if (_ep.is_unix() && !_ep.is_abstract() && !remove_stale_path())
+            return false;
+
+        if (_ep.is_v6()) {
+            // accept IPv4-mapped peers on "::" so one listener serves both stacks
+            int v6_only = 0;
+            setsockopt(_socket, IPPROTO_IPV6, IPV6_V6ONLY, reinterpret_cast<const char*>(&v6_only),
+                       sizeof(v6_only));
+        }
+
         return ::bind(_socket, _ep.get_sockaddr(), _ep.size()) != SOCKET_ERROR;
     }
 
     bool listen(const string& ip, int port) {
         if (!ip.empty())
-            _ep.ip_ = ip;
+            set_endpoint(ip_endpoint(ip, port > 0 ? port : _ep.port()));
 
         return listen(port);
     }
 
     bool listen(int port) {
         if (port > 0)
-            _ep.port_ = port;
+            _ep.set_port(port);
 
         return listen();
     }
@@ -115,22 +153,112 @@ class socket {
         return is_listening;
     }
 
+    bool connect() { return connect(_ep); }
+
+    bool connect(const ip_endpoint& ep) {
+        int result = ::connect(_socket, ep.get_sockaddr(), ep.size());
+        if (result == SOCKET_ERROR) {
+            int err = WSAGetLastError();
+            // non-blocking connects complete later; the caller waits for writability
+            return non_blocking && (err == WSAEWOULDBLOCK || err == WSAEINPROGRESS);
+        }
+        return true;
+    }
+
     socket accept() {
-        ip_endpoint ep;
-        socket client = ::accept(_socket, ep.get_sockaddr(), ep.get_len_ptr());
-        if (client == INVALID_SOCKET) {
-            std::cerr << "Accept failed: " << net::get_socket_error() << std::endl;
-            return socket();
+        ip_endpoint peer;
+        SOCKET client = ::accept(_socket, peer.get_sockaddr(), peer.get_len_ptr());
+        if (client == INVALID_SOCKET)
+            return socket(INVALID_SOCKET, ip_endpoint());
+
+        return socket(client, std::move(peer));
+    }
+
+    // A connection that is non-blocking from the start when asked for, and close-on-exec. With
+    // accept4 that takes no system call beyond the accept itself.
+    socket accept(bool non_blocking_client) {
+#if defined(__linux__) && defined(SOCK_NONBLOCK)
+        ip_endpoint peer;
+        int flags     = SOCK_CLOEXEC | (non_blocking_client ? SOCK_NONBLOCK : 0);
+        SOCKET client = ::accept4(_socket, peer.get_sockaddr(), peer.get_len_ptr(), flags);
+        if (client == INVALID_SOCKET)
+            return socket(INVALID_SOCKET, ip_endpoint());
+
+        socket accepted(client, std::move(peer));
+#else
+        socket accepted = accept();
+        if (accepted.is_valid() && non_blocking_client) {
+            u_long mode = 1;
+            ioctlsocket(accepted._socket, FIONBIO, &mode);
         }
+#endif
+        accepted.non_blocking = non_blocking_client;
+        return accepted;
+    }
+
+    bool write(const string& message) { return write_all(message); }
+
+    // Sends everything, waiting up to write_timeout_ms at a time for writability when the
+    // socket is non-blocking. A wait that runs out fails with WSAETIMEDOUT as the socket error.
+    bool write_all(const char* data, size_t len) {
+        while (len > 0) {
+            int sent = _transport ? transport_write(data, len)
+                                  : ::send(_socket, data, static_cast<int>(len), send_flags);
+            if (sent < 0 && _transport && _socket == INVALID_SOCKET) {
+                if (_transport->wait_writable(write_timeout_ms))
+                    continue;
+                return timed_out();
+            }
+            if (sent > 0) {
+                data += sent;
+                len -= sent;
+                continue;
+            }
 
-        return client;
+            if (sent < 0 && WSAGetLastError() == WSAEWOULDBLOCK) {
+                if (wait_writable(write_timeout_ms))
+                    continue;
+                return timed_out();
+            }
+
+            return false;
+        }
+        return true;
     }
 
-    void write(const string& message) {
-        int sent = ::send(_socket, message.c_str(), static_cast<int>(message.size()), 0);
-        std::cout << "Sent " << sent << " bytes to the socket" << std::endl;
+    bool write_all(const string& data) { return write_all(data.data(), data.size()); }
+
+    // Sends `head` then `body` with gathered writes (sendmsg, WSASend), so neither is copied
+    // next to the other.
+    bool write_all(std::string_view head, std::string_view body) {
+        if (_transport)
+            return write_all(head.data(), head.size()) && write_all(body.data(), body.size());
+
+        while (!head.empty() || !body.empty()) {
+            long sent = send_gathered(head, body);
+            if (sent > 0) {
+                size_t n = static_cast<size_t>(sent);
+                size_t h = std::min(n, head.size());
+                head.remove_prefix(h);
+                body.remove_prefix(n - h);
+                continue;
+            }
+
+            if (sent < 0 && WSAGetLastError() == WSAEWOULDBLOCK) {
+                if (wait_writable(write_timeout_ms))
+                    continue;
+                return timed_out();
+            }
+
+            return false;
+        }
+        return true;
     }
 
+    bool wait_readable(int timeout_ms) const { return wait(POLLIN, timeout_ms); }
+
+    bool wait_writable(int timeout_ms) const { return wait(POLLOUT, timeout_ms); }
+
     string read_string() {
         constexpr size_t buffer_size = 8192;
         char buffer[buffer_size];
@@ -154,7 +282,7 @@ class socket {
     int read(string& out) {
         constexpr size_t buffer_size = 8192;
         char buffer[buffer_size];
-        int bytes_read = ::recv(_socket, buffer, buffer_size, 0);
+        int bytes_read = _transport ? transport_read(buffer, buffer_size) : ::recv(_socket, buffer, buffer_size, 0);
 
         if (bytes_read < 1)
             return bytes_read;
@@ -164,64 +292,196 @@ class socket {
     }
 
     void close() {
+        if (_transport) {
+            _transport->close();
+            _transport.reset();
+            if (_socket == INVALID_SOCKET)
+                return;
+        }
+
+        if (bound && _ep.is_unix() && !_ep.is_abstract())
+            std::remove(_ep.path().c_str());
+
         ::closesocket(_socket);
         _socket = INVALID_SOCKET;
     }
 
-    bool is_valid() const { return _socket != INVALID_SOCKET; }
+    bool is_valid() const { return _socket != INVALID_SOCKET || _transport; }
+
+    const string ip() const { return endpoint().ip_address(); }
+
+    const int port() const { return endpoint().port(); }
 
-    const string ip() const { return _ep.ip_; }
+    string host() const { return endpoint().to_string(); }
 
-    const int port() const { return _ep.port_; }
+    // bound address for listeners, peer address for accepted connections
+    const ip_endpoint& endpoint() const {
+        if (!_ep.is_specified() && is_valid())
+            _ep = remote_endpoint();
+        return _ep;
+    }
 
-    string host() const {
-        string ip = _ep.ip_;
-        int port  = _ep.port_;
-        return ip + ":" + std::to_string(port);
+    ip_endpoint local_endpoint() const {
+        ip_endpoint ep;
+        if (getsockname(_socket, ep.get_sockaddr(), ep.get_len_ptr()) != 0)
+            std::cerr << "getsockname failed: " << net::get_socket_error() << std::endl;
+        return ep;
+    }
+
+    ip_endpoint remote_endpoint() const {
+        ip_endpoint ep;
+        if (getpeername(_socket, ep.get_sockaddr(), ep.get_len_ptr()) != 0)
+            std::cerr << "getpeername failed: " << net::get_socket_error() << std::endl;
+        return ep;
     }
 
     operator const SOCKET&() const { return _socket; }
 
-    socket(SOCKET sock) : _socket(sock), _ep() {
-        pre_init();
-        string local;
-        string remote;
-        bool local_error  = false;
-        bool remote_error = false;
-
-        sockaddr_in local_addr;
-        int local_len = sizeof(local_addr);
-        if (getsockname(_socket, (sockaddr*)&local_addr, &local_len) == 0) {
-            char local_ip[INET_ADDRSTRLEN];
-            inet_ntop(AF_INET, &(local_addr.sin_addr), local_ip, INET_ADDRSTRLEN);
-
-            local = local_ip;
-        } else {
-            std::cerr << "getsockname failed: " << net::get_socket_error() << std::endl;
-            local_error = true;
-        }
+    // adopts an already connected handle; addresses are resolved on demand
+    socket(SOCKET sock) : _socket(sock), _ep() { pre_init(); }
 
-        sockaddr_in remote_addr;
-        int remote_len = sizeof(remote_addr);
-        if (getpeername(_socket, (sockaddr*)&remote_addr, &remote_len) == 0) {
-            char remote_ip[INET_ADDRSTRLEN];
-            inet_ntop(AF_INET, &(remote_addr.sin_addr), remote_ip, INET_ADDRSTRLEN);
+    socket(SOCKET sock, ip_endpoint&& peer) : _socket(sock), _ep(std::move(peer)) { pre_init(); }
 
-            remote = remote_ip;
-        } else {
-            std::cerr << "getpeername failed: " << net::get_socket_error() << std::endl;
-            remote_error = true;
-        }
+    // a connection over `t` instead of an OS handle; `peer` is what endpoint() reports
+    socket(std::shared_ptr<transport> t, ip_endpoint&& peer)
+        : _socket(INVALID_SOCKET), _ep(std::move(peer)), _transport(std::move(t)) {}
+
+    // from here on reads and writes go through `t`; waits still include the handle
+    void set_transport(std::shared_ptr<transport> t) { _transport = std::move(t); }
+
+    bool has_transport() const { return static_cast<bool>(_transport); }
 
-        _ep.set(remote, remote_addr.sin_port);
+    // adopts a handle that is already bound and listening, e.g. one passed from another process
+    static socket inherit(SOCKET listening) {
+        socket s(listening);
+        s.bound = true;
+        s._ep   = s.local_endpoint();
+        return s;
+    }
+
+    // closes the handle but leaves a unix socket's file in place for whoever else holds it
+    void detach() {
+        ::closesocket(_socket);
+        _socket = INVALID_SOCKET;
     }
 
     const static SOCKET const to_socket(const socket& s) { return static_cast<SOCKET>(s); }
 
   private:
     SOCKET _socket;
-    ip_endpoint _ep;
-    bool bound = false;
+    mutable ip_endpoint _ep;
+    bool bound          = false;
+    protocol _protocol = protocol::TCP;
+    std::shared_ptr<transport> _transport;
+
+    long send_gathered(std::string_view a, std::string_view b) {
+#ifdef _WIN32
+        WSABUF bufs[2] = {{static_cast<ULONG>(a.size()), const_cast<char*>(a.data())},
+                          {static_cast<ULONG>(b.size()), const_cast<char*>(b.data())}};
+        DWORD sent = 0;
+        if (::WSASend(_socket, bufs, 2, &sent, 0, nullptr, nullptr) == SOCKET_ERROR)
+            return -1;
+        return static_cast<long>(sent);
+#else
+        iovec iov[2] = {{const_cast<char*>(a.data()), a.size()}, {const_cast<char*>(b.data()), b.size()}};
+        msghdr msg{};
+        msg.msg_iov    = iov;
+        msg.msg_iovlen = 2;
+        return static_cast<long>(::sendmsg(static_cast<int>(_socket), &msg, send_flags));
+#endif
+    }
+
+    // A socket file left by a process that is gone would make bind fail with EADDRINUSE, so
+    // it is removed; one that still has a listener behind it is not, and neither is bound.
+    bool remove_stale_path() {
+        SOCKET probe = ::socket(static_cast<int>(_ep.family()), SOCK_STREAM, 0);
+        if (probe == INVALID_SOCKET)
+            return true;
+
+        bool listening = ::connect(probe, _ep.get_sockaddr(), _ep.size()) != SOCKET_ERROR;
+#ifdef _WIN32
+        bool stale = !listening && WSAGetLastError() == WSAECONNREFUSED;
+#else
+        bool stale = !listening && errno == ECONNREFUSED;
+#endif
+        ::closesocket(probe);
+
+        if (listening) {
+#ifdef _WIN32
+            WSASetLastError(WSAEADDRINUSE);
+#else
+            errno = EADDRINUSE;
+#endif
+            return false;
+        }
+
+        if (stale)
+            std::remove(_ep.path().c_str());
+        return true;
+    }
+
+    int transport_read(char* data, size_t len) { return would_block(_transport->read(data, len)); }
+
+    int transport_write(const char* data, size_t len) { return would_block(_transport->write(data, len)); }
+
+    // callers tell "nothing yet" from a failure by the socket error, as with recv and send
+    static int would_block(int n) {
+        if (n < 0)
+#ifdef _WIN32
+            WSASetLastError(WSAEWOULDBLOCK);
+#else
+            errno = EWOULDBLOCK;
+#endif
+        return n;
+    }
+
+    // the failure of a write that waited write_timeout_ms for room
+    static bool timed_out() {
+#ifdef _WIN32
+        WSASetLastError(WSAETIMEDOUT);
+#else
+        errno = ETIMEDOUT;
+#endif
+        return false;
+    }
+
+    bool wait(short events, int timeout_ms) const {
+        if (_transport) {
+            bool ready = events == POLLIN ? _transport->readable() : _transport->writable();
+            if (ready || _socket == INVALID_SOCKET)
+                return ready;
+        }
+
+        pollfd p{};
+        p.fd     = static_cast<decltype(p.fd)>(_socket);
+        p.events = events;
+#ifdef _WIN32
+        return ::WSAPoll(&p, 1, timeout_ms) > 0;
+#else
+        return ::poll(&p, 1, timeout_ms) > 0;
+#endif
+    }
+
+    void open(protocol protocol) {
+        _protocol = protocol;
+        int type  = protocol == protocol::TCP ? SOCK_STREAM : SOCK_DGRAM;
+        int proto = _ep.is_unix() ? 0 : (int)protocol;
+
+        _socket   = ::socket(static_cast<int>(_ep.family()), type, proto);
+
+        if (_socket == INVALID_SOCKET)
+            throw std::runtime_error("Socket creation failed.");
+    }
+
+    void set_endpoint(ip_endpoint&& ep) {
+        bool reopen = !bound && ep.family() != _ep.family();
+        _ep         = std::move(ep);
+
+        if (reopen) {
+            ::closesocket(_socket);
+            open(_protocol);
+        }
+    }
 
     inline static void pre_init() {
         std::lock_guard<std::mutex> lock(ref_mutex_);
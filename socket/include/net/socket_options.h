@@ -0,0 +1,96 @@
+#pragma once
+// lib
+#include "socket.h"
+
+namespace net {
+
+// Kernel socket options for listeners and accepted connections. Zero leaves a setting at the
+// system default; options the platform lacks are skipped.
+struct socket_options {
+    // connections: send small writes at once instead of waiting for ACKs (Nagle off)
+    bool no_delay = false;
+    // connections: hold a response's head back until its body follows, so both leave in
+    // full segments (TCP_CORK on Linux, TCP_NOPUSH on BSD)
+    bool cork = false;
+    // SO_RCVBUF / SO_SNDBUF in bytes
+    int receive_buffer = 0;
+    int send_buffer    = 0;
+    // connections: bytes allowed to sit unsent in the send buffer before the socket stops
+    // reporting writable (TCP_NOTSENT_LOWAT)
+    int not_sent_lowat = 0;
+    // microseconds to busy-poll the device queue on a blocking read (SO_BUSY_POLL)
+    int busy_poll_us = 0;
+
+    // listener: wake accept only once data arrived, for up to this many seconds (TCP_DEFER_ACCEPT)
+    int defer_accept_s = 0;
+    // listener: pending TCP Fast Open requests, letting clients send data with their SYN
+    int fastopen_queue = 0;
+    // listener: accept queue length in place of SOMAXCONN; see listen_stats for sizing it
+    int backlog = 0;
+
+    // small responses out as soon as possible, at some cost in packets and CPU
+    static socket_options latency() {
+        socket_options o;
+        o.no_delay       = true;
+        o.not_sent_lowat = 16 * 1024;
+        o.busy_poll_us   = 50;
+        o.fastopen_queue = 256;
+        return o;
+    }
+
+    // fewer, fuller segments and larger buffers for big bodies and many connections
+    static socket_options throughput() {
+        socket_options o;
+        o.cork           = true;
+        o.receive_buffer = 256 * 1024;
+        o.send_buffer    = 1024 * 1024;
+        o.defer_accept_s = 1;
+        return o;
+    }
+
+    // on the listening socket; connections it accepts inherit the buffer sizes
+    void apply_listener(SOCKET s) const {
+        // listening again only changes the backlog (Windows keeps the first one)
+        if (backlog > 0)
+            ::listen(s, backlog);
+        set(s, SOL_SOCKET, SO_RCVBUF, receive_buffer);
+        set(s, SOL_SOCKET, SO_SNDBUF, send_buffer);
+#ifdef TCP_DEFER_ACCEPT
+        set(s, IPPROTO_TCP, TCP_DEFER_ACCEPT, defer_accept_s);
+#endif
+#ifdef TCP_FASTOPEN
+        set(s, IPPROTO_TCP, TCP_FASTOPEN, fastopen_queue);
+#endif
+    }
+
+    void apply_connection(SOCKET s) const {
+        if (no_delay)
+            set(s, IPPROTO_TCP, TCP_NODELAY, 1);
+        set(s, SOL_SOCKET, SO_RCVBUF, receive_buffer);
+        set(s, SOL_SOCKET, SO_SNDBUF, send_buffer);
+#ifdef TCP_NOTSENT_LOWAT
+        set(s, IPPROTO_TCP, TCP_NOTSENT_LOWAT, not_sent_lowat);
+#endif
+#ifdef SO_BUSY_POLL
+        set(s, SOL_SOCKET, SO_BUSY_POLL, busy_poll_us);
+#endif
+    }
+
+    // holds partial segments back while on; turning it off sends what is queued
+    static void set_cork(SOCKET s, bool on) {
+#if defined(TCP_CORK)
+        set(s, IPPROTO_TCP, TCP_CORK, on ? 1 : 0, true);
+#elif defined(TCP_NOPUSH)
+        set(s, IPPROTO_TCP, TCP_NOPUSH, on ? 1 : 0, true);
+#endif
+    }
+
+  private:
+    static void set(SOCKET s, int level, int name, int value, bool always = false) {
+        if (value == 0 && !always)
+            return;
+        setsockopt(s, level, name, reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+};
+
+} // namespace net
@@ -1,5 +1,6 @@
 #pragma once
 // std
+#include <functional>
 #include <queue>
 #include <unordered_map>
 #include <unordered_set>
@@ -22,7 +23,8 @@ class socket_registry {
     std::unordered_set<SOCKET> sockets_in_progress;
     std::mutex progress_mutex;
 
-    std::queue<socket> close_queue;
+    std::queue<std::pair<SOCKET, sock_ptr>> close_queue;
+    std::queue<std::pair<SOCKET, std::function<void(sock_ptr)>>> release_queue;
     std::mutex close_mutex;
     mutable std::mutex snapshot_mutex;
 
@@ -33,9 +35,11 @@ class socket_registry {
         socket_set_.add(raw);
     }
 
+    // a handle the OS reused for a new connection replaces the closed socket it belonged to
     void add(sock_ptr socket) {
+        std::scoped_lock lock(snapshot_mutex);
         SOCKET raw = socket::to_socket(*socket);
-        sockets_.emplace(raw, socket);
+        sockets_.insert_or_assign(raw, socket);
         socket_set_.add(raw);
     }
 
@@ -63,6 +67,35 @@ class socket_registry {
         return ptr;
     }
 
+    sock_ptr create_socket(const ip_endpoint& ep) {
+        sock_ptr ptr = std::make_shared<socket>(ep);
+        SOCKET raw   = socket::to_socket(*ptr);
+        sockets_.emplace(raw, ptr);
+        socket_set_.add(raw);
+
+        return ptr;
+    }
+
+    sock_ptr create_socket(socket&& s) {
+        std::scoped_lock lock(snapshot_mutex);
+        sock_ptr ptr = std::make_shared<socket>(std::move(s));
+        SOCKET raw   = socket::to_socket(*ptr);
+        sockets_.insert_or_assign(raw, ptr);
+        socket_set_.add(raw);
+
+        return ptr;
+    }
+
+    // a batch of accepted connections under one lock
+    void add_all(list<socket>&& accepted) {
+        std::scoped_lock lock(snapshot_mutex);
+        for (socket& s : accepted) {
+            SOCKET raw = socket::to_socket(s);
+            sockets_.insert_or_assign(raw, std::make_shared<socket>(std::move(s)));
+            socket_set_.add(raw);
+        }
+    }
+
     sock_ptr create_socket(SOCKET s) {
         sock_ptr ptr = std::make_shared<socket>(s);
         sockets_.emplace(s, ptr);
@@ -87,25 +120,55 @@ class socket_registry {
     }
 
     void mark_closed(SOCKET s) {
+        std::scoped_lock lock(snapshot_mutex, close_mutex);
+        auto it = sockets_.find(s);
+        if (it != sockets_.end()) {
+            close_queue.emplace(s, it->second);
+        }
+    }
+
+    // Hands a connection over to another owner (e.g. an event loop after a protocol upgrade).
+    // Like mark_closed it takes effect on the next drain, so the accept thread stops selecting
+    // on the socket before `on_released` receives it; the socket is left open.
+    void release(SOCKET s, std::function<void(sock_ptr)> on_released) {
         std::scoped_lock lock(snapshot_mutex, close_mutex);
         if (sockets_.find(s) != sockets_.end()) {
-            close_queue.push(s);
+            release_queue.emplace(s, std::move(on_released));
         }
     }
 
     void drain_closed() {
-        std::scoped_lock lock(snapshot_mutex, close_mutex);
-        while (!close_queue.empty()) {
-            SOCKET s = close_queue.front();
-            close_queue.pop();
-
-            auto it = sockets_.find(s);
-            if (it != sockets_.end()) {
-                it->second->close();
-                sockets_.erase(it);
-                socket_set_.remove(s);
+        list<std::pair<sock_ptr, std::function<void(sock_ptr)>>> released;
+        {
+            std::scoped_lock lock(snapshot_mutex, close_mutex);
+            while (!close_queue.empty()) {
+                auto [s, sock] = std::move(close_queue.front());
+                close_queue.pop();
+
+                // the handle may already belong to a newer connection, which stays
+                sock->close();
+                auto it = sockets_.find(s);
+                if (it != sockets_.end() && it->second == sock) {
+                    sockets_.erase(it);
+                    socket_set_.remove(s);
+                }
+                // kept in progress until now so a closing socket is not read again
+                remove_in_progress(s);
+            }
+
+            while (!release_queue.empty()) {
+                auto [s, on_released] = std::move(release_queue.front());
+                release_queue.pop();
+
+                sock_ptr sock = take(s);
+                if (sock)
+                    released.emplace_back(std::move(sock), std::move(on_released));
+                remove_in_progress(s);
             }
         }
+
+        for (auto& [sock, on_released] : released)
+            on_released(std::move(sock));
     }
 
     socket_set snapshot() const {
@@ -12,10 +12,7 @@ class socket_set {
   public:
     socket_set() { FD_ZERO(&fds_); }
 
-    void add(const socket& s) {
-        std::lock_guard lock(mutex_);
-        add(to_socket(s));
-    }
+    void add(const socket& s) { add(to_socket(s)); }
 
     void add(SOCKET s) {
         std::lock_guard lock(mutex_);
@@ -72,6 +69,18 @@ class socket_set {
         return result;
     }
 
+    // waits at most `timeout_ms`; 0 when nothing became readable in time
+    int select(long timeout_ms) {
+        timeval timeout{timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+        int result = ::select(0, &fds_, nullptr, nullptr, &timeout);
+        if (result == SOCKET_ERROR) {
+            net::socket_error err = net::get_socket_error();
+            std::cerr << "[select] failed: " << err.message << ", error code: " << err.error_code
+                      << std::endl;
+        }
+        return result;
+    }
+
     fd_set& raw() { return fds_; }
 
     operator const fd_set&() { return fds_; }
@@ -0,0 +1,347 @@
+#pragma once
+#ifdef NET_HAS_OPENSSL
+// std
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+// lib
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <types.h>
+#include "socket.h"
+#include "transport.h"
+#if defined(__linux__) && __has_include(<linux/tls.h>)
+#include <linux/tls.h>
+#include <netinet/tcp.h>
+#define NET_HAS_KTLS 1
+#endif
+
+namespace net {
+
+struct tls_options {
+    // PEM files; with both empty a self-signed certificate for `self_signed_host` is made at
+    // startup, which is enough for local testing (curl -k)
+    string cert_file;
+    string key_file;
+    string self_signed_host = "localhost";
+    // hand record encryption to the kernel (Linux kTLS) once the handshake is done
+    bool ktls = true;
+};
+
+// The server side of TLS: one SSL_CTX shared by every connection.
+class tls_context {
+  public:
+    explicit tls_context(tls_options opts) : opts_(std::move(opts)), ctx_(SSL_CTX_new(TLS_server_method())) {
+        if (!ctx_)
+            throw std::runtime_error("SSL_CTX_new failed: " + last_error());
+
+        SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+        // a write that would block is retried with the same bytes from wherever they are then
+        SSL_CTX_set_mode(ctx_, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+        // no session tickets: the first application record is then sequence number 0 on both
+        // sides, which is where the kernel starts counting
+        SSL_CTX_set_num_tickets(ctx_, 0);
+        if (opts_.ktls)
+            SSL_CTX_set_keylog_callback(ctx_, &tls_context::keylog);
+
+        bool loaded = opts_.cert_file.empty() && opts_.key_file.empty()
+                          ? self_sign()
+                          : SSL_CTX_use_certificate_chain_file(ctx_, opts_.cert_file.c_str()) == 1 &&
+                                SSL_CTX_use_PrivateKey_file(ctx_, opts_.key_file.c_str(), SSL_FILETYPE_PEM) == 1;
+        if (!loaded || SSL_CTX_check_private_key(ctx_) != 1) {
+            string err = last_error();
+            SSL_CTX_free(ctx_);
+            throw std::runtime_error("TLS certificate: " + err);
+        }
+    }
+
+    tls_context(const tls_context&)            = delete;
+    tls_context& operator=(const tls_context&) = delete;
+
+    ~tls_context() { SSL_CTX_free(ctx_); }
+
+    SSL_CTX* native() const { return ctx_; }
+
+    const tls_options& options() const { return opts_; }
+
+    // connections whose records the kernel encrypts, and those that fell back to user space
+    uint64_t offloaded() const { return offloaded_.load(std::memory_order_relaxed); }
+    uint64_t user_space() const { return user_space_.load(std::memory_order_relaxed); }
+
+    static string last_error() {
+        char buf[256] = "unknown error";
+        if (unsigned long e = ERR_get_error())
+            ERR_error_string_n(e, buf, sizeof buf);
+        ERR_clear_error();
+        return buf;
+    }
+
+  private:
+    friend class tls_session;
+
+    tls_options opts_;
+    SSL_CTX* ctx_;
+    std::atomic<uint64_t> offloaded_{0};
+    std::atomic<uint64_t> user_space_{0};
+
+    inline static void keylog(const SSL* ssl, const char* line);
+
+    bool self_sign() {
+        EVP_PKEY* key = EVP_EC_gen("P-256");
+        X509* cert    = X509_new();
+        bool ok       = key && cert;
+        if (ok) {
+            ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+            X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+            X509_gmtime_adj(X509_getm_notAfter(cert), 60L * 60 * 24 * 365);
+            X509_set_pubkey(cert, key);
+            X509_NAME* name = X509_get_subject_name(cert);
+            X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                                       reinterpret_cast<const unsigned char*>(opts_.self_signed_host.c_str()), -1, -1, 0);
+            X509_set_issuer_name(cert, name);
+            ok = X509_sign(cert, key, EVP_sha256()) > 0 && SSL_CTX_use_certificate(ctx_, cert) == 1 &&
+                 SSL_CTX_use_PrivateKey(ctx_, key) == 1;
+        }
+        X509_free(cert);
+        EVP_PKEY_free(key);
+        return ok;
+    }
+};
+
+// Records through OpenSSL on a connection the kernel could not take over. The socket keeps
+// its handle, so select and poll still see it.
+class tls_transport : public transport {
+  public:
+    explicit tls_transport(SSL* ssl) : ssl_(ssl) {}
+
+    ~tls_transport() override { SSL_free(ssl_); }
+
+    int read(char* data, size_t len) override {
+        int n = SSL_read(ssl_, data, static_cast<int>(len));
+        if (n > 0)
+            return n;
+        return would_block(n) ? -1 : 0;
+    }
+
+    int write(const char* data, size_t len) override {
+        int n = SSL_write(ssl_, data, static_cast<int>(len));
+        if (n > 0)
+            return n;
+        return would_block(n) ? -1 : 0;
+    }
+
+    // decrypted bytes OpenSSL holds that the socket would not report
+    bool readable() const override { return SSL_pending(ssl_) > 0; }
+
+    bool writable() const override { return false; }
+
+    // best effort close_notify; the socket closes the handle
+    void close() override {
+        if (!closed_) {
+            closed_ = true;
+            SSL_shutdown(ssl_);
+        }
+    }
+
+  private:
+    SSL* ssl_;
+    bool closed_ = false;
+
+    bool would_block(int ret) const {
+        int err = SSL_get_error(ssl_, ret);
+        if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE)
+            return true;
+        ERR_clear_error();
+        return false;
+    }
+};
+
+// One accepted connection's handshake, driven from the accept loop without blocking. When it
+// completes, TLS 1.3 AES-GCM sessions have their traffic keys installed with setsockopt(SOL_TLS)
+// and the connection goes on as a plain socket: read, write and gathered writes carry records
+// the kernel encrypts and decrypts. Anything else, or a kernel without the tls module, gets a
+// tls_transport on the socket instead.
+class tls_session {
+  public:
+    enum class state { pending, established, failed };
+
+    tls_session(tls_context& ctx, SOCKET s) : ctx_(ctx), ssl_(SSL_new(ctx.native())) {
+        if (ssl_) {
+            SSL_set_fd(ssl_, static_cast<int>(s));
+            SSL_set_accept_state(ssl_);
+            SSL_set_app_data(ssl_, this);
+        }
+    }
+
+    tls_session(const tls_session&)            = delete;
+    tls_session& operator=(const tls_session&) = delete;
+
+    ~tls_session() { SSL_free(ssl_); }
+
+    state handshake(socket& sock) {
+        if (!ssl_)
+            return state::failed;
+
+        while (true) {
+            int ret = SSL_accept(ssl_);
+            if (ret == 1)
+                break;
+
+            int err = SSL_get_error(ssl_, ret);
+            if (err == SSL_ERROR_WANT_READ)
+                return state::pending;
+            // the flight did not fit the send buffer; it is a few kilobytes, so wait here
+            if (err == SSL_ERROR_WANT_WRITE && sock.wait_writable(handshake_write_wait_ms_))
+                continue;
+
+            ERR_clear_error();
+            return state::failed;
+        }
+
+        if (ctx_.opts_.ktls) {
+            switch (offload(static_cast<int>(static_cast<SOCKET>(sock)))) {
+            case offload_result::done:
+                ctx_.offloaded_.fetch_add(1, std::memory_order_relaxed);
+                return state::established;
+            case offload_result::broken:
+                return state::failed;
+            case offload_result::unsupported:
+                break;
+            }
+        }
+
+        ctx_.user_space_.fetch_add(1, std::memory_order_relaxed);
+        SSL_set_app_data(ssl_, nullptr);
+        sock.set_transport(std::make_shared<tls_transport>(ssl_));
+        ssl_ = nullptr;
+        return state::established;
+    }
+
+    // HKDF-Expand-Label with an empty context (RFC 8446, 7.1), which turns a traffic secret
+    // into the record key and iv
+    static bool expand_label(const EVP_MD* md, const list<uint8_t>& secret, const char* label, uint8_t* out,
+                             size_t len) {
+        string full = string("tls13 ") + label;
+        list<uint8_t> info{static_cast<uint8_t>(len >> 8), static_cast<uint8_t>(len), static_cast<uint8_t>(full.size())};
+        info.insert(info.end(), full.begin(), full.end());
+        info.push_back(0);
+
+        EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, nullptr);
+        bool ok = pctx && EVP_PKEY_derive_init(pctx) > 0 &&
+                  EVP_PKEY_CTX_set_hkdf_mode(pctx, EVP_PKEY_HKDEF_MODE_EXPAND_ONLY) > 0 &&
+                  EVP_PKEY_CTX_set_hkdf_md(pctx, md) > 0 &&
+                  EVP_PKEY_CTX_set1_hkdf_key(pctx, secret.data(), static_cast<int>(secret.size())) > 0 &&
+                  EVP_PKEY_CTX_add1_hkdf_info(pctx, info.data(), static_cast<int>(info.size())) > 0 &&
+                  EVP_PKEY_derive(pctx, out, &len) > 0;
+        EVP_PKEY_CTX_free(pctx);
+        return ok;
+    }
+
+  private:
+    friend class tls_context;
+    enum class offload_result { done, unsupported, broken };
+
+    static constexpr int handshake_write_wait_ms_ = 1000;
+
+    tls_context& ctx_;
+    SSL* ssl_;
+    // TLS 1.3 application traffic secrets, from the keylog callback
+    list<uint8_t> client_secret_;
+    list<uint8_t> server_secret_;
+
+    offload_result offload(int fd) {
+#ifdef NET_HAS_KTLS
+        // OpenSSL must not be holding bytes the kernel will never see
+        if (SSL_version(ssl_) != TLS1_3_VERSION || SSL_has_pending(ssl_) || client_secret_.empty() ||
+            server_secret_.empty())
+            return offload_result::unsupported;
+
+        const EVP_MD* md;
+        size_t key_len;
+        uint16_t cipher_type;
+        switch (SSL_CIPHER_get_protocol_id(SSL_get_current_cipher(ssl_))) {
+        case 0x1301: // TLS_AES_128_GCM_SHA256
+            md = EVP_sha256(), key_len = 16, cipher_type = TLS_CIPHER_AES_GCM_128;
+            break;
+        case 0x1302: // TLS_AES_256_GCM_SHA384
+            md = EVP_sha384(), key_len = 32, cipher_type = TLS_CIPHER_AES_GCM_256;
+            break;
+        default:
+            return offload_result::unsupported;
+        }
+
+        if (setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof "tls") != 0)
+            return offload_result::unsupported;
+
+        // the socket is a TLS socket now; a direction that cannot be installed is fatal
+        bool ok = install(fd, TLS_TX, server_secret_, md, key_len, cipher_type) &&
+                  install(fd, TLS_RX, client_secret_, md, key_len, cipher_type);
+        return ok ? offload_result::done : offload_result::broken;
+#else
+        (void)fd;
+        return offload_result::unsupported;
+#endif
+    }
+
+#ifdef NET_HAS_KTLS
+    template <typename CryptoInfo>
+    static bool set_crypto_info(int fd, int direction, uint16_t cipher_type, const uint8_t* key, const uint8_t* iv) {
+        CryptoInfo info{};
+        info.info.version     = TLS_1_3_VERSION;
+        info.info.cipher_type = cipher_type;
+        // the 12-byte TLS 1.3 nonce is the 4-byte salt followed by the 8-byte iv; the
+        // record sequence starts at 0
+        std::memcpy(info.salt, iv, sizeof info.salt);
+        std::memcpy(info.iv, iv + sizeof info.salt, sizeof info.iv);
+        std::memcpy(info.key, key, sizeof info.key);
+        return setsockopt(fd, SOL_TLS, direction, &info, sizeof info) == 0;
+    }
+
+    static bool install(int fd, int direction, const list<uint8_t>& secret, const EVP_MD* md, size_t key_len,
+                        uint16_t cipher_type) {
+        uint8_t key[32], iv[12];
+        if (!expand_label(md, secret, "key", key, key_len) || !expand_label(md, secret, "iv", iv, sizeof iv))
+            return false;
+
+        bool ok = cipher_type == TLS_CIPHER_AES_GCM_128
+                      ? set_crypto_info<tls12_crypto_info_aes_gcm_128>(fd, direction, cipher_type, key, iv)
+                      : set_crypto_info<tls12_crypto_info_aes_gcm_256>(fd, direction, cipher_type, key, iv);
+        OPENSSL_cleanse(key, sizeof key);
+        return ok;
+    }
+#endif
+
+    // "<LABEL> <client random> <secret>", hex
+    void on_keylog(const char* line) {
+        const char* sp = std::strchr(line, ' ');
+        if (!sp)
+            return;
+
+        std::string_view label(line, sp - line);
+        list<uint8_t>* target = label == "CLIENT_TRAFFIC_SECRET_0"   ? &client_secret_
+                                : label == "SERVER_TRAFFIC_SECRET_0" ? &server_secret_
+                                                                     : nullptr;
+        const char* hex = std::strchr(sp + 1, ' ');
+        if (!target || !hex)
+            return;
+
+        target->clear();
+        for (++hex; hex[0] && hex[1]; hex += 2)
+            target->push_back(static_cast<uint8_t>(std::stoi(string(hex, 2), nullptr, 16)));
+    }
+};
+
+inline void tls_context::keylog(const SSL* ssl, const char* line) {
+    if (auto* session = static_cast<tls_session*>(SSL_get_app_data(ssl)))
+        session->on_keylog(line);
+}
+
+} // namespace net
+#endif
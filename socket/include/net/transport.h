@@ -0,0 +1,102 @@
+#pragma once
+// std
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <utility>
+
+namespace net {
+
+// Byte stream a net::socket can run over instead of its OS handle, e.g. the in-process pipe
+// below, or TLS in user space on top of a real connection (net/tls.h). A socket without a
+// handle never touches the kernel; one with a handle still waits on it.
+class transport {
+  public:
+    virtual ~transport() = default;
+
+    // bytes read; 0 once the peer closed and everything was read; -1 when nothing is there yet
+    virtual int read(char* data, size_t len) = 0;
+    // bytes taken; -1 when none can be taken now, 0 when none ever will
+    virtual int write(const char* data, size_t len) = 0;
+
+    // ready without waiting on the socket's handle
+    virtual bool readable() const = 0;
+    virtual bool writable() const = 0;
+    virtual void close() = 0;
+
+    // How a socket without a handle waits for room to write, up to timeout_ms (-1 for ever) on
+    // whatever clock the transport keeps; a simulation runs it on simulated time. By default
+    // there is nothing to wait for.
+    virtual bool wait_writable(int /* timeout_ms */) { return writable(); }
+};
+
+// One end of an in-memory, bidirectional pipe. Each direction holds at most `capacity` bytes
+// (0 for no limit), so a reader that falls behind pushes back on the writer like a socket
+// buffer would. Not thread-safe: meant for one thread driving both ends, as in a simulation.
+class memory_pipe : public transport {
+  public:
+    static std::pair<std::shared_ptr<memory_pipe>, std::shared_ptr<memory_pipe>> create(size_t capacity = 0) {
+        auto a = std::make_shared<direction>();
+        auto b = std::make_shared<direction>();
+        a->capacity = b->capacity = capacity;
+
+        // what one end writes, the other reads
+        return {std::shared_ptr<memory_pipe>(new memory_pipe(b, a)),
+                std::shared_ptr<memory_pipe>(new memory_pipe(a, b))};
+    }
+
+    int read(char* data, size_t len) override {
+        size_t n = std::min(len, in_->bytes.size());
+        if (n == 0)
+            return in_->closed || out_->closed ? 0 : -1;
+
+        std::copy_n(in_->bytes.begin(), n, data);
+        in_->bytes.erase(in_->bytes.begin(), in_->bytes.begin() + n);
+        return static_cast<int>(n);
+    }
+
+    int write(const char* data, size_t len) override {
+        if (out_->closed || in_->closed)
+            return 0;
+
+        size_t room = out_->capacity ? out_->capacity - std::min(out_->capacity, out_->bytes.size()) : len;
+        size_t n    = std::min(len, room);
+        if (n == 0)
+            return -1;
+
+        out_->bytes.insert(out_->bytes.end(), data, data + n);
+        return static_cast<int>(n);
+    }
+
+    bool readable() const override { return !in_->bytes.empty() || in_->closed || out_->closed; }
+
+    bool writable() const override {
+        return !out_->closed && (!out_->capacity || out_->bytes.size() < out_->capacity);
+    }
+
+    // the peer reads what is buffered, then end of stream
+    void close() override { out_->closed = true; }
+
+    bool closed() const { return out_->closed; }
+
+    // the other end hung up; writes fail from now on
+    bool peer_closed() const { return in_->closed; }
+
+    // bytes written by this end that the peer has not read yet
+    size_t pending() const { return out_->bytes.size(); }
+
+  private:
+    struct direction {
+        std::deque<char> bytes;
+        size_t capacity = 0;
+        bool closed     = false;
+    };
+
+    std::shared_ptr<direction> in_;
+    std::shared_ptr<direction> out_;
+
+    memory_pipe(std::shared_ptr<direction> in, std::shared_ptr<direction> out)
+        : in_(std::move(in)), out_(std::move(out)) {}
+};
+
+} // namespace net